@@ -0,0 +1,93 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Counting allocator for fand-bench.
+ ***************************************************************************/
+
+#include <stddef.h>
+
+#include "alloc-count.h"
+
+/* glibc's own entry points, which the definitions below forward to */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static uint64_t n_allocs = 0;
+static int64_t n_live = 0;
+
+uint64_t
+alloc_count(void)
+{
+    return __atomic_load_n(&n_allocs, __ATOMIC_RELAXED);
+}
+
+int64_t
+alloc_live(void)
+{
+    return __atomic_load_n(&n_live, __ATOMIC_RELAXED);
+}
+
+static void *
+alloc_counted(void *p)
+{
+    __atomic_add_fetch(&n_allocs, 1, __ATOMIC_RELAXED);
+    if (p != NULL) {
+        __atomic_add_fetch(&n_live, 1, __ATOMIC_RELAXED);
+    }
+    return p;
+}
+
+void *
+malloc(size_t size)
+{
+    return alloc_counted(__libc_malloc(size));
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+    return alloc_counted(__libc_calloc(nmemb, size));
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+    void *p = __libc_realloc(ptr, size);
+
+    __atomic_add_fetch(&n_allocs, 1, __ATOMIC_RELAXED);
+    /* a new block, or the old one freed by a realloc() to 0 bytes */
+    if (ptr == NULL && p != NULL) {
+        __atomic_add_fetch(&n_live, 1, __ATOMIC_RELAXED);
+    } else if (ptr != NULL && p == NULL && size == 0) {
+        __atomic_sub_fetch(&n_live, 1, __ATOMIC_RELAXED);
+    }
+    return p;
+}
+
+void
+free(void *ptr)
+{
+    if (ptr != NULL) {
+        __atomic_sub_fetch(&n_live, 1, __ATOMIC_RELAXED);
+    }
+    __libc_free(ptr);
+}
@@ -0,0 +1,39 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Counting allocator for fand-bench.
+ *
+ * alloc-count.c interposes malloc(), calloc(), realloc() and free() for the
+ * whole process (including the OVS libraries) and counts calls to them, and
+ * the blocks allocated and not yet freed.
+ ***************************************************************************/
+
+#ifndef _ALLOC_COUNT_H_
+#define _ALLOC_COUNT_H_
+
+#include <stdint.h>
+
+/* number of malloc(), calloc() and realloc() calls so far */
+uint64_t alloc_count(void);
+
+/* number of blocks allocated and not freed so far */
+int64_t alloc_live(void);
+
+#endif /* _ALLOC_COUNT_H_ */
@@ -0,0 +1,218 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Test that the steady-state sweep and publish cycle doesn't allocate.
+ *
+ *     usage: fand-alloc-test [CYCLES]
+ *
+ * Runs the fan logic against the synthetic platform with the counting
+ * allocator. Each cycle reapplies every subsystem's speed, as a
+ * reconfigure does, and runs the daemon's sweep and publish step
+ * (fand_sweep_run()), which samples every subsystem, compares the fans
+ * with their Fan rows and publishes to the shared memory segment, the
+ * checkpoint and the metrics file. The Fan rows are kept in memory here,
+ * compared with fand_fan_row_diff() like the daemon's, and written by
+ * pointing them at the fans' state. After a few cycles to warm up, a
+ * cycle must not call malloc(), calloc() or realloc(), whether or not the
+ * state changed. Committing an OVSDB transaction for a change (the only
+ * other allocations of a cycle) is not covered.
+ *
+ * Prints PASS, or FAIL and the allocations of each failing phase, and
+ * exits with status 0 or 1.
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "fand-locl.h"
+#include "fanspeed.h"
+#include "fanstatus.h"
+#include "fandsubsys.h"
+#include "fandchanges.h"
+#include "fandckpt.h"
+#include "fandshm.h"
+#include "fandsweep.h"
+#include "alloc-count.h"
+#include "synthetic-platform.h"
+
+#define N_SUBSYSTEMS    4
+#define N_WARMUP        3
+
+static char shm_name[64];
+static char ckpt_path[64];
+static char metrics_path[64];
+static int n_failures;
+
+/* the Fan row of each fan */
+struct test_row {
+    const struct locl_fan *fan;
+    struct fand_fan_row row;
+    int64_t rpm;
+};
+static struct test_row *rows;
+static size_t n_rows;
+static uint64_t n_columns_written;
+
+static void
+rows_create(void)
+{
+    struct shash_node *node;
+
+    rows = xcalloc(shash_count(&fan_data), sizeof *rows);
+    SHASH_FOR_EACH(node, &fan_data) {
+        struct test_row *row = &rows[n_rows++];
+
+        row->fan = node->data;
+        row->row.status = "";
+        row->row.speed = "";
+        row->row.direction = "";
+        row->row.rpm = &row->rpm;
+    }
+}
+
+/* the sweep's update function, standing in for fand_update_fans(): write
+   the columns of each row that differ from its fan */
+static int
+rows_update(void)
+{
+    int changes = 0;
+    size_t idx;
+
+    for (idx = 0; idx < n_rows; idx++) {
+        struct test_row *row = &rows[idx];
+        unsigned int diff = fand_fan_row_diff(&row->row, row->fan);
+
+        if (diff == 0) {
+            continue;
+        }
+        row->row.status = fan_status_enum_to_string(row->fan->status);
+        row->row.speed = fan_speed_enum_to_string(row->fan->speed);
+        row->row.direction = row->fan->direction;
+        row->rpm = row->fan->rpm;
+        row->row.n_rpm = 1;
+        for (; diff != 0; diff &= diff - 1) {
+            changes++;
+        }
+    }
+    n_columns_written += changes;
+    return changes;
+}
+
+/* one sweep and publish cycle. with "override" set, every subsystem's
+   speed override changes to it, otherwise the speed is reapplied as is
+   (as after any database change). */
+static void
+cycle(const char *override)
+{
+    struct shash_node *node;
+
+    SHASH_FOR_EACH(node, &subsystem_data) {
+        fand_subsystem_set_speed(node->data, FAND_SPEED_NORMAL, override);
+    }
+    fand_sweep_run(true);
+}
+
+static void
+check(const char *phase, uint64_t allocs, bool ok)
+{
+    if (allocs != 0 || !ok) {
+        printf("FAIL: %s: %llu allocations%s\n", phase,
+               (unsigned long long int)allocs,
+               ok ? "" : ", unexpected changes");
+        n_failures++;
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    uint64_t start, seq, written;
+    char name[32];
+    int n_cycles = argc > 1 ? atoi(argv[1]) : 100;
+    int i;
+
+    set_program_name(argv[0]);
+    vlog_set_levels(NULL, VLF_ANY_DESTINATION, VLL_OFF);
+
+    snprintf(shm_name, sizeof(shm_name), "/fand-alloc-test-%d",
+             (int)getpid());
+    snprintf(ckpt_path, sizeof(ckpt_path), "/tmp/fand-alloc-test-%d.ckpt",
+             (int)getpid());
+    snprintf(metrics_path, sizeof(metrics_path),
+             "/tmp/fand-alloc-test-%d.prom", (int)getpid());
+    if (fand_shm_create(shm_name) != 0 || fand_ckpt_open(ckpt_path) != 0) {
+        printf("FAIL: can't create the shared memory segment or "
+               "checkpoint\n");
+        return 1;
+    }
+
+    synthetic_set_shape(4, 2);
+    fand_subsystems_init();
+    for (i = 0; i < N_SUBSYSTEMS; i++) {
+        snprintf(name, sizeof(name), "sub%d", i);
+        fand_subsystem_create(name, "/synthetic", NULL, NULL);
+    }
+    rows_create();
+
+    fand_sweep_set_update(rows_update);
+    fand_sweep_set_publish(true, true);
+    fand_sweep_set_metrics(metrics_path, 0);
+    fand_sweep_subsystems_added();
+
+    /* let buffers grow to size, both with and without the override */
+    for (i = 0; i < N_WARMUP; i++) {
+        cycle("fast");
+        cycle(NULL);
+    }
+    /* the fans pick up the last speed change when next sampled */
+    cycle(NULL);
+
+    /* nothing changes */
+    seq = fand_changes_seq();
+    written = n_columns_written;
+    start = alloc_count();
+    for (i = 0; i < n_cycles; i++) {
+        cycle(NULL);
+    }
+    check("steady cycles", alloc_count() - start,
+          fand_changes_seq() == seq && n_columns_written == written);
+
+    /* the speed changes every cycle */
+    start = alloc_count();
+    for (i = 0; i < n_cycles; i++) {
+        cycle(i % 2 ? NULL : "fast");
+    }
+    check("changing cycles", alloc_count() - start,
+          fand_changes_seq() > seq && n_columns_written > written);
+
+    fand_ckpt_close();
+    fand_shm_destroy();
+    shm_unlink(shm_name);
+    unlink(ckpt_path);
+    unlink(metrics_path);
+    free(rows);
+
+    printf("%s\n", n_failures ? "FAIL" : "PASS");
+    return n_failures ? 1 : 0;
+}
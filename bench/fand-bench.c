@@ -0,0 +1,434 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Benchmark for the ops-fand poll and publish engine.
+ *
+ *     usage: fand-bench [--subsystems=N] [--frus=M] [--fans=K]
+ *                       [--iterations=I] [--soak-cycles=C]
+ *
+ * Runs the fan logic against a synthetic platform of N subsystems, each
+ * with M fan FRUs of K fans, and prints one JSON object per benchmark:
+ *
+ *     {"bench":"sweep","subsystems":16,"frus":4,"fans":2,"ops":1000,
+ *      "ns_per_op":12345.6,"allocs_per_op":0.00,"peak_rss_kb":2048}
+ *
+ * OVSDB publishing is not included; "publish_*" benchmarks cover the
+ * in-memory publishers (shared memory segment, change log, metrics).
+ *
+ * The "soak" benchmark removes and re-adds every subsystem C times, as
+ * line card churn would, and also reports the resident set size and the
+ * number of live heap blocks after the first tenth of the cycles and at
+ * the end. Both should stay flat:
+ *
+ *     {"bench":"soak",...,"rss_start_kb":2100,"rss_end_kb":2100,
+ *      "live_allocs_start":812,"live_allocs_end":812}
+ ***************************************************************************/
+
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "dynamic-string.h"
+#include "openvswitch/vlog.h"
+#include "fand-locl.h"
+#include "fandsubsys.h"
+#include "fandchanges.h"
+#include "fandmetrics.h"
+#include "fandshm.h"
+#include "alloc-count.h"
+#include "synthetic-platform.h"
+
+/* shape of the synthetic platform and how long to run each benchmark */
+static int n_subsystems = 16;
+static int n_frus = 4;
+static int n_fans = 2;
+static int n_iterations = 1000;
+static int n_soak_cycles = 2000;
+
+struct bench_mark {
+    long long int start_nsec;
+    uint64_t start_allocs;
+};
+
+static long long int
+now_nsec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static long
+peak_rss_kb(void)
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/* current resident set size */
+static long
+rss_kb(void)
+{
+    long pages = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+
+    if (f != NULL) {
+        if (fscanf(f, "%*s %ld", &pages) != 1) {
+            pages = 0;
+        }
+        fclose(f);
+    }
+    return pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static void
+bench_start(struct bench_mark *mark)
+{
+    mark->start_allocs = alloc_count();
+    mark->start_nsec = now_nsec();
+}
+
+static void
+bench_report(const char *name, const struct bench_mark *mark, long ops)
+{
+    long long int elapsed = now_nsec() - mark->start_nsec;
+    uint64_t allocs = alloc_count() - mark->start_allocs;
+
+    printf("{\"bench\":\"%s\",\"subsystems\":%d,\"frus\":%d,\"fans\":%d,"
+           "\"ops\":%ld,\"ns_per_op\":%.1f,\"allocs_per_op\":%.2f,"
+           "\"peak_rss_kb\":%ld}\n",
+           name, n_subsystems, n_frus, n_fans, ops,
+           ops ? (double)elapsed / ops : 0.0,
+           ops ? (double)allocs / ops : 0.0,
+           peak_rss_kb());
+    fflush(stdout);
+}
+
+static void
+subsystem_name(char *buf, size_t size, int idx)
+{
+    snprintf(buf, size, "sub%d", idx);
+}
+
+/* create every subsystem from scratch */
+static void
+bench_cold_start(void)
+{
+    struct bench_mark mark;
+    char name[32];
+    int idx;
+
+    bench_start(&mark);
+    for (idx = 0; idx < n_subsystems; idx++) {
+        subsystem_name(name, sizeof(name), idx);
+        fand_subsystem_create(name, "/synthetic", NULL, NULL);
+    }
+    bench_report("cold_start", &mark, n_subsystems);
+}
+
+static void
+sweep_all(void)
+{
+    struct shash_node *node;
+
+    SHASH_FOR_EACH(node, &subsystem_data) {
+        fand_subsystem_sample(node->data);
+    }
+}
+
+/* sample every fan with no change in state */
+static void
+bench_sweep(void)
+{
+    struct bench_mark mark;
+    int iter;
+
+    sweep_all();
+    bench_start(&mark);
+    for (iter = 0; iter < n_iterations; iter++) {
+        sweep_all();
+    }
+    bench_report("sweep", &mark, n_iterations);
+}
+
+/* toggle the fan speed override on every subsystem */
+static void
+bench_override_flip(void)
+{
+    struct bench_mark mark;
+    struct shash_node *node;
+    int iter;
+
+    bench_start(&mark);
+    for (iter = 0; iter < n_iterations; iter++) {
+        SHASH_FOR_EACH(node, &subsystem_data) {
+            fand_subsystem_set_speed(node->data, FAND_SPEED_NORMAL,
+                                     iter % 2 ? "fast" : NULL);
+        }
+    }
+    bench_report("override_flip", &mark, (long)n_iterations * n_subsystems);
+}
+
+/* remove and re-add one subsystem */
+static void
+bench_churn(void)
+{
+    struct bench_mark mark;
+    struct locl_subsystem *subsystem;
+    char name[32];
+    int iter;
+
+    subsystem_name(name, sizeof(name), 0);
+    bench_start(&mark);
+    for (iter = 0; iter < n_iterations; iter++) {
+        subsystem = shash_find_data(&subsystem_data, name);
+        if (subsystem != NULL) {
+            fand_subsystem_destroy(subsystem);
+        }
+        fand_subsystem_create(name, "/synthetic", NULL, NULL);
+    }
+    bench_report("churn", &mark, n_iterations);
+}
+
+/* remove and re-add every subsystem, sampling it once, over and over */
+static void
+bench_soak(void)
+{
+    struct bench_mark mark;
+    struct locl_subsystem *subsystem;
+    long long int elapsed;
+    int64_t live_start = 0;
+    long rss_start = 0;
+    int warmup = n_soak_cycles / 10;
+    char name[32];
+    int cycle;
+    int idx;
+
+    if (n_soak_cycles == 0) {
+        return;
+    }
+
+    bench_start(&mark);
+    for (cycle = 0; cycle < n_soak_cycles; cycle++) {
+        if (cycle == warmup) {
+            rss_start = rss_kb();
+            live_start = alloc_live();
+        }
+        for (idx = 0; idx < n_subsystems; idx++) {
+            subsystem_name(name, sizeof(name), idx);
+            subsystem = shash_find_data(&subsystem_data, name);
+            if (subsystem != NULL) {
+                fand_subsystem_destroy(subsystem);
+            }
+            subsystem = fand_subsystem_create(name, "/synthetic", NULL, NULL);
+            fand_subsystem_sample(subsystem);
+        }
+    }
+    elapsed = now_nsec() - mark.start_nsec;
+
+    printf("{\"bench\":\"soak\",\"subsystems\":%d,\"frus\":%d,\"fans\":%d,"
+           "\"ops\":%d,\"ns_per_op\":%.1f,\"allocs_per_op\":%.2f,"
+           "\"peak_rss_kb\":%ld,\"rss_start_kb\":%ld,\"rss_end_kb\":%ld,"
+           "\"live_allocs_start\":%lld,\"live_allocs_end\":%lld}\n",
+           n_subsystems, n_frus, n_fans, n_soak_cycles,
+           (double)elapsed / n_soak_cycles,
+           (double)(alloc_count() - mark.start_allocs) / n_soak_cycles,
+           peak_rss_kb(), rss_start, rss_kb(),
+           (long long int)live_start, (long long int)alloc_live());
+    fflush(stdout);
+}
+
+static void
+bench_publish_shm(void)
+{
+    struct bench_mark mark;
+    char name[64];
+    int iter;
+
+    snprintf(name, sizeof(name), "/fand-bench-%d", (int)getpid());
+    if (fand_shm_create(name) != 0) {
+        return;
+    }
+
+    bench_start(&mark);
+    for (iter = 0; iter < n_iterations; iter++) {
+        fand_shm_publish(&subsystem_data);
+    }
+    bench_report("publish_shm", &mark, n_iterations);
+
+    fand_shm_destroy();
+    shm_unlink(name);
+}
+
+static void
+bench_publish_changes(void)
+{
+    struct ds ds = DS_EMPTY_INITIALIZER;
+    struct bench_mark mark;
+    uint64_t since;
+    int iter;
+
+    /* query as many changes as there are fans each time */
+    since = fand_changes_seq();
+    since = since > shash_count(&fan_data) ? since - shash_count(&fan_data)
+                                           : 0;
+    bench_start(&mark);
+    for (iter = 0; iter < n_iterations; iter++) {
+        ds_clear(&ds);
+        fand_changes_format(&ds, fand_changes_epoch(), since);
+    }
+    bench_report("publish_changes", &mark, n_iterations);
+    ds_destroy(&ds);
+}
+
+static void
+bench_publish_metrics(void)
+{
+    struct fand_stats stats;
+    struct bench_mark mark;
+    char path[64];
+    int iter;
+    int ops = n_iterations / 10 + 1;
+
+    memset(&stats, 0, sizeof(stats));
+    snprintf(path, sizeof(path), "/tmp/fand-bench-%d.prom", (int)getpid());
+
+    bench_start(&mark);
+    for (iter = 0; iter < ops; iter++) {
+        fand_metrics_write(path, &subsystem_data, &stats);
+    }
+    bench_report("publish_metrics", &mark, ops);
+
+    unlink(path);
+}
+
+static void
+usage(void)
+{
+    printf("%s: ops-fand benchmark\n"
+           "usage: %s [OPTIONS]\n"
+           "  --subsystems=N          number of subsystems (default: 16)\n"
+           "  --frus=M                fan FRUs per subsystem (default: 4)\n"
+           "  --fans=K                fans per FRU (default: 2)\n"
+           "  --iterations=I          iterations per benchmark "
+           "(default: 1000)\n"
+           "  --soak-cycles=C         remove and re-add all subsystems C "
+           "times\n"
+           "                          (default: 2000, 0 to skip)\n"
+           "  -h, --help              display this help message\n",
+           program_name, program_name);
+    exit(EXIT_SUCCESS);
+}
+
+static void
+parse_options(int argc, char *argv[])
+{
+    enum {
+        OPT_SUBSYSTEMS = UCHAR_MAX + 1,
+        OPT_FRUS,
+        OPT_FANS,
+        OPT_ITERATIONS,
+        OPT_SOAK_CYCLES,
+    };
+    static const struct option long_options[] = {
+        {"help",        no_argument, NULL, 'h'},
+        {"subsystems",  required_argument, NULL, OPT_SUBSYSTEMS},
+        {"frus",        required_argument, NULL, OPT_FRUS},
+        {"fans",        required_argument, NULL, OPT_FANS},
+        {"iterations",  required_argument, NULL, OPT_ITERATIONS},
+        {"soak-cycles", required_argument, NULL, OPT_SOAK_CYCLES},
+        {NULL, 0, NULL, 0},
+    };
+
+    for (;;) {
+        int c = getopt_long(argc, argv, "h", long_options, NULL);
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+        case 'h':
+            usage();
+
+        case OPT_SUBSYSTEMS:
+            n_subsystems = atoi(optarg);
+            break;
+
+        case OPT_FRUS:
+            n_frus = atoi(optarg);
+            break;
+
+        case OPT_FANS:
+            n_fans = atoi(optarg);
+            break;
+
+        case OPT_ITERATIONS:
+            n_iterations = atoi(optarg);
+            break;
+
+        case OPT_SOAK_CYCLES:
+            n_soak_cycles = atoi(optarg);
+            break;
+
+        default:
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (n_subsystems <= 0 || n_frus <= 0 || n_fans <= 0
+            || n_iterations <= 0 || n_soak_cycles < 0) {
+        fprintf(stderr, "%s: all counts must be positive\n", program_name);
+        exit(EXIT_FAILURE);
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    set_program_name(argv[0]);
+    parse_options(argc, argv);
+
+    vlog_set_levels(NULL, VLF_ANY_DESTINATION, VLL_OFF);
+
+    synthetic_set_shape(n_frus, n_fans);
+    fand_subsystems_init();
+
+    bench_cold_start();
+    bench_sweep();
+    bench_override_flip();
+    bench_publish_shm();
+    bench_publish_changes();
+    bench_publish_metrics();
+    bench_churn();
+    bench_soak();
+
+    return 0;
+}
@@ -0,0 +1,161 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Test of the per-device circuit breakers under the virtual clock.
+ *
+ *     usage: fand-breaker-test
+ *
+ * Makes every register access of a synthetic subsystem fail, and checks
+ * that its device's breaker opens after FAND_BREAKER_THRESHOLD failed
+ * batches, skips the device until the backoff has passed, lets one sample
+ * through (half-open) and opens again with twice the backoff, up to
+ * FAND_BREAKER_MAX_BACKOFF_MSEC, and closes on the first sample after the
+ * device answers again, writing the speed and leds again. Time is moved
+ * with fand_clock_advance().
+ *
+ * Prints PASS, or FAIL and each failed check, and exits with status 0 or
+ * 1.
+ ***************************************************************************/
+
+#include <stdio.h>
+
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "fand-locl.h"
+#include "fandbackend.h"
+#include "fandclock.h"
+#include "fandsubsys.h"
+#include "fanstatus.h"
+#include "synthetic-platform.h"
+
+/* the synthetic platform's only device */
+#define DEVICE  "fan_cpld"
+
+static int n_failures;
+
+static void
+check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("FAIL: %s (at %lld ms)\n", what, fand_clock_msec());
+        n_failures++;
+    }
+}
+
+/* sample the subsystem, returning the registers read */
+static uint64_t
+sample(struct locl_subsystem *subsystem)
+{
+    uint64_t start = synthetic_reads();
+
+    fand_subsystem_sample(subsystem);
+    return synthetic_reads() - start;
+}
+
+int
+main(int argc OVS_UNUSED, char *argv[])
+{
+    struct locl_subsystem *subsystem;
+    const struct fand_breaker *breaker;
+    long long int backoff;
+    uint64_t writes;
+    int idx;
+
+    set_program_name(argv[0]);
+    vlog_set_levels(NULL, VLF_ANY_DESTINATION, VLL_OFF);
+
+    fand_clock_enable_virtual(0);
+    synthetic_set_shape(2, 2);
+    fand_subsystems_init();
+    subsystem = fand_subsystem_create("sub0", "/synthetic", NULL, NULL);
+    if (!subsystem->valid) {
+        printf("FAIL: can't set up the subsystem\n");
+        return 1;
+    }
+    sample(subsystem);
+    breaker = shash_find_data(&subsystem->backend->breakers, DEVICE);
+    check(breaker != NULL && breaker->state == FAND_BREAKER_CLOSED,
+          "no closed breaker for the device");
+    if (breaker == NULL) {
+        goto out;
+    }
+
+    /* the device stops answering. a failing device is sampled (one batch,
+       since no fru reads as present) until the threshold is reached. */
+    synthetic_set_failing(true);
+    for (idx = 1; idx < FAND_BREAKER_THRESHOLD; idx++) {
+        check(sample(subsystem) > 0, "failing device not read");
+        check(breaker->state == FAND_BREAKER_CLOSED,
+              "breaker opened before the threshold");
+    }
+    check(sample(subsystem) > 0, "failing device not read");
+    check(breaker->state == FAND_BREAKER_OPEN && breaker->n_opens == 1,
+          "breaker not open at the threshold");
+    check(breaker->backoff_msec == FAND_BREAKER_BACKOFF_MSEC,
+          "wrong initial backoff");
+    check(subsystem->fans[0].status == FAND_STATUS_FAULT,
+          "fan behind a failing device not faulty");
+
+    /* skipped until the backoff has passed */
+    check(sample(subsystem) == 0, "open breaker let a read through");
+    fand_clock_advance(FAND_BREAKER_BACKOFF_MSEC - 1);
+    check(sample(subsystem) == 0, "breaker let a read through early");
+    check(subsystem->fans[0].status == FAND_STATUS_FAULT,
+          "fan behind an open breaker not faulty");
+
+    /* half-open: one sample goes through, fails, and the backoff doubles
+       each time up to the maximum */
+    fand_clock_advance(1);
+    for (backoff = FAND_BREAKER_BACKOFF_MSEC;
+         backoff < FAND_BREAKER_MAX_BACKOFF_MSEC; backoff *= 2) {
+        check(sample(subsystem) > 0, "half-open breaker didn't read");
+        check(breaker->state == FAND_BREAKER_OPEN
+              && breaker->backoff_msec == MIN(backoff * 2,
+                                              FAND_BREAKER_MAX_BACKOFF_MSEC),
+              "backoff didn't double after a failed retry");
+        check(sample(subsystem) == 0, "reopened breaker let a read through");
+        fand_clock_advance(breaker->backoff_msec);
+    }
+    check(sample(subsystem) > 0, "half-open breaker didn't read");
+    check(breaker->backoff_msec == FAND_BREAKER_MAX_BACKOFF_MSEC,
+          "backoff not capped");
+    check(breaker->n_opens == 1, "reopening counted as a new opening");
+
+    /* the device answers again: the next retry closes the breaker and
+       the speed and leds are written again */
+    synthetic_set_failing(false);
+    check(sample(subsystem) == 0, "reopened breaker let a read through");
+    fand_clock_advance(breaker->backoff_msec);
+    writes = synthetic_writes();
+    check(sample(subsystem) > 0, "half-open breaker didn't read");
+    check(breaker->state == FAND_BREAKER_CLOSED && breaker->n_failures == 0,
+          "breaker not closed by a good sample");
+    check(subsystem->backend->n_recoveries == 1, "recovery not counted");
+    check(synthetic_writes() > writes,
+          "speed and leds not written after recovery");
+    check(subsystem->fans[0].status == FAND_STATUS_OK,
+          "fan not ok after recovery");
+
+out:
+    fand_subsystem_destroy(subsystem);
+
+    printf("%s\n", n_failures ? "FAIL" : "PASS");
+    return n_failures ? 1 : 0;
+}
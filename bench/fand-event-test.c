@@ -0,0 +1,145 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Test that a fru event re-reads just that fru.
+ *
+ *     usage: fand-event-test
+ *
+ * Watches a pipe for fru 2 of a synthetic subsystem, and checks that
+ * nothing is read until the pipe fires, that an event then reads only
+ * fru 2's registers and updates only its fans, and that the event is
+ * consumed. A pipe fires on POLLIN; the POLLPRI of sysfs attributes and
+ * GPIO value files can't be raised outside sysfs, but is handled by the
+ * same code once poll() reports it.
+ *
+ * Prints PASS, or FAIL and each failed check, and exits with status 0 or
+ * 1.
+ ***************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "config-yaml.h"
+#include "fand-locl.h"
+#include "fandbackend.h"
+#include "fandsubsys.h"
+#include "fandtopo.h"
+#include "fanstatus.h"
+#include "synthetic-platform.h"
+
+#define N_FRUS  4
+#define N_FANS  2
+
+static int n_failures;
+
+static void
+check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        n_failures++;
+    }
+}
+
+/* set the register of "op" on the synthetic platform */
+static void
+reg_set(const i2c_bit_op *op, uint32_t value)
+{
+    i2c_reg_write(NULL, NULL, op, value);
+}
+
+/* fire the watch and handle the event. returns the registers read. */
+static uint64_t
+fire(struct locl_subsystem *subsystem, int fd, bool *handled)
+{
+    uint64_t start = synthetic_reads();
+
+    if (fd >= 0 && write(fd, "", 1) != 1) {
+        ovs_fatal(errno, "pipe");
+    }
+    *handled = fand_subsystem_run_events(subsystem);
+    return synthetic_reads() - start;
+}
+
+int
+main(int argc OVS_UNUSED, char *argv[])
+{
+    struct locl_subsystem *subsystem;
+    const YamlFanFru *fru1, *fru2;
+    bool handled;
+    int fds[2];
+
+    set_program_name(argv[0]);
+    vlog_set_levels(NULL, VLF_ANY_DESTINATION, VLL_OFF);
+
+    synthetic_set_shape(N_FRUS, N_FANS);
+    fand_subsystems_init();
+    subsystem = fand_subsystem_create("sub0", "/synthetic", NULL, NULL);
+    if (!subsystem->valid || pipe(fds) < 0) {
+        printf("FAIL: can't set up the subsystem\n");
+        return 1;
+    }
+    fru1 = subsystem->topo->frus[0];
+    fru2 = subsystem->topo->frus[1];
+    fand_backend_watch(subsystem->backend, fds[0], fru2);
+    fand_subsystem_sample(subsystem);
+
+    /* nothing happens until the watch fires */
+    check(fire(subsystem, -1, &handled) == 0 && !handled,
+          "event handled without the watch firing");
+
+    /* a fault on each of frus 1 and 2. the event on fru 2 reads its
+       presence and direction, and the speed and fault of its 2 fans. */
+    reg_set(fru1->fans[0]->fan_fault, 1);
+    reg_set(fru2->fans[0]->fan_fault, 1);
+    check(fire(subsystem, fds[1], &handled) == 2 + 2 * N_FANS && handled,
+          "event didn't read just fru 2's registers");
+    check(subsystem->fans[N_FANS].status == FAND_STATUS_FAULT,
+          "fault on fru 2 not seen after its event");
+    check(subsystem->fans[0].status == FAND_STATUS_OK,
+          "fru 1 updated by fru 2's event");
+
+    /* the event was consumed */
+    check(fire(subsystem, -1, &handled) == 0 && !handled,
+          "event handled twice");
+
+    /* a pulled fru reads only its presence and direction */
+    reg_set(fru2->fan_present, 0);
+    check(fire(subsystem, fds[1], &handled) == 2 && handled,
+          "event on a pulled fru read its fans");
+    check(subsystem->fans[N_FANS].rpm == 0
+          && subsystem->fans[N_FANS + 1].status == FAND_STATUS_FAULT,
+          "pulled fru not seen after its event");
+
+    /* the next sweep sees fru 1's fault */
+    fand_subsystem_sample(subsystem);
+    check(subsystem->fans[0].status == FAND_STATUS_FAULT,
+          "fault on fru 1 not seen by the sweep");
+
+    fand_subsystem_destroy(subsystem);
+    close(fds[0]);
+    close(fds[1]);
+
+    printf("%s\n", n_failures ? "FAIL" : "PASS");
+    return n_failures ? 1 : 0;
+}
@@ -0,0 +1,225 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Test of the hwmon backend against a directory of plain files.
+ *
+ *     usage: fand-hwmon-test
+ *
+ * Creates a temporary directory with the fanN_input, fanN_fault, pwmN and
+ * fruF_present attributes of a synthetic subsystem of 2 frus of 2 fans,
+ * whose fans share one fault register per fru. It then checks the rpm,
+ * fault and presence read through the backend, the pwm values written for
+ * a speed change, and that each shared fault register opens and watches
+ * one attribute.
+ *
+ * Prints PASS, or FAIL and each failed check, and exits with status 0 or
+ * 1.
+ ***************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "dynamic-string.h"
+#include "openvswitch/vlog.h"
+#include "fand-locl.h"
+#include "fandbackend.h"
+#include "fandsubsys.h"
+#include "fanstatus.h"
+#include "synthetic-platform.h"
+
+#define N_FRUS  2
+#define N_FANS  2
+
+/* the synthetic platform's fan_speed_multiplier */
+#define MULTIPLIER 60
+
+static char dir[] = "/tmp/fand-hwmon-test-XXXXXX";
+static int n_failures;
+
+static void
+check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        n_failures++;
+    }
+}
+
+static void
+attr_path(char *path, size_t size, const char *name, int number,
+          const char *suffix)
+{
+    snprintf(path, size, "%s/%s%d%s", dir, name, number, suffix);
+}
+
+static void
+attr_set(const char *name, int number, const char *suffix, int value)
+{
+    char path[256];
+    FILE *file;
+
+    attr_path(path, sizeof path, name, number, suffix);
+    file = fopen(path, "w");
+    if (file == NULL) {
+        ovs_fatal(errno, "%s", path);
+    }
+    fprintf(file, "%d\n", value);
+    fclose(file);
+}
+
+static int
+attr_get(const char *name, int number, const char *suffix)
+{
+    char path[256];
+    FILE *file;
+    int value = -1;
+
+    attr_path(path, sizeof path, name, number, suffix);
+    file = fopen(path, "r");
+    if (file != NULL) {
+        if (fscanf(file, "%d", &value) != 1) {
+            value = -1;
+        }
+        fclose(file);
+    }
+    return value;
+}
+
+static void
+attr_remove(const char *name, int number, const char *suffix)
+{
+    char path[256];
+
+    attr_path(path, sizeof path, name, number, suffix);
+    unlink(path);
+}
+
+/* the "number"th fan of the subsystem, from 1 as hwmon numbers them */
+static const struct locl_fan *
+fan_number(const struct locl_subsystem *subsystem, int number)
+{
+    return number <= (int) subsystem->n_fans ? &subsystem->fans[number - 1]
+                                             : NULL;
+}
+
+int
+main(int argc OVS_UNUSED, char *argv[])
+{
+    struct locl_subsystem *subsystem;
+    struct ds ds = DS_EMPTY_INITIALIZER;
+    char backend_type[64];
+    int number;
+
+    set_program_name(argv[0]);
+    vlog_set_levels(NULL, VLF_ANY_DESTINATION, VLL_OFF);
+
+    if (mkdtemp(dir) == NULL) {
+        ovs_fatal(errno, "%s", dir);
+    }
+    for (number = 1; number <= N_FRUS * N_FANS; number++) {
+        attr_set("fan", number, "_input", 100 + number);
+        attr_set("fan", number, "_fault", 0);
+        attr_set("pwm", number, "", 0);
+    }
+    for (number = 1; number <= N_FRUS; number++) {
+        attr_set("fru", number, "_present", 1);
+    }
+
+    synthetic_set_shape(N_FRUS, N_FANS);
+    synthetic_set_shared_fault(true);
+    fand_subsystems_init();
+    snprintf(backend_type, sizeof backend_type, "hwmon:%s", dir);
+    subsystem = fand_subsystem_create("sub0", "/synthetic", NULL,
+                                      backend_type);
+    check(subsystem->valid && subsystem->n_fans == N_FRUS * N_FANS,
+          "subsystem not valid with the hwmon backend");
+    if (!subsystem->valid) {
+        goto out;
+    }
+
+    /* a fru's fans share its first fan's fault attribute: 2 fru_present,
+       4 fan_input, 2 fan_fault and 4 pwm files, and 4 watched */
+    fand_backend_dump(subsystem->backend, &ds);
+    check(strstr(ds_cstr(&ds), " 12 attribute files") != NULL,
+          "shared fault registers open more than one attribute each");
+    check(subsystem->backend->n_watches == 4,
+          "shared fault registers are watched more than once");
+
+    /* the speed applied when the subsystem was added */
+    check(attr_get("pwm", 1, "") == 2 && attr_get("pwm", 4, "") == 2,
+          "normal speed not written to pwm");
+
+    fand_subsystem_sample(subsystem);
+    for (number = 1; number <= N_FRUS * N_FANS; number++) {
+        const struct locl_fan *fan = fan_number(subsystem, number);
+
+        check(fan->rpm == (100 + number) * MULTIPLIER,
+              "rpm not read from fanN_input");
+        check(fan->status == FAND_STATUS_OK, "fan not ok");
+    }
+
+    /* fault of fru 1 (fan1_fault, shared with fan 2) */
+    attr_set("fan", 1, "_fault", 1);
+    fand_subsystem_sample(subsystem);
+    check(fan_number(subsystem, 1)->status == FAND_STATUS_FAULT
+          && fan_number(subsystem, 2)->status == FAND_STATUS_FAULT,
+          "fault not read from fan1_fault");
+    check(fan_number(subsystem, 3)->status == FAND_STATUS_OK,
+          "fault of fru 1 seen on fru 2");
+    attr_set("fan", 1, "_fault", 0);
+
+    /* pulled fru 2 */
+    attr_set("fru", 2, "_present", 0);
+    fand_subsystem_sample(subsystem);
+    check(fan_number(subsystem, 3)->status == FAND_STATUS_FAULT
+          && fan_number(subsystem, 3)->rpm == 0
+          && fan_number(subsystem, 4)->status == FAND_STATUS_FAULT,
+          "pulled fru not seen");
+    check(fan_number(subsystem, 1)->status == FAND_STATUS_OK,
+          "fru 1 not ok again");
+    attr_set("fru", 2, "_present", 1);
+
+    /* the single speed control covers every fan's pwm */
+    fand_subsystem_set_speed(subsystem, FAND_SPEED_NORMAL, "fast");
+    for (number = 1; number <= N_FRUS * N_FANS; number++) {
+        check(attr_get("pwm", number, "") == 4, "fast speed not written");
+    }
+
+    fand_subsystem_destroy(subsystem);
+
+out:
+    for (number = 1; number <= N_FRUS * N_FANS; number++) {
+        attr_remove("fan", number, "_input");
+        attr_remove("fan", number, "_fault");
+        attr_remove("pwm", number, "");
+    }
+    for (number = 1; number <= N_FRUS; number++) {
+        attr_remove("fru", number, "_present");
+    }
+    rmdir(dir);
+    ds_destroy(&ds);
+
+    printf("%s\n", n_failures ? "FAIL" : "PASS");
+    return n_failures ? 1 : 0;
+}
@@ -0,0 +1,1016 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Load generator that drives ops-fand through a local ovsdb-server.
+ *
+ *     usage: fand-loadgen --hw-desc=DIR [OPTIONS] [-- OPS-FAND-ARGS...]
+ *
+ * Creates a database from the vswitch schema, starts ovsdb-server and
+ * ops-fand (with --hw-sim, unless other arguments are given) on it, then
+ * adds N Subsystem rows, each with a hw_desc_dir of its own (symlinks to
+ * the files of the template DIR) and S Temp_sensor rows. For the rest of
+ * the run it changes Temp_sensor fan_state, the fan_speed_override and
+ * adds/removes subsystems at the configured rates, and measures how long
+ * ops-fand takes to reflect each change in the Fan table (all of the
+ * subsystem's fans present, at the expected speed). At the end it prints
+ * one JSON object:
+ *
+ *     {"subsystems":200,"sensors":2,"duration_s":60,"changes":1234,
+ *      "add":{"n":..,"p50_ms":..,"p99_ms":..,"max_ms":..,"missed":..},
+ *      "state":{..},"override":{..},
+ *      "fand_cpu_pct":3.2,"fand_peak_rss_kb":8192}
+ *
+ * "missed" counts changes that weren't reflected before they were
+ * superseded by another change to the same subsystem, or by the end of
+ * the run.
+ *
+ * With --unsharded-after=SECS, ops-fand must be given --shard, and SECS
+ * into the run an unsharded ops-fand (with --hw-sim) is started beside it.
+ * The report then has "unsharded":{"after_s":..,"shard_stopped_ms":..},
+ * the time until ops-fand/dump shows the shard as not running (-1 if it
+ * never did, in which case the exit status is 1).
+ ***************************************************************************/
+
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "command-line.h"
+#include "ovsdb-idl.h"
+#include "poll-loop.h"
+#include "shash.h"
+#include "smap.h"
+#include "timeval.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "vswitch-idl.h"
+#include "fanspeed.h"
+
+VLOG_DEFINE_THIS_MODULE(fand_loadgen);
+
+/* how often the load is generated and ops-fand is sampled */
+#define LOADGEN_TICK_MSEC       10
+#define LOADGEN_SAMPLE_MSEC     1000
+
+/* what a pending change is waiting for */
+enum loadgen_kind {
+    LOADGEN_ADD,
+    LOADGEN_STATE,
+    LOADGEN_OVERRIDE,
+    LOADGEN_N_KINDS
+};
+
+static const char *loadgen_kind_name[LOADGEN_N_KINDS] = {
+    "add", "state", "override"
+};
+
+/* time-to-reflect samples for one kind of change */
+struct loadgen_latency {
+    long long int *msec;
+    size_t n;
+    size_t allocated;
+    size_t missed;
+};
+
+/* the load generator's view of one subsystem */
+struct loadgen_subsystem {
+    char *name;
+    char *hw_desc_dir;
+    bool present;
+    enum fanspeed *fan_state;       /* per sensor */
+    enum fanspeed override;
+    const struct ovsrec_subsystem *row;  /* valid for the current txn only */
+
+    /* the change ops-fand has yet to reflect */
+    bool pending;
+    enum loadgen_kind pending_kind;
+    enum fanspeed expected;
+    long long int pending_msec;
+};
+
+/* options */
+static const char *hw_desc_template = NULL;
+static const char *schema = "/usr/share/openvswitch/vswitch.ovsschema";
+static const char *fand_path = "ops-fand";
+static char **fand_args = NULL;
+static int n_fand_args = 0;
+static int n_subsystems = 200;
+static int n_sensors = 2;
+static int duration = 60;
+static double state_rate = 50;
+static double override_rate = 5;
+static double churn_rate = 1;
+static uint32_t random_state = 1;
+static char *workdir = NULL;
+static int unsharded_after = -1;
+
+static struct loadgen_subsystem *subsystems;
+static struct shash subsystems_by_name;
+static struct loadgen_latency latency[LOADGEN_N_KINDS];
+static long long int n_changes = 0;
+
+/* ops-fand resource usage */
+static pid_t ovsdb_pid = -1;
+static pid_t fand_pid = -1;
+static long long int fand_start_ticks = -1;
+static long long int fand_ticks = 0;
+static long fand_peak_rss_kb = 0;
+
+/* the unsharded instance started beside a shard (--unsharded-after), and
+   how long after it the shard stopped (time_msec()) */
+static pid_t unsharded_pid = -1;
+static long long int unsharded_start = -1;
+static long long int shard_stopped_msec = -1;
+
+static uint32_t
+loadgen_random(void)
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+static pid_t
+spawn(char *argv[], const char *log)
+{
+    pid_t pid = fork();
+
+    if (pid < 0) {
+        ovs_fatal(errno, "fork failed");
+    } else if (pid == 0) {
+        int fd = open(log, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0) {
+            dup2(fd, STDOUT_FILENO);
+            dup2(fd, STDERR_FILENO);
+            close(fd);
+        }
+        execvp(argv[0], argv);
+        fprintf(stderr, "%s: exec failed (%s)\n", argv[0], strerror(errno));
+        _exit(127);
+    }
+
+    return pid;
+}
+
+static void
+run_command(char *argv[])
+{
+    char *log = xasprintf("%s/%s.log", workdir, "ovsdb-tool");
+    pid_t pid = spawn(argv, log);
+    int status;
+
+    free(log);
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status)
+            || WEXITSTATUS(status) != 0) {
+        ovs_fatal(0, "%s failed (see %s)", argv[0], workdir);
+    }
+}
+
+static void
+wait_for_file(const char *path)
+{
+    long long int deadline = time_msec() + 10 * 1000;
+    struct stat st;
+
+    while (stat(path, &st) != 0) {
+        if (time_msec() > deadline) {
+            ovs_fatal(0, "timed out waiting for %s", path);
+        }
+        usleep(10 * 1000);
+    }
+}
+
+static void
+start_daemons(const char *remote)
+{
+    char *db = xasprintf("%s/vswitch.db", workdir);
+    char *sock = xasprintf("%s/db.sock", workdir);
+    char *log;
+    char **argv;
+    int argc;
+    int idx;
+
+    {
+        char *tool_argv[] = { "ovsdb-tool", "create", db, (char *)schema,
+                              NULL };
+        run_command(tool_argv);
+    }
+
+    {
+        char *server_remote = xasprintf("--remote=punix:%s", sock);
+        char *unixctl = xasprintf("--unixctl=%s/ovsdb-server.ctl", workdir);
+        char *server_argv[] = { "ovsdb-server", db, server_remote, unixctl,
+                                NULL };
+        log = xasprintf("%s/ovsdb-server.log", workdir);
+        ovsdb_pid = spawn(server_argv, log);
+        free(log);
+        free(server_remote);
+        free(unixctl);
+    }
+    wait_for_file(sock);
+
+    if (!strcmp(fand_path, "none")) {
+        free(db);
+        free(sock);
+        return;
+    }
+
+    argv = xcalloc(n_fand_args + 5, sizeof *argv);
+    argc = 0;
+    argv[argc++] = (char *)fand_path;
+    argv[argc++] = xasprintf("--unixctl=%s/ops-fand.ctl", workdir);
+    if (n_fand_args == 0) {
+        argv[argc++] = "--hw-sim";
+    }
+    for (idx = 0; idx < n_fand_args; idx++) {
+        argv[argc++] = fand_args[idx];
+    }
+    argv[argc++] = (char *)remote;
+    argv[argc] = NULL;
+
+    log = xasprintf("%s/ops-fand.log", workdir);
+    fand_pid = spawn(argv, log);
+    free(log);
+    free(argv[1]);
+    free(argv);
+    free(db);
+    free(sock);
+}
+
+/* start an unsharded ops-fand beside the shard under test */
+static void
+start_unsharded(const char *remote)
+{
+    char *unixctl = xasprintf("--unixctl=%s/ops-fand-unsharded.ctl",
+                              workdir);
+    char *log = xasprintf("%s/ops-fand-unsharded.log", workdir);
+    char *argv[] = { (char *)fand_path, unixctl, "--hw-sim", (char *)remote,
+                     NULL };
+
+    unsharded_pid = spawn(argv, log);
+    unsharded_start = time_msec();
+    free(unixctl);
+    free(log);
+}
+
+/* does ops-fand/dump show the shard under test as not running? */
+static bool
+shard_stopped(void)
+{
+    char *target = xasprintf("%s/ops-fand.ctl", workdir);
+    char *log = xasprintf("%s/dump.log", workdir);
+    char *argv[] = { "ovs-appctl", "-t", target, "ops-fand/dump", NULL };
+    bool stopped = false;
+    char line[256];
+    FILE *file;
+    int status;
+
+    if (waitpid(spawn(argv, log), &status, 0) > 0 && WIFEXITED(status)
+            && WEXITSTATUS(status) == 0) {
+        file = fopen(log, "r");
+        while (file != NULL && fgets(line, sizeof(line), file)) {
+            if (!strncmp(line, "Shard:", 6) && strstr(line, "not running")) {
+                stopped = true;
+            }
+        }
+        if (file != NULL) {
+            fclose(file);
+        }
+    }
+    free(target);
+    free(log);
+    return stopped;
+}
+
+static void
+stop_daemons(void)
+{
+    pid_t pids[3] = { unsharded_pid, fand_pid, ovsdb_pid };
+    int idx;
+
+    for (idx = 0; idx < 3; idx++) {
+        if (pids[idx] > 0) {
+            kill(pids[idx], SIGTERM);
+            waitpid(pids[idx], NULL, 0);
+        }
+    }
+}
+
+/* give each subsystem a hardware description directory of its own, made of
+   symlinks to the template's files */
+static char *
+make_hw_desc_dir(const char *name)
+{
+    char *dir = xasprintf("%s/hw/%s", workdir, name);
+    struct dirent *de;
+    DIR *template;
+
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        ovs_fatal(errno, "unable to create %s", dir);
+    }
+
+    template = opendir(hw_desc_template);
+    if (template == NULL) {
+        ovs_fatal(errno, "unable to read %s", hw_desc_template);
+    }
+    while ((de = readdir(template)) != NULL) {
+        char *target, *link;
+
+        if (de->d_name[0] == '.') {
+            continue;
+        }
+        target = xasprintf("%s/%s", hw_desc_template, de->d_name);
+        link = xasprintf("%s/%s", dir, de->d_name);
+        if (symlink(target, link) != 0 && errno != EEXIST) {
+            ovs_fatal(errno, "unable to create %s", link);
+        }
+        free(target);
+        free(link);
+    }
+    closedir(template);
+
+    return dir;
+}
+
+static void
+init_subsystems(void)
+{
+    char *hw = xasprintf("%s/hw", workdir);
+    int idx;
+
+    if (mkdir(hw, 0755) != 0 && errno != EEXIST) {
+        ovs_fatal(errno, "unable to create %s", hw);
+    }
+    free(hw);
+
+    shash_init(&subsystems_by_name);
+    subsystems = xcalloc(n_subsystems, sizeof *subsystems);
+    for (idx = 0; idx < n_subsystems; idx++) {
+        struct loadgen_subsystem *sub = &subsystems[idx];
+
+        sub->name = xasprintf("lc%d", idx);
+        sub->hw_desc_dir = make_hw_desc_dir(sub->name);
+        sub->fan_state = xcalloc(n_sensors, sizeof *sub->fan_state);
+        sub->override = FAND_SPEED_NONE;
+        shash_add(&subsystems_by_name, sub->name, sub);
+    }
+}
+
+/* the speed ops-fand should settle on, as in fand_set_fanspeed() */
+static enum fanspeed
+expected_speed(const struct loadgen_subsystem *sub)
+{
+    enum fanspeed highest = FAND_SPEED_SLOW;
+    int idx;
+
+    for (idx = 0; idx < n_sensors; idx++) {
+        highest = MAX(highest, sub->fan_state[idx]);
+    }
+
+    if (sub->override == FAND_SPEED_NONE || highest == FAND_SPEED_MAX) {
+        return highest;
+    }
+    return sub->override;
+}
+
+static void
+expect(struct loadgen_subsystem *sub, enum loadgen_kind kind)
+{
+    if (sub->pending) {
+        latency[sub->pending_kind].missed++;
+    }
+    sub->pending = true;
+    sub->pending_kind = kind;
+    sub->expected = expected_speed(sub);
+    sub->pending_msec = LLONG_MAX;      /* set once committed */
+    n_changes++;
+}
+
+static void
+record_latency(enum loadgen_kind kind, long long int msec)
+{
+    struct loadgen_latency *lat = &latency[kind];
+
+    if (lat->n == lat->allocated) {
+        lat->msec = x2nrealloc(lat->msec, &lat->allocated, sizeof *lat->msec);
+    }
+    lat->msec[lat->n++] = msec;
+}
+
+static void
+set_sensor_states(const struct loadgen_subsystem *sub)
+{
+    size_t idx;
+
+    for (idx = 0; idx < sub->row->n_temp_sensors && idx < n_sensors; idx++) {
+        ovsrec_temp_sensor_set_fan_state(
+            sub->row->temp_sensors[idx],
+            fan_speed_enum_to_string(sub->fan_state[idx]));
+    }
+}
+
+static void
+add_subsystem(struct ovsdb_idl_txn *txn, struct loadgen_subsystem *sub)
+{
+    struct ovsrec_temp_sensor **sensors;
+    struct ovsrec_subsystem *row;
+    int idx;
+
+    row = ovsrec_subsystem_insert(txn);
+    ovsrec_subsystem_set_name(row, sub->name);
+    ovsrec_subsystem_set_hw_desc_dir(row, sub->hw_desc_dir);
+
+    sensors = xcalloc(n_sensors, sizeof *sensors);
+    for (idx = 0; idx < n_sensors; idx++) {
+        char *name = xasprintf("%s-%d", sub->name, idx);
+
+        sub->fan_state[idx] = FAND_SPEED_NORMAL;
+        sensors[idx] = ovsrec_temp_sensor_insert(txn);
+        ovsrec_temp_sensor_set_name(sensors[idx], name);
+        ovsrec_temp_sensor_set_fan_state(sensors[idx], "normal");
+        free(name);
+    }
+    ovsrec_subsystem_set_temp_sensors(row, sensors, n_sensors);
+    free(sensors);
+
+    sub->override = FAND_SPEED_NONE;
+    sub->present = true;
+    expect(sub, LOADGEN_ADD);
+}
+
+static void
+remove_subsystem(struct loadgen_subsystem *sub)
+{
+    ovsrec_subsystem_delete(sub->row);
+    sub->present = false;
+    if (sub->pending) {
+        latency[sub->pending_kind].missed++;
+        sub->pending = false;
+    }
+    n_changes++;
+}
+
+static void
+change_state(struct loadgen_subsystem *sub)
+{
+    sub->fan_state[loadgen_random() % n_sensors] =
+        loadgen_random() % (FAND_SPEED_MAX + 1);
+    set_sensor_states(sub);
+    expect(sub, LOADGEN_STATE);
+}
+
+static void
+change_override(struct loadgen_subsystem *sub)
+{
+    struct smap other_config;
+    int value = loadgen_random() % (FAND_SPEED_MAX + 2);
+
+    /* one extra value to clear the override */
+    sub->override = value > FAND_SPEED_MAX ? FAND_SPEED_NONE : value;
+
+    smap_clone(&other_config, &sub->row->other_config);
+    if (sub->override == FAND_SPEED_NONE) {
+        smap_remove(&other_config, "fan_speed_override");
+    } else {
+        smap_replace(&other_config, "fan_speed_override",
+                     fan_speed_enum_to_string(sub->override));
+    }
+    ovsrec_subsystem_set_other_config(sub->row, &other_config);
+    smap_destroy(&other_config);
+
+    expect(sub, LOADGEN_OVERRIDE);
+}
+
+/* point each present subsystem at its row in the current IDL contents */
+static void
+map_rows(struct ovsdb_idl *idl)
+{
+    const struct ovsrec_subsystem *row;
+    int idx;
+
+    for (idx = 0; idx < n_subsystems; idx++) {
+        subsystems[idx].row = NULL;
+    }
+    OVSREC_SUBSYSTEM_FOR_EACH (row, idl) {
+        struct loadgen_subsystem *sub;
+
+        sub = shash_find_data(&subsystems_by_name, row->name);
+        if (sub != NULL) {
+            sub->row = row;
+        }
+    }
+}
+
+/* pick a subsystem with a row, for a change other than an add */
+static struct loadgen_subsystem *
+pick_present(void)
+{
+    int tries;
+
+    for (tries = 0; tries < n_subsystems; tries++) {
+        struct loadgen_subsystem *sub;
+
+        sub = &subsystems[loadgen_random() % n_subsystems];
+        if (sub->present && sub->row != NULL) {
+            return sub;
+        }
+    }
+    return NULL;
+}
+
+static void
+commit(struct ovsdb_idl_txn *txn)
+{
+    enum ovsdb_idl_txn_status status;
+    long long int now;
+    int idx;
+
+    status = ovsdb_idl_txn_commit_block(txn);
+    ovsdb_idl_txn_destroy(txn);
+    if (status != TXN_SUCCESS && status != TXN_UNCHANGED) {
+        VLOG_WARN("transaction failed (%s)",
+                  ovsdb_idl_txn_status_to_string(status));
+    }
+
+    /* the clock for each change starts once the database has it */
+    now = time_msec();
+    for (idx = 0; idx < n_subsystems; idx++) {
+        if (subsystems[idx].pending
+                && subsystems[idx].pending_msec == LLONG_MAX) {
+            subsystems[idx].pending_msec = now;
+        }
+    }
+}
+
+/* generate the changes that are due, at the given rates per second */
+static void
+generate_load(struct ovsdb_idl *idl, double elapsed_sec)
+{
+    static double state_credit, override_credit, churn_credit;
+    struct ovsdb_idl_txn *txn;
+    bool changed = false;
+
+    state_credit += state_rate * elapsed_sec;
+    override_credit += override_rate * elapsed_sec;
+    churn_credit += churn_rate * elapsed_sec;
+    if (state_credit < 1 && override_credit < 1 && churn_credit < 1) {
+        return;
+    }
+
+    map_rows(idl);
+    txn = ovsdb_idl_txn_create(idl);
+
+    for (; state_credit >= 1; state_credit--) {
+        struct loadgen_subsystem *sub = pick_present();
+        if (sub != NULL) {
+            change_state(sub);
+            changed = true;
+        }
+    }
+    for (; override_credit >= 1; override_credit--) {
+        struct loadgen_subsystem *sub = pick_present();
+        if (sub != NULL) {
+            change_override(sub);
+            changed = true;
+        }
+    }
+    for (; churn_credit >= 1; churn_credit--) {
+        struct loadgen_subsystem *sub;
+
+        sub = &subsystems[loadgen_random() % n_subsystems];
+        if (!sub->present) {
+            add_subsystem(txn, sub);
+            changed = true;
+        } else if (sub->row != NULL) {
+            remove_subsystem(sub);
+            changed = true;
+        }
+    }
+
+    if (changed) {
+        commit(txn);
+    } else {
+        ovsdb_idl_txn_destroy(txn);
+    }
+}
+
+/* has ops-fand caught up with the change pending on "row"? */
+static bool
+reflected(const struct loadgen_subsystem *sub,
+          const struct ovsrec_subsystem *row)
+{
+    const char *expected = fan_speed_enum_to_string(sub->expected);
+    size_t idx;
+
+    if (row->n_fans == 0) {
+        return false;
+    }
+    for (idx = 0; idx < row->n_fans; idx++) {
+        const char *speed = row->fans[idx]->speed;
+        if (speed == NULL || strcmp(speed, expected)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void
+check_reflected(struct ovsdb_idl *idl)
+{
+    const struct ovsrec_subsystem *row;
+    long long int now = time_msec();
+
+    OVSREC_SUBSYSTEM_FOR_EACH (row, idl) {
+        struct loadgen_subsystem *sub;
+
+        sub = shash_find_data(&subsystems_by_name, row->name);
+        if (sub != NULL && sub->pending && sub->pending_msec != LLONG_MAX
+                && reflected(sub, row)) {
+            record_latency(sub->pending_kind, now - sub->pending_msec);
+            sub->pending = false;
+        }
+    }
+}
+
+/* read ops-fand's cpu time (in clock ticks) and resident set size */
+static void
+sample_fand(void)
+{
+    unsigned long utime, stime;
+    char path[64];
+    char line[256];
+    FILE *file;
+    long rss_kb;
+
+    if (fand_pid <= 0) {
+        return;
+    }
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)fand_pid);
+    file = fopen(path, "r");
+    if (file == NULL) {
+        return;
+    }
+    if (fscanf(file, "%*d %*s %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u "
+               "%lu %lu", &utime, &stime) == 2) {
+        fand_ticks = utime + stime;
+        if (fand_start_ticks < 0) {
+            fand_start_ticks = fand_ticks;
+        }
+    }
+    fclose(file);
+
+    snprintf(path, sizeof(path), "/proc/%d/status", (int)fand_pid);
+    file = fopen(path, "r");
+    if (file == NULL) {
+        return;
+    }
+    while (fgets(line, sizeof(line), file)) {
+        if (sscanf(line, "VmRSS: %ld kB", &rss_kb) == 1) {
+            fand_peak_rss_kb = MAX(fand_peak_rss_kb, rss_kb);
+        }
+    }
+    fclose(file);
+}
+
+static int
+compare_msec(const void *a_, const void *b_)
+{
+    const long long int *a = a_;
+    const long long int *b = b_;
+
+    return *a < *b ? -1 : *a > *b;
+}
+
+static void
+print_latency(enum loadgen_kind kind)
+{
+    struct loadgen_latency *lat = &latency[kind];
+    long long int p50 = 0, p99 = 0, max = 0;
+
+    if (lat->n) {
+        qsort(lat->msec, lat->n, sizeof *lat->msec, compare_msec);
+        p50 = lat->msec[lat->n / 2];
+        p99 = lat->msec[MIN(lat->n - 1, lat->n * 99 / 100)];
+        max = lat->msec[lat->n - 1];
+    }
+    printf("\"%s\":{\"n\":%"PRIuSIZE",\"p50_ms\":%lld,\"p99_ms\":%lld,"
+           "\"max_ms\":%lld,\"missed\":%"PRIuSIZE"}",
+           loadgen_kind_name[kind], lat->n, p50, p99, max, lat->missed);
+}
+
+static void
+print_report(long long int run_msec)
+{
+    double cpu_pct = 0;
+    int idx;
+
+    if (fand_start_ticks >= 0 && run_msec > 0) {
+        cpu_pct = 100.0 * (fand_ticks - fand_start_ticks)
+                  / sysconf(_SC_CLK_TCK) / (run_msec / 1000.0);
+    }
+
+    /* changes still pending at the end were never reflected */
+    for (idx = 0; idx < n_subsystems; idx++) {
+        if (subsystems[idx].pending) {
+            latency[subsystems[idx].pending_kind].missed++;
+        }
+    }
+
+    printf("{\"subsystems\":%d,\"sensors\":%d,\"duration_s\":%d,"
+           "\"changes\":%lld,", n_subsystems, n_sensors, duration,
+           n_changes);
+    for (idx = 0; idx < LOADGEN_N_KINDS; idx++) {
+        print_latency(idx);
+        printf(",");
+    }
+    if (unsharded_after >= 0) {
+        printf("\"unsharded\":{\"after_s\":%d,\"shard_stopped_ms\":%lld},",
+               unsharded_after, shard_stopped_msec);
+    }
+    printf("\"fand_cpu_pct\":%.1f,\"fand_peak_rss_kb\":%ld}\n",
+           cpu_pct, fand_peak_rss_kb);
+    fflush(stdout);
+}
+
+static void
+run(const char *remote)
+{
+    struct ovsdb_idl *idl;
+    struct ovsdb_idl_txn *txn;
+    long long int start, end, last_tick, next_sample;
+    int idx;
+
+    idl = ovsdb_idl_create(remote, &ovsrec_idl_class, true, true);
+    while (!ovsdb_idl_has_ever_connected(idl)) {
+        ovsdb_idl_run(idl);
+        ovsdb_idl_wait(idl);
+        poll_block();
+    }
+
+    /* populate the chassis: every add is timed from this commit */
+    txn = ovsdb_idl_txn_create(idl);
+    for (idx = 0; idx < n_subsystems; idx++) {
+        add_subsystem(txn, &subsystems[idx]);
+    }
+    commit(txn);
+
+    start = last_tick = time_msec();
+    end = start + duration * 1000LL;
+    next_sample = start;
+    while (time_msec() < end) {
+        long long int now;
+
+        ovsdb_idl_run(idl);
+        check_reflected(idl);
+
+        now = time_msec();
+        if (now - last_tick >= LOADGEN_TICK_MSEC) {
+            generate_load(idl, (now - last_tick) / 1000.0);
+            last_tick = now;
+        }
+        if (now >= next_sample) {
+            sample_fand();
+            if (unsharded_start >= 0 && shard_stopped_msec < 0
+                    && shard_stopped()) {
+                shard_stopped_msec = time_msec() - unsharded_start;
+            }
+            next_sample = now + LOADGEN_SAMPLE_MSEC;
+        }
+        if (unsharded_after >= 0 && unsharded_start < 0
+                && now >= start + unsharded_after * 1000LL) {
+            start_unsharded(remote);
+        }
+
+        ovsdb_idl_wait(idl);
+        poll_timer_wait_until(MIN(last_tick + LOADGEN_TICK_MSEC,
+                                  MIN(next_sample, end)));
+        poll_block();
+    }
+    sample_fand();
+
+    print_report(time_msec() - start);
+    ovsdb_idl_destroy(idl);
+}
+
+static void
+usage(void)
+{
+    printf("%s: ops-fand load generator\n"
+           "usage: %s --hw-desc=DIR [OPTIONS] [-- OPS-FAND-ARGS...]\n"
+           "  --hw-desc=DIR           hardware description to give every "
+           "subsystem\n"
+           "  --schema=FILE           vswitch schema (default: %s)\n"
+           "  --fand=PATH             ops-fand binary, or \"none\" to start "
+           "only\n"
+           "                          ovsdb-server (default: ops-fand)\n"
+           "  --workdir=DIR           directory for the database, sockets, "
+           "logs and\n"
+           "                          hw_desc_dir trees (default: a new "
+           "temporary one)\n"
+           "  --subsystems=N          number of subsystems (default: 200)\n"
+           "  --sensors=S             temp sensors per subsystem "
+           "(default: 2)\n"
+           "  --duration=SECS         how long to generate load "
+           "(default: 60)\n"
+           "  --state-rate=R          fan_state changes per second "
+           "(default: 50)\n"
+           "  --override-rate=R       fan_speed_override changes per second "
+           "(default: 5)\n"
+           "  --churn-rate=R          subsystem adds/removes per second "
+           "(default: 1)\n"
+           "  --seed=N                random seed (default: 1)\n"
+           "  --unsharded-after=SECS  start an unsharded ops-fand beside "
+           "the one under\n"
+           "                          test (which must have --shard) after "
+           "SECS, and\n"
+           "                          check that the shard stops\n"
+           "  -h, --help              display this help message\n"
+           "OPS-FAND-ARGS replace the default --hw-sim.\n",
+           program_name, program_name, schema);
+    exit(EXIT_SUCCESS);
+}
+
+static void
+parse_options(int argc, char *argv[])
+{
+    enum {
+        OPT_HW_DESC = UCHAR_MAX + 1,
+        OPT_SCHEMA,
+        OPT_FAND,
+        OPT_WORKDIR,
+        OPT_SUBSYSTEMS,
+        OPT_SENSORS,
+        OPT_DURATION,
+        OPT_STATE_RATE,
+        OPT_OVERRIDE_RATE,
+        OPT_CHURN_RATE,
+        OPT_SEED,
+        OPT_UNSHARDED_AFTER,
+    };
+    static const struct option long_options[] = {
+        {"help",            no_argument, NULL, 'h'},
+        {"hw-desc",         required_argument, NULL, OPT_HW_DESC},
+        {"schema",          required_argument, NULL, OPT_SCHEMA},
+        {"fand",            required_argument, NULL, OPT_FAND},
+        {"workdir",         required_argument, NULL, OPT_WORKDIR},
+        {"subsystems",      required_argument, NULL, OPT_SUBSYSTEMS},
+        {"sensors",         required_argument, NULL, OPT_SENSORS},
+        {"duration",        required_argument, NULL, OPT_DURATION},
+        {"state-rate",      required_argument, NULL, OPT_STATE_RATE},
+        {"override-rate",   required_argument, NULL, OPT_OVERRIDE_RATE},
+        {"churn-rate",      required_argument, NULL, OPT_CHURN_RATE},
+        {"seed",            required_argument, NULL, OPT_SEED},
+        {"unsharded-after", required_argument, NULL, OPT_UNSHARDED_AFTER},
+        {NULL, 0, NULL, 0},
+    };
+
+    for (;;) {
+        int c = getopt_long(argc, argv, "h", long_options, NULL);
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+        case 'h':
+            usage();
+
+        case OPT_HW_DESC:
+            hw_desc_template = optarg;
+            break;
+
+        case OPT_SCHEMA:
+            schema = optarg;
+            break;
+
+        case OPT_FAND:
+            fand_path = optarg;
+            break;
+
+        case OPT_WORKDIR:
+            workdir = xstrdup(optarg);
+            break;
+
+        case OPT_SUBSYSTEMS:
+            n_subsystems = atoi(optarg);
+            break;
+
+        case OPT_SENSORS:
+            n_sensors = atoi(optarg);
+            break;
+
+        case OPT_DURATION:
+            duration = atoi(optarg);
+            break;
+
+        case OPT_STATE_RATE:
+            state_rate = atof(optarg);
+            break;
+
+        case OPT_OVERRIDE_RATE:
+            override_rate = atof(optarg);
+            break;
+
+        case OPT_CHURN_RATE:
+            churn_rate = atof(optarg);
+            break;
+
+        case OPT_SEED:
+            random_state = strtoul(optarg, NULL, 0);
+            if (random_state == 0) {
+                random_state = 1;
+            }
+            break;
+
+        case OPT_UNSHARDED_AFTER:
+            unsharded_after = atoi(optarg);
+            break;
+
+        default:
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    fand_args = argv + optind;
+    n_fand_args = argc - optind;
+
+    if (hw_desc_template == NULL) {
+        ovs_fatal(0, "--hw-desc is required; use --help for usage");
+    }
+    if (n_subsystems <= 0 || n_sensors <= 0 || duration <= 0
+            || state_rate < 0 || override_rate < 0 || churn_rate < 0) {
+        ovs_fatal(0, "counts must be positive and rates not negative");
+    }
+    if (unsharded_after >= 0) {
+        int idx;
+
+        for (idx = 0; idx < n_fand_args; idx++) {
+            if (!strncmp(fand_args[idx], "--shard", 7)) {
+                break;
+            }
+        }
+        if (idx == n_fand_args || unsharded_after >= duration) {
+            ovs_fatal(0, "--unsharded-after needs ops-fand arguments with "
+                      "--shard, and a time within --duration");
+        }
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    char *remote;
+
+    set_program_name(argv[0]);
+    parse_options(argc, argv);
+
+    if (workdir == NULL) {
+        char template[] = "/tmp/fand-loadgen.XXXXXX";
+        if (mkdtemp(template) == NULL) {
+            ovs_fatal(errno, "unable to create a working directory");
+        }
+        workdir = xstrdup(template);
+    } else if (mkdir(workdir, 0755) != 0 && errno != EEXIST) {
+        ovs_fatal(errno, "unable to create %s", workdir);
+    }
+    VLOG_INFO("working directory %s", workdir);
+
+    init_subsystems();
+
+    remote = xasprintf("unix:%s/db.sock", workdir);
+    start_daemons(remote);
+    run(remote);
+    stop_daemons();
+
+    free(remote);
+    return unsharded_after >= 0 && shard_stopped_msec < 0 ? 1 : 0;
+}
@@ -0,0 +1,239 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Test that the built-in fan topologies match what config-yaml parses.
+ *
+ *     usage: fand-topo-test HW_DESC_DIR...
+ *
+ * build-aux/fand-gen-topo.py reads fans.yaml itself, so its key layout,
+ * control type names and defaults can drift from config-yaml's. For each
+ * of the directories the built-in topologies were generated from, this
+ * loads the subsystem (which must pick its built-in topology), parses the
+ * same fans.yaml with config-yaml, and compares the two field by field.
+ * Only built with -DFAND_BUILTIN_HWDESC, and linked with config-yaml
+ * rather than the synthetic platform.
+ *
+ * Prints PASS, or FAIL and each field that differs, and exits with status
+ * 0 or 1.
+ ***************************************************************************/
+
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "config-yaml.h"
+#include "fandtopo.h"
+
+static int n_failures;
+
+/* report field "what" of "platform" as differing, if "differs" */
+static void
+check(bool differs, const char *platform, const char *what,
+      long long int builtin, long long int parsed)
+{
+    if (differs) {
+        printf("FAIL: %s: %s is 0x%llx built in, 0x%llx parsed\n",
+               platform, what, builtin, parsed);
+        n_failures++;
+    }
+}
+
+static void
+check_int(const char *platform, const char *what, long long int builtin,
+          long long int parsed)
+{
+    check(builtin != parsed, platform, what, builtin, parsed);
+}
+
+static void
+check_op(const char *platform, const char *what, const i2c_bit_op *builtin,
+         const i2c_bit_op *parsed)
+{
+    char field[192];
+
+    if (builtin == NULL || parsed == NULL) {
+        snprintf(field, sizeof field, "%.128s (present)", what);
+        check_int(platform, field, builtin != NULL, parsed != NULL);
+        return;
+    }
+    if (strcmp(builtin->device, parsed->device) != 0) {
+        printf("FAIL: %s: %s.device is %s built in, %s parsed\n",
+               platform, what, builtin->device, parsed->device);
+        n_failures++;
+    }
+    snprintf(field, sizeof field, "%.128s.register_address", what);
+    check_int(platform, field, builtin->register_address,
+              parsed->register_address);
+    snprintf(field, sizeof field, "%.128s.size", what);
+    check_int(platform, field, builtin->size, parsed->size);
+    snprintf(field, sizeof field, "%.128s.bit_mask", what);
+    check_int(platform, field, builtin->bit_mask, parsed->bit_mask);
+    snprintf(field, sizeof field, "%.128s.negative_polarity", what);
+    check_int(platform, field, builtin->negative_polarity,
+              parsed->negative_polarity);
+}
+
+static void
+check_info(const char *platform, const YamlFanInfo *builtin,
+           const YamlFanInfo *parsed)
+{
+    if (builtin == NULL || parsed == NULL) {
+        check_int(platform, "fan info (present)", builtin != NULL,
+                  parsed != NULL);
+        return;
+    }
+#define CHECK_FIELD(FIELD) \
+    check_int(platform, #FIELD, builtin->FIELD, parsed->FIELD)
+    CHECK_FIELD(number_fan_frus);
+    CHECK_FIELD(fan_speed_multiplier);
+    CHECK_FIELD(fan_speed_numerator);
+    CHECK_FIELD(fan_speed_control_type);
+    CHECK_FIELD(fan_speed_settings.slow);
+    CHECK_FIELD(fan_speed_settings.normal);
+    CHECK_FIELD(fan_speed_settings.medium);
+    CHECK_FIELD(fan_speed_settings.fast);
+    CHECK_FIELD(fan_speed_settings.max);
+    CHECK_FIELD(direction_values.f2b);
+    CHECK_FIELD(direction_values.b2f);
+    CHECK_FIELD(fan_led_values.off);
+    CHECK_FIELD(fan_led_values.good);
+    CHECK_FIELD(fan_led_values.fault);
+#undef CHECK_FIELD
+    check_op(platform, "fan_speed_control", builtin->fan_speed_control,
+             parsed->fan_speed_control);
+    check_op(platform, "fan_led", builtin->fan_led, parsed->fan_led);
+}
+
+static void
+check_fan(const char *platform, const char *prefix, const YamlFan *builtin,
+          const YamlFan *parsed)
+{
+    char field[128];
+
+    if (strcmp(builtin->name, parsed->name) != 0) {
+        printf("FAIL: %s: %s name is %s built in, %s parsed\n",
+               platform, prefix, builtin->name, parsed->name);
+        n_failures++;
+    }
+#define CHECK_OP(FIELD)                                             \
+    snprintf(field, sizeof field, "%.64s %s", prefix, #FIELD);      \
+    check_op(platform, field, builtin->FIELD, parsed->FIELD)
+    CHECK_OP(fan_speed);
+    CHECK_OP(fan_speed_msb);
+    CHECK_OP(fan_fault);
+    CHECK_OP(fan_speed_control);
+#undef CHECK_OP
+}
+
+static void
+check_fru(const char *platform, int idx, const YamlFanFru *builtin,
+          const YamlFanFru *parsed)
+{
+    char prefix[64];
+    char field[128];
+    int fan_idx;
+
+    snprintf(prefix, sizeof prefix, "fru %d", idx);
+    snprintf(field, sizeof field, "%s number", prefix);
+    check_int(platform, field, builtin->number, parsed->number);
+#define CHECK_OP(FIELD)                                             \
+    snprintf(field, sizeof field, "%.64s %s", prefix, #FIELD);      \
+    check_op(platform, field, builtin->FIELD, parsed->FIELD)
+    CHECK_OP(fan_leds);
+    CHECK_OP(fan_present);
+    CHECK_OP(fan_direction_detect);
+    CHECK_OP(fan_speed_control);
+#undef CHECK_OP
+
+    for (fan_idx = 0; builtin->fans[fan_idx] != NULL
+                      && parsed->fans[fan_idx] != NULL; fan_idx++) {
+        snprintf(field, sizeof field, "%s fan %d", prefix, fan_idx);
+        check_fan(platform, field, builtin->fans[fan_idx],
+                  parsed->fans[fan_idx]);
+    }
+    snprintf(field, sizeof field, "%s fan %d (present)", prefix, fan_idx);
+    check_int(platform, field, builtin->fans[fan_idx] != NULL,
+              parsed->fans[fan_idx] != NULL);
+}
+
+/* compare the built-in topology for "dir" with config-yaml's parse */
+static void
+check_dir(const char *dir)
+{
+    char *copy = xstrdup(dir);
+    const char *platform = basename(copy);
+    const struct fand_topo *topo;
+    YamlConfigHandle yaml;
+    int n_frus;
+    int idx;
+
+    topo = fand_topo_load(platform, dir);
+    if (topo == NULL || topo->source != FAND_TOPO_BUILTIN) {
+        printf("FAIL: %s: no built-in topology used for %s\n", platform, dir);
+        n_failures++;
+        goto out;
+    }
+
+    yaml = yaml_new_config_handle();
+    if (yaml_add_subsystem(yaml, platform, dir) != 0
+            || yaml_parse_fans(yaml, platform) != 0) {
+        printf("FAIL: %s: config-yaml can't parse %s\n", platform, dir);
+        n_failures++;
+        yaml_free_config_handle(yaml);
+        goto out;
+    }
+
+    check_info(platform, topo->info, yaml_get_fan_info(yaml, platform));
+    n_frus = yaml_get_fan_fru_count(yaml, platform);
+    check_int(platform, "number of frus", topo->n_frus, n_frus);
+    for (idx = 0; idx < MIN(topo->n_frus, n_frus); idx++) {
+        check_fru(platform, idx, topo->frus[idx],
+                  yaml_get_fan_fru(yaml, platform, idx));
+    }
+    yaml_free_config_handle(yaml);
+
+out:
+    fand_topo_unload(platform);
+    free(copy);
+}
+
+int
+main(int argc, char *argv[])
+{
+    int idx;
+
+    set_program_name(argv[0]);
+    vlog_set_levels(NULL, VLF_ANY_DESTINATION, VLL_OFF);
+
+    if (argc - 1 != (int) fand_topo_n_builtins) {
+        printf("FAIL: %d directories given for %d built-in topologies\n",
+               argc - 1, (int) fand_topo_n_builtins);
+        return 1;
+    }
+    for (idx = 1; idx < argc; idx++) {
+        check_dir(argv[idx]);
+    }
+
+    printf("%s\n", n_failures ? "FAIL" : "PASS");
+    return n_failures ? 1 : 0;
+}
@@ -0,0 +1,324 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Synthetic in-memory platform for fand-bench and the tests.
+ ***************************************************************************/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config-yaml.h"
+#include "synthetic-platform.h"
+
+/* a register is an i2c_bit_op with its current value next to it. the
+   config-yaml structures only ever hand out pointers to the op, so the
+   value can be found from the op pointer. */
+struct synthetic_reg {
+    i2c_bit_op op;
+    uint32_t value;
+};
+
+struct synthetic_subsystem {
+    char *name;
+    YamlFanInfo info;
+    int n_frus;
+    YamlFanFru *frus;
+    struct synthetic_subsystem *next;
+};
+
+/* a YamlConfigHandle: the subsystems added to it */
+struct synthetic_handle {
+    struct synthetic_subsystem *subsystems;
+};
+
+/* fan tach registers read this, which gives 9000 rpm with a multiplier
+   of 60 */
+#define SYNTHETIC_TACH      150
+#define SYNTHETIC_DEVICE    "fan_cpld"
+
+static int shape_frus = 4;
+static int shape_fans = 2;
+static bool shape_shared_fault = false;
+static bool failing = false;
+static uint64_t n_reads = 0;
+static uint64_t n_writes = 0;
+
+void
+synthetic_set_shape(int n_frus, int n_fans)
+{
+    shape_frus = n_frus;
+    shape_fans = n_fans;
+}
+
+void
+synthetic_set_shared_fault(bool shared)
+{
+    shape_shared_fault = shared;
+}
+
+void
+synthetic_set_failing(bool fail)
+{
+    failing = fail;
+}
+
+uint64_t
+synthetic_reads(void)
+{
+    return n_reads;
+}
+
+uint64_t
+synthetic_writes(void)
+{
+    return n_writes;
+}
+
+static i2c_bit_op *
+new_reg(uint32_t address, uint32_t value)
+{
+    struct synthetic_reg *reg = calloc(1, sizeof *reg);
+
+    reg->op.device = SYNTHETIC_DEVICE;
+    reg->op.register_address = address;
+    reg->op.bit_mask = 0xff;
+    reg->value = value;
+
+    return &reg->op;
+}
+
+static void
+free_subsystem(struct synthetic_subsystem *subsys)
+{
+    int fru_idx;
+    int fan_idx;
+
+    for (fru_idx = 0; fru_idx < subsys->n_frus; fru_idx++) {
+        YamlFanFru *fru = &subsys->frus[fru_idx];
+
+        for (fan_idx = 0; fru->fans[fan_idx] != NULL; fan_idx++) {
+            YamlFan *fan = fru->fans[fan_idx];
+            free(fan->name);
+            free(fan->fan_speed);
+            if (fan_idx == 0 || fan->fan_fault != fru->fans[0]->fan_fault) {
+                free(fan->fan_fault);
+            }
+            free(fan);
+        }
+        free(fru->fans);
+        free(fru->fan_leds);
+        free(fru->fan_present);
+        free(fru->fan_direction_detect);
+    }
+    free(subsys->frus);
+    free(subsys->info.fan_speed_control);
+    free(subsys->info.fan_led);
+    free(subsys->name);
+    free(subsys);
+}
+
+static struct synthetic_subsystem *
+find_subsystem(YamlConfigHandle handle, const char *name)
+{
+    struct synthetic_handle *synthetic = handle;
+    struct synthetic_subsystem *subsys;
+
+    for (subsys = synthetic->subsystems; subsys != NULL;
+         subsys = subsys->next) {
+        if (strcmp(subsys->name, name) == 0) {
+            return subsys;
+        }
+    }
+
+    return NULL;
+}
+
+YamlConfigHandle
+yaml_new_config_handle(void)
+{
+    return calloc(1, sizeof(struct synthetic_handle));
+}
+
+void
+yaml_free_config_handle(YamlConfigHandle handle)
+{
+    struct synthetic_handle *synthetic = handle;
+    struct synthetic_subsystem *subsys, *next;
+
+    if (synthetic == NULL) {
+        return;
+    }
+    for (subsys = synthetic->subsystems; subsys != NULL; subsys = next) {
+        next = subsys->next;
+        free_subsystem(subsys);
+    }
+    free(synthetic);
+}
+
+int
+yaml_add_subsystem(YamlConfigHandle handle, const char *name,
+                   const char *dir)
+{
+    struct synthetic_handle *synthetic = handle;
+    struct synthetic_subsystem *subsys;
+    struct synthetic_subsystem **prev;
+    uint32_t address = 0;
+    int fru_idx;
+    int fan_idx;
+
+    (void)dir;
+
+    /* re-adding a subsystem replaces its description */
+    for (prev = &synthetic->subsystems; *prev != NULL; prev = &(*prev)->next) {
+        if (strcmp((*prev)->name, name) == 0) {
+            subsys = *prev;
+            *prev = subsys->next;
+            free_subsystem(subsys);
+            break;
+        }
+    }
+
+    subsys = calloc(1, sizeof *subsys);
+    subsys->name = strdup(name);
+    subsys->n_frus = shape_frus;
+    subsys->info.number_fan_frus = shape_frus;
+    subsys->info.fan_speed_multiplier = 60;
+    subsys->info.fan_speed_control_type = SINGLE;
+    subsys->info.fan_speed_control = new_reg(address++, 0);
+    subsys->info.fan_led = new_reg(address++, 0);
+    subsys->info.fan_speed_settings.slow = 0x1;
+    subsys->info.fan_speed_settings.normal = 0x2;
+    subsys->info.fan_speed_settings.medium = 0x3;
+    subsys->info.fan_speed_settings.fast = 0x4;
+    subsys->info.fan_speed_settings.max = 0x5;
+    subsys->info.direction_values.f2b = 1;
+    subsys->info.fan_led_values.off = 0;
+    subsys->info.fan_led_values.good = 1;
+    subsys->info.fan_led_values.fault = 2;
+
+    subsys->frus = calloc(shape_frus, sizeof *subsys->frus);
+    for (fru_idx = 0; fru_idx < shape_frus; fru_idx++) {
+        YamlFanFru *fru = &subsys->frus[fru_idx];
+
+        fru->number = fru_idx + 1;
+        fru->fan_leds = new_reg(address++, 0);
+        fru->fan_present = new_reg(address++, 1);
+        fru->fan_direction_detect = new_reg(address++, 1);
+        fru->fans = calloc(shape_fans + 1, sizeof *fru->fans);
+        for (fan_idx = 0; fan_idx < shape_fans; fan_idx++) {
+            YamlFan *fan = calloc(1, sizeof *fan);
+
+            asprintf(&fan->name, "%d-%d", fru_idx + 1, fan_idx + 1);
+            fan->fan_speed = new_reg(address++, SYNTHETIC_TACH);
+            if (shape_shared_fault && fan_idx > 0) {
+                fan->fan_fault = fru->fans[0]->fan_fault;
+            } else {
+                fan->fan_fault = new_reg(address++, 0);
+            }
+            fru->fans[fan_idx] = fan;
+        }
+    }
+
+    subsys->next = synthetic->subsystems;
+    synthetic->subsystems = subsys;
+
+    return 0;
+}
+
+int
+yaml_parse_devices(YamlConfigHandle handle, const char *name)
+{
+    return find_subsystem(handle, name) ? 0 : -1;
+}
+
+int
+yaml_parse_fans(YamlConfigHandle handle, const char *name)
+{
+    return find_subsystem(handle, name) ? 0 : -1;
+}
+
+const YamlDevice *
+yaml_find_device(YamlConfigHandle handle, const char *name,
+                 const char *device)
+{
+    static YamlDevice synthetic_device;
+
+    (void)device;
+    return find_subsystem(handle, name) ? &synthetic_device : NULL;
+}
+
+const YamlFanInfo *
+yaml_get_fan_info(YamlConfigHandle handle, const char *name)
+{
+    struct synthetic_subsystem *subsys = find_subsystem(handle, name);
+
+    return subsys ? &subsys->info : NULL;
+}
+
+int
+yaml_get_fan_fru_count(YamlConfigHandle handle, const char *name)
+{
+    struct synthetic_subsystem *subsys = find_subsystem(handle, name);
+
+    return subsys ? subsys->n_frus : -1;
+}
+
+const YamlFanFru *
+yaml_get_fan_fru(YamlConfigHandle handle, const char *name, int idx)
+{
+    struct synthetic_subsystem *subsys = find_subsystem(handle, name);
+
+    if (subsys == NULL || idx < 0 || idx >= subsys->n_frus) {
+        return NULL;
+    }
+    return &subsys->frus[idx];
+}
+
+int
+i2c_reg_read(YamlConfigHandle handle, const char *name,
+             const i2c_bit_op *op, uint32_t *value)
+{
+    (void)handle;
+    (void)name;
+    n_reads++;
+    if (failing) {
+        return -EIO;
+    }
+    *value = ((const struct synthetic_reg *)op)->value;
+    return 0;
+}
+
+int
+i2c_reg_write(YamlConfigHandle handle, const char *name,
+              const i2c_bit_op *op, uint32_t value)
+{
+    (void)handle;
+    (void)name;
+    n_writes++;
+    if (failing) {
+        return -EIO;
+    }
+    ((struct synthetic_reg *)op)->value = value;
+    return 0;
+}
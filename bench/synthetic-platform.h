@@ -0,0 +1,51 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Synthetic in-memory platform for fand-bench and the tests.
+ *
+ * synthetic-platform.c implements the parts of the config-yaml API that
+ * ops-fand uses (hardware description lookups and i2c register access),
+ * so that the fan logic can be linked and exercised without hardware or
+ * description files. Every subsystem gets the same configurable shape.
+ ***************************************************************************/
+
+#ifndef _SYNTHETIC_PLATFORM_H_
+#define _SYNTHETIC_PLATFORM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* every subsystem added from now on has "n_frus" fan FRUs with "n_fans"
+   fans each */
+void synthetic_set_shape(int n_frus, int n_fans);
+
+/* if "shared", the fans of each fru added from now on share one fault
+   register, i.e. one i2c_bit_op */
+void synthetic_set_shared_fault(bool shared);
+
+/* while "fail" is set, every register access fails with EIO, as if the
+   device had stopped answering */
+void synthetic_set_failing(bool fail);
+
+/* register accesses performed so far */
+uint64_t synthetic_reads(void);
+uint64_t synthetic_writes(void);
+
+#endif /* _SYNTHETIC_PLATFORM_H_ */
@@ -0,0 +1,218 @@
+#!/usr/bin/env python
+
+# (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+#
+#    Licensed under the Apache License, Version 2.0 (the "License"); you may
+#    not use this file except in compliance with the License. You may obtain
+#    a copy of the License at
+#
+#         http://www.apache.org/licenses/LICENSE-2.0
+#
+#    Unless required by applicable law or agreed to in writing, software
+#    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+#    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+#    License for the specific language governing permissions and limitations
+#    under the License.
+
+"""Generate the built-in fan topologies of ops-fand.
+
+    fand-gen-topo.py OUTPUT.c HW_DESC_DIR...
+
+Turns the fans.yaml of each hardware description directory into const C
+tables (struct fand_topo_builtin, see fandtopo.h). The keys of fans.yaml
+are those of the config-yaml structures: the YamlFanInfo fields, either at
+the top level or under "fan_info", and its FRUs (YamlFanFru, with a "fans"
+list of YamlFan) under "fan_frus". Bit operations are mappings of the
+i2c_bit_op fields.
+
+At run time a subsystem uses a built-in topology when its fans.yaml has
+the same size and FNV-1a hash as the one the tables were generated from.
+bench/fand-topo-test.c ("make test") checks the tables against
+config-yaml's parse of the same directories.
+"""
+
+import os
+import sys
+
+import yaml
+
+FANS_FILE = "fans.yaml"
+
+CONTROL_TYPES = {
+    "single": "SINGLE",
+    "fru": "PER_FRU",
+    "per_fru": "PER_FRU",
+    "fan": "PER_FAN",
+    "per_fan": "PER_FAN",
+}
+
+
+def fnv1a(data):
+    h = 0xcbf29ce484222325
+    for b in bytearray(data):
+        h = ((h ^ b) * 0x100000001b3) & 0xffffffffffffffff
+    return h
+
+
+def c_string(s):
+    return '"%s"' % str(s).replace("\\", "\\\\").replace('"', '\\"')
+
+
+def c_ident(s):
+    return "".join(c if c.isalnum() else "_" for c in s)
+
+
+class Generator(object):
+    def __init__(self):
+        self.lines = []
+        self.ops = {}
+
+    def emit(self, line=""):
+        self.lines.append(line)
+
+    def op(self, prefix, op):
+        """emits "op" (once per distinct value) and returns a pointer
+        expression for it"""
+        if op is None:
+            return "NULL"
+        key = (str(op["device"]), int(op.get("register_address", 0)),
+               int(op.get("size", 1)), int(op.get("bit_mask", 0xff)),
+               bool(op.get("negative_polarity", False)))
+        if key not in self.ops:
+            name = "%s_op%d" % (prefix, len(self.ops))
+            self.ops[key] = name
+            self.emit("static const i2c_bit_op %s = {" % name)
+            self.emit("    .device = %s," % c_string(key[0]))
+            self.emit("    .register_address = 0x%x," % key[1])
+            self.emit("    .size = %d," % key[2])
+            self.emit("    .bit_mask = 0x%x," % key[3])
+            self.emit("    .negative_polarity = %s," %
+                      ("true" if key[4] else "false"))
+            self.emit("};")
+        return "(i2c_bit_op *)&%s" % self.ops[key]
+
+    def topology(self, dir_):
+        path = os.path.join(dir_, FANS_FILE)
+        with open(path, "rb") as f:
+            data = f.read()
+        doc = yaml.safe_load(data) or {}
+        info = doc.get("fan_info", doc)
+        frus = doc.get("fan_frus", info.get("fan_frus", []))
+        platform = os.path.basename(os.path.normpath(dir_))
+        prefix = "topo_%s" % c_ident(platform)
+
+        self.emit("/* %s */" % path)
+        self.emit()
+        fru_names = []
+        for fru in frus:
+            fru_prefix = "%s_fru%d" % (prefix, int(fru["number"]))
+            fan_names = []
+            for fan in fru.get("fans", []):
+                fan_name = "%s_fan%d" % (fru_prefix, len(fan_names))
+                ops = [self.op(prefix, fan.get(field))
+                       for field in ("fan_speed", "fan_speed_msb",
+                                     "fan_fault", "fan_speed_control")]
+                self.emit("static const YamlFan %s = {" % fan_name)
+                self.emit("    .name = %s," % c_string(fan["name"]))
+                self.emit("    .fan_speed = %s," % ops[0])
+                self.emit("    .fan_speed_msb = %s," % ops[1])
+                self.emit("    .fan_fault = %s," % ops[2])
+                self.emit("    .fan_speed_control = %s," % ops[3])
+                self.emit("};")
+                fan_names.append(fan_name)
+            self.emit("static YamlFan *const %s_fans[] = {" % fru_prefix)
+            for fan_name in fan_names:
+                self.emit("    (YamlFan *)&%s," % fan_name)
+            self.emit("    NULL")
+            self.emit("};")
+            ops = [self.op(prefix, fru.get(field))
+                   for field in ("fan_leds", "fan_present",
+                                 "fan_direction_detect", "fan_speed_control")]
+            self.emit("static const YamlFanFru %s = {" % fru_prefix)
+            self.emit("    .number = %d," % int(fru["number"]))
+            self.emit("    .fans = (YamlFan **)%s_fans," % fru_prefix)
+            self.emit("    .fan_leds = %s," % ops[0])
+            self.emit("    .fan_present = %s," % ops[1])
+            self.emit("    .fan_direction_detect = %s," % ops[2])
+            self.emit("    .fan_speed_control = %s," % ops[3])
+            self.emit("};")
+            fru_names.append(fru_prefix)
+        self.emit("static const YamlFanFru *const %s_frus[] = {" % prefix)
+        for fru_name in fru_names:
+            self.emit("    &%s," % fru_name)
+        self.emit("    NULL")
+        self.emit("};")
+
+        control_type = str(info.get("fan_speed_control_type", "single"))
+        control_type = CONTROL_TYPES.get(control_type.lower(), control_type)
+        settings = info.get("fan_speed_settings", {})
+        directions = info.get("direction_values", {})
+        leds = info.get("fan_led_values", {})
+        control = self.op(prefix, info.get("fan_speed_control"))
+        led = self.op(prefix, info.get("fan_led"))
+        self.emit("static const YamlFanInfo %s_info = {" % prefix)
+        self.emit("    .number_fan_frus = %d," %
+                  int(info.get("number_fan_frus", len(frus))))
+        self.emit("    .fan_speed_multiplier = %d," %
+                  int(info.get("fan_speed_multiplier", 1)))
+        self.emit("    .fan_speed_numerator = %d," %
+                  int(info.get("fan_speed_numerator", 0)))
+        self.emit("    .fan_speed_control = %s," % control)
+        self.emit("    .fan_speed_control_type = %s," % control_type)
+        self.emit("    .fan_led = %s," % led)
+        self.emit("    .fan_speed_settings = {")
+        for level in ("slow", "normal", "medium", "fast", "max"):
+            self.emit("        .%s = 0x%x," % (level, int(settings.get(level,
+                                                                       0))))
+        self.emit("    },")
+        self.emit("    .direction_values = {")
+        for direction in ("f2b", "b2f"):
+            self.emit("        .%s = 0x%x," %
+                      (direction, int(directions.get(direction, 0))))
+        self.emit("    },")
+        self.emit("    .fan_led_values = {")
+        for state in ("off", "good", "fault"):
+            self.emit("        .%s = 0x%x," % (state, int(leds.get(state, 0))))
+        self.emit("    },")
+        self.emit("};")
+        self.emit()
+
+        return ("    {\n"
+                "        .platform = %s,\n"
+                "        .fans_size = %d,\n"
+                "        .fans_hash = UINT64_C(0x%016x),\n"
+                "        .info = &%s_info,\n"
+                "        .frus = %s_frus,\n"
+                "        .n_frus = %d,\n"
+                "    }," % (c_string(platform), len(data), fnv1a(data),
+                            prefix, prefix, len(fru_names)))
+
+
+def main(argv):
+    if len(argv) < 2:
+        sys.stderr.write("usage: %s OUTPUT.c HW_DESC_DIR...\n" % argv[0])
+        return 1
+
+    gen = Generator()
+    gen.emit("/* generated by fand-gen-topo.py, do not edit */")
+    gen.emit()
+    gen.emit("#include <stdbool.h>")
+    gen.emit("#include <stddef.h>")
+    gen.emit("#include <stdint.h>")
+    gen.emit('#include "fandtopo.h"')
+    gen.emit()
+    entries = [gen.topology(dir_) for dir_ in argv[2:]]
+    gen.emit("const struct fand_topo_builtin fand_topo_builtins[] = {")
+    gen.lines.extend(entries)
+    gen.emit("};")
+    gen.emit("const size_t fand_topo_n_builtins = %d;" % len(entries))
+
+    tmp = argv[1] + ".tmp"
+    with open(tmp, "w") as f:
+        f.write("\n".join(gen.lines) + "\n")
+    os.rename(tmp, argv[1])
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -62,6 +62,49 @@
  *                                  (default: /var/log/openvswitch/ops-fand.log)
  *          --syslog-target=HOST:PORT  also send syslog msgs to HOST:PORT via UDP
  *
+ *     Sweep options:
+ *          --sweep-budget=MSEC     sample fans for at most about MSEC per
+ *                                  poll loop iteration, finishing a sweep
+ *                                  over several (default: 0, no limit)
+ *
+ *     Standby options:
+ *          --hot-standby           while another ops-fand holds the lock,
+ *                                  keep the fans loaded and sampled (read
+ *                                  only), ready to take over
+ *          --shard=PATTERN|N/M     only handle subsystems whose name matches
+ *                                  PATTERN, or that hash to slot N of M,
+ *                                  under a lock of their own
+ *
+ *     Startup options:
+ *          --hw-cache=DIR          keep parsed fan hardware descriptions in
+ *                                  DIR and load them from there while
+ *                                  unchanged
+ *          --checkpoint[=FILE]     keep the fan state in FILE, and resume
+ *                                  from it after a restart (default:
+ *                                  /var/run/openvswitch/ops-fand.ckpt)
+ *
+ *     Shared memory options:
+ *          --shm[=NAME]            publish live fan state in POSIX shared
+ *                                  memory segment NAME (default: /ops-fand)
+ *
+ *     Metrics options:
+ *          --metrics-file=FILE     write Prometheus text format metrics to FILE
+ *          --metrics-interval=SECS rewrite the metrics file every SECS seconds
+ *                                  (default: 5)
+ *
+ *     Simulation options:
+ *          --hw-sim[=SETTINGS]     simulate the fan hardware instead of using
+ *                                  i2c (see fandsim.h for SETTINGS)
+ *          --hw-capture=FILE       record all register traffic to FILE
+ *          --hw-replay=FILE        replay the register traffic recorded in
+ *                                  FILE instead of using i2c
+ *          --hw-replay-speed=original|max
+ *                                  replay with the recorded timing (default)
+ *                                  or as fast as possible
+ *          --virtual-clock[=SECS]  only advance time with
+ *                                  ops-fand/clock-advance, starting at wall
+ *                                  clock time SECS since the epoch
+ *
  *     Other options:
  *          --unixctl=SOCKET        override default control socket name
  *          -h, --help              display this help message
@@ -71,6 +114,13 @@
  * ovs-apptcl options:
  *
  *      Support dump: ovs-appctl -t ops-fand ops-fand/dump
+ *      Changes since a sequence number (as "seq" in the last reply):
+ *                    ovs-appctl -t ops-fand ops-fand/changes
+ *                        <epoch>:<since-seq>
+ *      Simulated hardware faults (with --hw-sim):
+ *                    ovs-appctl -t ops-fand ops-fand/hw-sim <settings>
+ *      Advance the virtual clock (with --virtual-clock):
+ *                    ovs-appctl -t ops-fand ops-fand/clock-advance <msec>
  *
  *
  * OVSDB elements usage
@@ -102,6 +152,11 @@
  *     The following files are written by ops-fand
  *           /var/run/openvswitch/ops-fand.pid: Process ID for the ops-fand daemon
  *           /var/run/openvswitch/ops-fand.<pid>.ctl: unixctl socket for the ops-fand daemon
+ *           --metrics-file FILE: Prometheus text format metrics (optional)
+ *           /dev/shm/ops-fand: live fan state segment, with --shm (optional)
+ *           --hw-capture FILE: register traffic trace (optional)
+ *           /var/run/openvswitch/ops-fand.ckpt: warm restart checkpoint,
+ *               with --checkpoint (optional)
  *
  *
  * @}
@@ -111,14 +166,27 @@
 #define _FAND_LOCL_H_
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "shash.h"
 #include "fanspeed.h"
 #include "fanstatus.h"
 #include "config-yaml.h"
 
+struct fand_arena;
+struct fand_backend;
+struct fand_reg_io;
+struct fand_topo;
+struct locl_fan;
+
+/* index of a register access that the fan doesn't have */
+#define FAND_IO_NONE SIZE_MAX
+
 /* define a local structure to hold subsystem-related data,
-   including the fan speed override value */
+   including the fan speed override value. the structure, its fans and
+   everything they point to that is theirs live in "arena". */
 struct locl_subsystem {
+    struct fand_arena *arena;
     char *name;
     bool marked;
     bool valid;
@@ -128,9 +196,36 @@ struct locl_subsystem {
     enum fanspeed speed;          /* result of fan_speed, fan_speed_override */
     int multiplier;               /* from fans.yaml info */
     int numerator;                /* from fans.yaml info */
-    struct shash subsystem_fans;  /* struct locl_fan */
+    struct locl_fan *fans;        /* in hardware description order */
+    size_t n_fans;
+    const struct fand_topo *topo; /* fan hardware description, or NULL */
+    struct fand_backend *backend; /* register I/O, NULL if not valid */
+    struct fand_reg_io *sample_ios; /* reads for one sample of all fans */
+    size_t n_sample_ios;
+    size_t n_presence_ios;          /* ...the first of which are the fru
+                                       presence and direction reads */
+    struct fand_reg_io *fru_ios;    /* scratch for re-reading one fru's */
+    size_t *fru_io_idx;             /* ...sample_ios, and their indexes */
+    struct fand_reg_io *speed_ios;  /* fan speed control writes */
+    size_t n_speed_ios;
+    struct fand_reg_io *led_ios;    /* fru and subsystem led writes */
+    size_t n_led_ios;
+    uint64_t n_recoveries;          /* backend n_recoveries last seen */
+    uint64_t sweep_seq;             /* last sweep that sampled it */
+    bool rows_bound;                /* its fans have Fan rows, linked from
+                                       its Subsystem row */
+    bool warm_speed;                /* after a warm restart, the speed */
+    uint32_t warm_speed_value;      /* ...control registers hold this */
+    uint32_t *warm_led_values;      /* ...and the led_ios these, or NULL */
+    uint64_t n_warm_skips;          /* writes left out because of that */
 };
 
+/* iterate over the fans of a subsystem, with "FAN" pointing to each */
+#define LOCL_FAN_FOR_EACH(FAN, SUBSYSTEM)                               \
+    for ((FAN) = (SUBSYSTEM)->fans;                                     \
+         (FAN) < (SUBSYSTEM)->fans + (SUBSYSTEM)->n_fans;               \
+         (FAN)++)
+
 struct locl_fan {
     char *name;
     struct locl_subsystem *subsystem;
@@ -139,6 +234,31 @@ struct locl_fan {
     const char *direction;
     int rpm;
     enum fanstatus status;
+    long long int sample_usec;    /* wall clock time of last sample */
+    const YamlFanFru *fru;        /* fru that the fan belongs to */
+    size_t io_rpm;                /* indexes into subsystem sample_ios, */
+    size_t io_rpm_msb;            /* or FAND_IO_NONE */
+    size_t io_fault;
+    size_t io_present;
+    size_t io_direction;
+};
+
+/* daemon-wide counters, kept by fandsweep.c and fand.c and reported by the
+   exporters */
+struct fand_stats {
+    uint64_t n_sweeps;              /* completed fan status sweeps */
+    long long int last_sweep_usec;  /* duration of the last sweep */
+    long long int total_sweep_usec; /* sum of all sweep durations */
+    unsigned int last_sweep_slices; /* iterations the last sweep ran in */
+    uint64_t n_sweep_yields;        /* times a sweep ran out of budget */
+    uint64_t n_sweep_overruns;      /* iterations that exceeded the budget */
+    long long int takeover_usec;    /* from getting the lock to having
+                                       applied and published fan state */
+    long long int ready_usec;       /* from process start to setting
+                                       cur_hw */
+    uint64_t n_reconfigures;        /* reconfigures that saw an IDL change */
+    uint64_t n_txn_commits;         /* OVSDB transactions committed */
+    uint64_t n_txn_errors;          /* ...that did not succeed */
 };
 
 #endif /* _FAND_LOCL_H_ */
@@ -0,0 +1,70 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * USDT (user-level statically defined tracing) probe points for ops-fand.
+ *
+ * All probes live in the "ops_fand" provider and can be listed with
+ * "bpftrace -l 'usdt:/usr/bin/ops-fand:*'". When sys/sdt.h is not available
+ * at build time the probes compile to nothing.
+ *
+ *     sweep__start(n_subsystems)
+ *     sweep__end(n_fans, changed)
+ *     reg__read(subsystem, name, register_address, value, rc)
+ *     reg__write(subsystem, name, register_address, value, rc)
+ *     speed__change(subsystem, old_speed, new_speed, hw_value)
+ *     fru__event(subsystem, fru_number)
+ *     reconfigure__begin(idl_seqno)
+ *     reconfigure__end(n_subsystems)
+ *     txn__commit(what, n_changes)
+ *     txn__result(what, status)
+ ***************************************************************************/
+
+#ifndef _FAND_PROBES_H_
+#define _FAND_PROBES_H_
+
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+
+#define FAND_PROBE1(name, a) \
+    DTRACE_PROBE1(ops_fand, name, a)
+#define FAND_PROBE2(name, a, b) \
+    DTRACE_PROBE2(ops_fand, name, a, b)
+#define FAND_PROBE4(name, a, b, c, d) \
+    DTRACE_PROBE4(ops_fand, name, a, b, c, d)
+#define FAND_PROBE5(name, a, b, c, d, e) \
+    DTRACE_PROBE5(ops_fand, name, a, b, c, d, e)
+
+#else /* !HAVE_SYS_SDT_H */
+
+/* the arguments are still referenced (but never evaluated), so that values
+   computed only for a probe don't trigger unused variable warnings */
+#define FAND_PROBE1(name, a) \
+    do { if (0) { (void)(a); } } while (0)
+#define FAND_PROBE2(name, a, b) \
+    do { if (0) { (void)(a); (void)(b); } } while (0)
+#define FAND_PROBE4(name, a, b, c, d) \
+    do { if (0) { (void)(a); (void)(b); (void)(c); (void)(d); } } while (0)
+#define FAND_PROBE5(name, a, b, c, d, e) \
+    do { if (0) { (void)(a); (void)(b); (void)(c); (void)(d); \
+                  (void)(e); } } while (0)
+
+#endif /* HAVE_SYS_SDT_H */
+
+#endif /* _FAND_PROBES_H_ */
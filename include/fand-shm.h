@@ -0,0 +1,137 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Layout of the ops-fand live fan state shared memory segment, and the
+ * reader interface for it (libfandshm).
+ *
+ * ops-fand (started with --shm) rewrites the segment after every sweep.
+ * Writers and readers are synchronized with a sequence lock: the writer
+ * makes "seq" odd while it updates the segment and even again when done.
+ * A reader never blocks the daemon. It reads "seq", reads the data it
+ * wants directly from the mapping, and then checks that "seq" did not
+ * change:
+ *
+ *     const struct fand_shm *shm = fand_shm_open(NULL);
+ *     uint64_t seq;
+ *     int rpm;
+ *
+ *     do {
+ *         seq = fand_shm_read_begin(shm);
+ *         rpm = shm->fans[0].rpm;
+ *     } while (fand_shm_read_retry(shm, seq));
+ *
+ * The segment outlives ops-fand. When the daemon exits it sets "pid" to 0,
+ * and the data is then its last state, not live. If it was killed, "pid"
+ * is that of a process that no longer exists, and "update_usec" stops
+ * moving. Readers that need live data must check for both.
+ *
+ * The layout is fixed for a given FAND_SHM_VERSION, so readers don't need
+ * any ops-fand or OVS code.
+ ***************************************************************************/
+
+#ifndef _FAND_SHM_H_
+#define _FAND_SHM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* default POSIX shared memory object name */
+#define FAND_SHM_DEFAULT_NAME       "/ops-fand"
+
+#define FAND_SHM_MAGIC              0x444e4146  /* "FAND" */
+#define FAND_SHM_VERSION            1
+
+#define FAND_SHM_NAME_LEN           64
+#define FAND_SHM_MAX_SUBSYSTEMS     64
+#define FAND_SHM_MAX_FANS           1024
+
+/* per-subsystem state. speed values are enum fanspeed (fanspeed.h) */
+struct fand_shm_subsystem {
+    char name[FAND_SHM_NAME_LEN];
+    int32_t speed;                  /* speed applied to the fans */
+    int32_t fan_speed;              /* speed requested by temp sensors */
+    int32_t fan_speed_override;     /* configured override, -1 if none */
+    uint32_t first_fan;             /* index of first fan in fans[] */
+    uint32_t n_fans;                /* number of fans in fans[] */
+    uint32_t pad;
+};
+
+/* per-fan state. status is enum fanstatus (fanstatus.h), direction is enum
+   fandirection (fandirection.h) and speed is enum fanspeed (fanspeed.h) */
+struct fand_shm_fan {
+    char name[FAND_SHM_NAME_LEN];
+    uint32_t subsystem;             /* index in subsystems[] */
+    int32_t rpm;
+    int32_t status;
+    int32_t direction;
+    int32_t speed;
+    uint32_t pad;
+    int64_t sample_usec;            /* wall clock time of the sample */
+};
+
+struct fand_shm_header {
+    uint32_t magic;                 /* FAND_SHM_MAGIC */
+    uint32_t version;               /* FAND_SHM_VERSION */
+    uint32_t size;                  /* sizeof(struct fand_shm) */
+    int32_t pid;                    /* pid of the writing ops-fand, 0 once
+                                       it has exited */
+    uint64_t seq;                   /* sequence lock, odd while updating */
+    int64_t update_usec;            /* wall clock time of last update */
+    uint32_t n_subsystems;
+    uint32_t n_fans;
+};
+
+struct fand_shm {
+    struct fand_shm_header hdr;
+    struct fand_shm_subsystem subsystems[FAND_SHM_MAX_SUBSYSTEMS];
+    struct fand_shm_fan fans[FAND_SHM_MAX_FANS];
+};
+
+/* start a read-side critical section; returns the sequence to hand to
+   fand_shm_read_retry() */
+static inline uint64_t
+fand_shm_read_begin(const struct fand_shm *shm)
+{
+    return __atomic_load_n(&shm->hdr.seq, __ATOMIC_ACQUIRE);
+}
+
+/* end a read-side critical section. returns true if the data read since
+   fand_shm_read_begin() may be inconsistent and must be read again. */
+static inline bool
+fand_shm_read_retry(const struct fand_shm *shm, uint64_t seq)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return (seq & 1) || __atomic_load_n(&shm->hdr.seq, __ATOMIC_RELAXED) != seq;
+}
+
+/* map the segment "name" (FAND_SHM_DEFAULT_NAME if NULL) read-only.
+   returns NULL (with errno set) if it doesn't exist or has an unknown
+   layout. */
+const struct fand_shm *fand_shm_open(const char *name);
+
+/* unmap a segment returned by fand_shm_open() */
+void fand_shm_close(const struct fand_shm *shm);
+
+/* copy a consistent snapshot of the segment into "copy". returns 0 on
+   success, or EAGAIN if no consistent snapshot could be taken (e.g. the
+   writer died while updating). */
+int fand_shm_snapshot(const struct fand_shm *shm, struct fand_shm *copy);
+
+#endif /* _FAND_SHM_H_ */
@@ -0,0 +1,56 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for subsystem memory arenas.
+ *
+ * Each subsystem allocates its state (the struct locl_subsystem itself,
+ * its fans, their names and the register batches) from an arena of its
+ * own. Allocations are carved out of a few chunks and never freed one by
+ * one. Destroying the subsystem frees all of them at once, so adding and
+ * removing line cards over and over neither leaks nor fragments the heap.
+ ***************************************************************************/
+
+#ifndef _FANDARENA_H_
+#define _FANDARENA_H_
+
+#include <stddef.h>
+#include "compiler.h"
+
+struct fand_arena;
+
+/* create an empty arena */
+struct fand_arena *fand_arena_create(void);
+
+/* free everything allocated from "arena", and the arena itself */
+void fand_arena_destroy(struct fand_arena *arena);
+
+/* allocate "size" zeroed bytes, aligned for any type, that live until the
+   arena is destroyed */
+void *fand_arena_alloc(struct fand_arena *arena, size_t size);
+void *fand_arena_memdup(struct fand_arena *arena, const void *p, size_t size);
+char *fand_arena_strdup(struct fand_arena *arena, const char *s);
+char *fand_arena_asprintf(struct fand_arena *arena, const char *format, ...)
+    OVS_PRINTF_FORMAT(2, 3);
+
+/* bytes allocated from "arena", and bytes of chunks it holds */
+size_t fand_arena_used(const struct fand_arena *arena);
+size_t fand_arena_size(const struct fand_arena *arena);
+
+#endif /* _FANDARENA_H_ */
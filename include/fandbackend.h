@@ -0,0 +1,185 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for the fan hardware backends.
+ *
+ * Each subsystem does its register I/O through a backend, selected by the
+ * subsystem's other_config:fan_backend, or else the daemon default ("i2c",
+ * or "sim" / "replay" with --hw-sim / --hw-replay). The selection is
+ * "TYPE[:ARG]", where ARG is for the backend (e.g. "hwmon:DIR"). The fan logic only
+ * issues batches of reads and writes, so a backend is free to queue,
+ * reorder or overlap the accesses in a batch.
+ *
+ * A backend can also watch file descriptors that signal a change on a fan
+ * FRU (a fault or presence GPIO, a sysfs attribute that supports poll()).
+ * ops-fand waits on them in its poll loop and re-reads just that FRU when
+ * one fires.
+ *
+ * Each device (i2c_bit_op "device") of a backend has a circuit breaker.
+ * After FAND_BREAKER_THRESHOLD batches in a row in which none of the
+ * device's accesses worked, the breaker opens and accesses to the device
+ * are skipped (rc FAND_IO_SKIPPED) for a backoff period. Then one batch is
+ * let through (half-open): success closes the breaker, failure opens it
+ * again with twice the backoff.
+ ***************************************************************************/
+
+#ifndef _FANDBACKEND_H_
+#define _FANDBACKEND_H_
+
+#include <stdbool.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "shash.h"
+#include "config-yaml.h"
+#include "dynamic-string.h"
+
+/* rc of an access skipped because its device's breaker is open */
+#define FAND_IO_SKIPPED (-ECANCELED)
+
+#define FAND_BREAKER_THRESHOLD          3
+#define FAND_BREAKER_BACKOFF_MSEC       (10 * 1000)
+#define FAND_BREAKER_MAX_BACKOFF_MSEC   (320 * 1000)
+
+enum fand_breaker_state {
+    FAND_BREAKER_CLOSED,        /* device accessed normally */
+    FAND_BREAKER_OPEN,          /* device skipped until "retry_msec" */
+    FAND_BREAKER_HALF_OPEN      /* next accesses decide */
+};
+
+struct fand_breaker {
+    char *device;
+    enum fand_breaker_state state;
+    int n_failures;             /* consecutive failed batches */
+    long long int backoff_msec;
+    long long int retry_msec;   /* fand_clock_msec() */
+    uint64_t n_opens;
+    uint64_t n_skipped;
+    long long int failed_nsec;  /* time spent in failed accesses */
+    uint64_t batch;             /* fand_backend n_batches being counted */
+    bool batch_ok;              /* any access worked in "batch" */
+};
+
+/* one register access in a batch */
+struct fand_reg_io {
+    const i2c_bit_op *op;
+    const char *name;           /* fan, fru or control the register is for */
+    uint32_t value;             /* value read, or value to write */
+    int rc;                     /* result: 0 or an error */
+    struct fand_breaker *breaker; /* of op's device, set on first use */
+};
+
+/* a file descriptor that signals a change on a fan FRU */
+struct fand_watch {
+    int fd;
+    bool is_attr;               /* regular file: POLLPRI, re-armed by reading
+                                   it; otherwise POLLIN, drained */
+    const YamlFanFru *fru;
+};
+
+/* an open backend for one subsystem. implementations embed this as the
+   first member of their own structure. */
+struct fand_backend {
+    const struct fand_backend_class *class;
+    char *subsystem_name;
+    struct fand_watch *watches;
+    struct pollfd *pollfds;     /* one per watch */
+    size_t n_watches;
+    struct shash breakers;      /* struct fand_breaker, by device */
+    uint64_t n_batches;
+    uint64_t n_recoveries;      /* times a breaker has closed again */
+    struct fand_reg_io *scratch; /* batch without the skipped accesses */
+    size_t n_scratch;
+};
+
+struct fand_backend_class {
+    const char *type;
+
+    /* allocate and initialize a backend for subsystem "subsystem_name",
+       whose hardware description has been parsed. "arg" is the ARG of
+       "TYPE:ARG", or NULL. returns 0 or an errno value. */
+    int (*open)(const char *subsystem_name, const char *arg,
+                struct fand_backend **backendp);
+
+    /* free a backend */
+    void (*close)(struct fand_backend *backend);
+
+    /* perform all of the reads (writes) in "ios", setting each "rc" (and
+       "value" for reads) */
+    void (*read)(struct fand_backend *backend, struct fand_reg_io ios[],
+                 size_t n);
+    void (*write)(struct fand_backend *backend, struct fand_reg_io ios[],
+                  size_t n);
+
+    /* describe the backend's state for ops-fand/dump, as lines indented
+       by 8 spaces. may be NULL. */
+    void (*dump)(const struct fand_backend *backend, struct ds *ds);
+
+    /* true if batches on different backends of this class may run in
+       different threads at the same time */
+    bool concurrent;
+};
+
+extern const struct fand_backend_class fand_i2c_backend_class;
+extern const struct fand_backend_class fand_sim_backend_class;
+extern const struct fand_backend_class fand_replay_backend_class;
+extern const struct fand_backend_class fand_hwmon_backend_class;
+
+/* the backend type for subsystems that don't choose one */
+void fand_backend_set_default(const char *type);
+const char *fand_backend_get_default(void);
+
+/* open a backend of "type" ("TYPE[:ARG]", or NULL for the default) for a
+   subsystem. returns 0 or an errno value. */
+int fand_backend_open(const char *type, const char *subsystem_name,
+                      struct fand_backend **backendp);
+void fand_backend_close(struct fand_backend *backend);
+
+/* batch register access. these also capture the accesses (--hw-capture)
+   and fire the reg__read/reg__write probes. */
+void fand_backend_read(struct fand_backend *backend, struct fand_reg_io ios[],
+                       size_t n);
+void fand_backend_write(struct fand_backend *backend, struct fand_reg_io ios[],
+                        size_t n);
+
+/* report "fru" from fand_backend_poll_events() whenever "fd" fires. "fd"
+   remains owned by the caller and must outlive the backend. sysfs
+   attributes and GPIO value files fire on POLLPRI; pipes, eventfds and
+   the like on POLLIN. */
+void fand_backend_watch(struct fand_backend *backend, int fd,
+                        const YamlFanFru *fru);
+
+/* wait for any watched fd to fire */
+void fand_backend_wait(const struct fand_backend *backend);
+
+/* check the watched fds without blocking, re-arming those that fired.
+   stores up to "max" FRUs with an event in "frus" and returns how many.
+   more events are left for the next call. */
+size_t fand_backend_poll_events(struct fand_backend *backend,
+                                const YamlFanFru *frus[], size_t max);
+void fand_backend_dump(const struct fand_backend *backend, struct ds *ds);
+
+/* helper for backend implementations */
+void fand_backend_init(struct fand_backend *backend,
+                       const struct fand_backend_class *class,
+                       const char *subsystem_name);
+void fand_backend_uninit(struct fand_backend *backend);
+
+#endif /* _FANDBACKEND_H_ */
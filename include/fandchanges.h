@@ -0,0 +1,73 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for the fan state change log.
+ *
+ * Every change to a fan or subsystem attribute is given the next value of a
+ * monotonically increasing sequence number and recorded in a bounded log,
+ * so that consumers can ask for "everything that changed since N". The
+ * sequence starts again at 0 when the daemon restarts, so it comes with
+ * an epoch that identifies the instance.
+ ***************************************************************************/
+
+#ifndef _FANDCHANGES_H_
+#define _FANDCHANGES_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "dynamic-string.h"
+
+/* the kind of object a change belongs to */
+enum fand_change_object {
+    FAND_CHANGE_SUBSYSTEM,
+    FAND_CHANGE_FAN
+};
+
+/* record a change of "object" "name" attribute "attr" to "value".
+   "attr" is "added" or "removed" when the object itself comes or goes. */
+void fand_changes_record(enum fand_change_object object, const char *name,
+                         const char *attr, const char *value);
+
+/* record an integer valued change */
+void fand_changes_record_int(enum fand_change_object object, const char *name,
+                             const char *attr, int value);
+
+/* current high-water mark: the sequence number of the latest change */
+uint64_t fand_changes_seq(void);
+
+/* epoch of this instance's sequence numbers: nonzero, and different after
+   every restart */
+uint64_t fand_changes_epoch(void);
+
+/* append all changes newer than "since" of epoch "epoch" to "ds", one per
+   line:
+       <seq> <subsystem|fan> <name> <attr> <value>
+   returns false (and appends nothing) if "epoch" isn't this instance's or
+   changes after "since" have been dropped from the log, in which case the
+   consumer needs a full resync. */
+bool fand_changes_format(struct ds *ds, uint64_t epoch, uint64_t since);
+
+/* append a line in the same format as fand_changes_format(), for the current
+   value of an attribute, tagged with the current high-water mark */
+void fand_changes_format_state(struct ds *ds, enum fand_change_object object,
+                               const char *name, const char *attr,
+                               const char *value);
+
+#endif /* _FANDCHANGES_H_ */
@@ -0,0 +1,122 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for the warm restart checkpoint.
+ *
+ * With --checkpoint[=FILE], ops-fand keeps the last published state of
+ * every subsystem and fan, and the values last written to their speed
+ * control and LED registers, in a small file mapped into memory (by
+ * default ops-fand.ckpt in the run directory). Like the live fan state
+ * segment it has a fixed layout and a sequence number that is odd while
+ * it is being rewritten.
+ *
+ * When the daemon starts again in the same boot, each subsystem added
+ * takes its fans' status, direction and rpm and its speed from the file.
+ * The speed control and LED registers are read back, and those still
+ * holding the checkpointed values aren't written again until the values
+ * change. The Fan rows and LEDs then don't pass through "uninitialized"
+ * and the fans keep their speed.
+ ***************************************************************************/
+
+#ifndef _FANDCKPT_H_
+#define _FANDCKPT_H_
+
+#include <stdint.h>
+#include "shash.h"
+#include "dynamic-string.h"
+#include "fand-locl.h"
+
+/* default file name, in the run directory */
+#define FAND_CKPT_DEFAULT_NAME      "ops-fand.ckpt"
+
+#define FAND_CKPT_MAGIC             "FANDCKP"
+#define FAND_CKPT_VERSION           1
+#define FAND_CKPT_BYTE_ORDER        0x01020304
+
+#define FAND_CKPT_NAME_LEN          64
+#define FAND_CKPT_BOOT_ID_LEN       40
+#define FAND_CKPT_MAX_SUBSYSTEMS    64
+#define FAND_CKPT_MAX_FANS          1024
+#define FAND_CKPT_MAX_LEDS          32  /* per subsystem */
+
+/* per-subsystem state. speed values are enum fanspeed (fanspeed.h) */
+struct fand_ckpt_subsystem {
+    char name[FAND_CKPT_NAME_LEN];
+    int32_t speed;                  /* speed applied to the fans */
+    int32_t fan_speed;              /* speed requested by temp sensors */
+    uint32_t first_fan;             /* index of first fan in fans[] */
+    uint32_t n_fans;                /* number of fans in fans[] */
+    uint32_t n_speed_ios;           /* speed control registers */
+    uint32_t speed_value;           /* ...value last written to them */
+    uint32_t n_led_ios;             /* led registers, 0 if more than */
+    uint32_t pad;                   /* ...FAND_CKPT_MAX_LEDS */
+    uint32_t led_values[FAND_CKPT_MAX_LEDS]; /* values last written */
+};
+
+/* per-fan state. status is enum fanstatus (fanstatus.h), direction is enum
+   fandirection (fandirection.h) and speed is enum fanspeed (fanspeed.h) */
+struct fand_ckpt_fan {
+    char name[FAND_CKPT_NAME_LEN];
+    int32_t rpm;
+    int32_t status;
+    int32_t direction;
+    int32_t speed;
+    int64_t sample_usec;            /* wall clock time of the sample */
+};
+
+struct fand_ckpt_header {
+    char magic[8];                  /* FAND_CKPT_MAGIC */
+    uint32_t version;               /* FAND_CKPT_VERSION */
+    uint32_t byte_order;            /* FAND_CKPT_BYTE_ORDER */
+    uint32_t size;                  /* sizeof(struct fand_ckpt) */
+    int32_t pid;                    /* pid of the writing ops-fand */
+    uint64_t seq;                   /* odd while being rewritten */
+    int64_t update_usec;            /* wall clock time of last save */
+    char boot_id[FAND_CKPT_BOOT_ID_LEN]; /* kernel boot id when saved */
+    uint32_t n_subsystems;
+    uint32_t n_fans;
+};
+
+struct fand_ckpt {
+    struct fand_ckpt_header hdr;
+    struct fand_ckpt_subsystem subsystems[FAND_CKPT_MAX_SUBSYSTEMS];
+    struct fand_ckpt_fan fans[FAND_CKPT_MAX_FANS];
+};
+
+/* map checkpoint file "path" (created if needed), keeping the state the
+   previous instance left in it, if any, for fand_ckpt_restore(). returns
+   0 or a positive errno value. */
+int fand_ckpt_open(const char *path);
+
+/* give the newly created "subsystem" (with its sample, speed and led
+   register batches prepared) its checkpointed state, if the checkpoint
+   has it. call before first setting its speed. */
+void fand_ckpt_restore(struct locl_subsystem *subsystem);
+
+/* save the state of all subsystems (struct locl_subsystem, by name) */
+void fand_ckpt_save(const struct shash *subsystems);
+
+/* unmap the file. it's left in place for the next instance. */
+void fand_ckpt_close(void);
+
+/* describe the checkpoint and what was restored, for ops-fand/dump */
+void fand_ckpt_dump(struct ds *ds);
+
+#endif /* _FANDCKPT_H_ */
@@ -0,0 +1,62 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for the ops-fand clock.
+ *
+ * Normally this is the OVS clock (time_msec(), poll_timer_wait()). With
+ * --virtual-clock, time only moves when it is advanced: by an in-process
+ * test driver such as bench/fand-breaker-test.c calling
+ * fand_clock_advance(), or by fand_clock_run_until(), which steps
+ * the clock from one registered timer to the next so that every poll
+ * interval in between is run, as fast as the daemon can go.
+ ***************************************************************************/
+
+#ifndef _FANDCLOCK_H_
+#define _FANDCLOCK_H_
+
+#include <stdbool.h>
+
+/* switch to a virtual clock that starts at 0 msec, and at wall clock time
+   "wall_sec" (seconds since the epoch; negative for the current time) */
+void fand_clock_enable_virtual(long long int wall_sec);
+bool fand_clock_is_virtual(void);
+
+/* monotonic time in msec, and wall clock time in usec */
+long long int fand_clock_msec(void);
+long long int fand_clock_wall_usec(void);
+
+/* wake the poll loop after "msec", or at time "when" (fand_clock_msec()) */
+void fand_clock_timer_wait(long long int msec);
+void fand_clock_timer_wait_until(long long int when);
+
+/* move the virtual clock forward by "msec" at once, without running the
+   timers on the way (fand-breaker-test) */
+void fand_clock_advance(long long int msec);
+
+/* step the virtual clock forward by "msec", stopping at each timer on the
+   way. fand_clock_stepping() is true until the end is reached. */
+void fand_clock_run_until(long long int msec);
+bool fand_clock_stepping(void);
+
+/* call after all timers for this poll loop iteration have been registered.
+   takes the next step of fand_clock_run_until(). */
+void fand_clock_wait(void);
+
+#endif /* _FANDCLOCK_H_ */
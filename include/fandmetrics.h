@@ -0,0 +1,37 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for the Prometheus text format metrics exporter.
+ ***************************************************************************/
+
+#ifndef _FANDMETRICS_H_
+#define _FANDMETRICS_H_
+
+#include "shash.h"
+#include "fand-locl.h"
+
+/* write the metrics for all subsystems (struct locl_subsystem, by name) and
+   the daemon counters to "path". The file is written to a temporary file in
+   the same directory and renamed into place, so that a scraper never sees
+   a partial file. Returns 0 on success, otherwise a positive errno value. */
+int fand_metrics_write(const char *path, const struct shash *subsystems,
+                       const struct fand_stats *stats);
+
+#endif /* _FANDMETRICS_H_ */
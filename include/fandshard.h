@@ -0,0 +1,51 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for sharding subsystems across ops-fand instances.
+ *
+ * With --shard=SPEC an instance handles only the subsystems that SPEC
+ * selects, and takes an OVSDB lock of its own, so that several instances
+ * (each with its own standbys) can split a large chassis between them. It
+ * only does so once no unsharded instance holds the "ops_fand" lock.
+ ***************************************************************************/
+
+#ifndef _FANDSHARD_H_
+#define _FANDSHARD_H_
+
+#include <stdbool.h>
+
+/* handle only the subsystems selected by "spec": either "N/M", for hash
+   slot N (0 to M-1) of M, or a shell pattern (see fnmatch(3)) that the
+   subsystem name must match. returns NULL, or an error message that the
+   caller must free. */
+char *fand_shard_set(const char *spec);
+bool fand_shard_enabled(void);
+
+/* whether this instance handles subsystem "name" (always, if not
+   sharded) */
+bool fand_shard_owns(const char *name);
+
+/* the shard spec, or NULL, and the name of the OVSDB lock held by the
+   instance that controls its fans ("ops_fand" if not sharded) */
+const char *fand_shard_spec(void);
+const char *fand_shard_lock_name(void);
+
+#endif /* _FANDSHARD_H_ */
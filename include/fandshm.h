@@ -0,0 +1,46 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for the writer side of the live fan state shared memory
+ * segment (see fand-shm.h for the layout).
+ ***************************************************************************/
+
+#ifndef _FANDSHM_H_
+#define _FANDSHM_H_
+
+#include "shash.h"
+
+/* create (or reuse) and map the segment "name", and mark it as this
+   process's. only called by the instance that controls the fans, since it
+   invalidates what another one has published. called again after
+   regaining control, it claims the segment already mapped. returns 0 on
+   success, otherwise a positive errno value. */
+int fand_shm_create(const char *name);
+
+/* publish the state of all subsystems (struct locl_subsystem, by name) */
+void fand_shm_publish(const struct shash *subsystems);
+
+/* clear the pid in the segment (marking its data as no longer live), if
+   it is still this process's, and unmap it. the object is left in place,
+   so readers keep their mapping and a restarted daemon continues to
+   update the same segment. */
+void fand_shm_destroy(void);
+
+#endif /* _FANDSHM_H_ */
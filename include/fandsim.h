@@ -0,0 +1,67 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for the simulated fan controller.
+ *
+ * The "sim" backend (the default with --hw-sim) serves register reads and
+ * writes for the i2c_bit_ops of each subsystem's hardware description from
+ * in-memory registers instead of the i2c bus. Fan tachometers follow the written
+ * speed control value with a first order lag, and faults can be injected.
+ *
+ * The simulation is configured by a comma separated list of settings:
+ *
+ *     tau=MSEC                    fan spin up/down time constant (3000)
+ *     max-rpm=RPM                 fan speed at the "max" setting (18000)
+ *     seed=N                      random seed for injected NAKs
+ *     latency=DEVICE:USEC         delay every access to DEVICE
+ *     nak=DEVICE:PERCENT          fail PERCENT of the accesses to DEVICE
+ *     stuck=DEVICE:REG:MASK:VALUE force the MASK bits of register REG
+ *     unstuck=DEVICE:REG          remove forced bits from register REG
+ *     remove=SUBSYSTEM:FRU        fan FRU number FRU is pulled
+ *     insert=SUBSYSTEM:FRU        fan FRU number FRU is put back
+ *
+ * DEVICE is the device name from the hardware description, or "*" for
+ * all devices.
+ ***************************************************************************/
+
+#ifndef _FANDSIM_H_
+#define _FANDSIM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "config-yaml.h"
+#include "dynamic-string.h"
+
+/* set up the simulation with the settings in "spec" (may be empty).
+   returns NULL on success, otherwise an error message for the user (which
+   the caller must free). */
+char *fand_sim_enable(const char *spec);
+
+/* true once the simulation has been set up */
+bool fand_sim_enabled(void);
+
+/* apply more settings (e.g. fault injection) at runtime. same return
+   value as fand_sim_enable(). */
+char *fand_sim_configure(const char *spec);
+
+/* describe the simulation state, for ops-fand/dump */
+void fand_sim_dump(struct ds *ds);
+
+#endif /* _FANDSIM_H_ */
@@ -0,0 +1,91 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for subsystem and fan bookkeeping.
+ *
+ * These functions hold the fan logic that doesn't depend on OVSDB: loading
+ * a subsystem's hardware description, sampling its fans and applying the
+ * fan speed. fand.c maps the results onto the database.
+ ***************************************************************************/
+
+#ifndef _FANDSUBSYS_H_
+#define _FANDSUBSYS_H_
+
+#include "shash.h"
+#include "config-yaml.h"
+#include "fand-locl.h"
+
+/* all subsystems (struct locl_subsystem), by name */
+extern struct shash subsystem_data;
+/* all fans (struct locl_fan), by name, across all subsystems */
+extern struct shash fan_data;
+
+/* initialize the subsystem and fan dictionaries */
+void fand_subsystems_init(void);
+
+/* in standby another ops-fand instance controls the fans: subsystems are
+   still loaded, and their fans sampled, but nothing is written to the
+   hardware. leaving standby writes every subsystem's fan speed and LEDs. */
+void fand_subsystems_set_standby(bool standby);
+bool fand_subsystems_standby(void);
+
+/* create a subsystem from the hardware description in "hw_desc_dir" and
+   add it and its fans to subsystem_data and fan_data. "override" is the
+   configured fan_speed_override (or NULL), and "backend_type" the
+   configured fan_backend (or NULL for the default). the subsystem is always
+   added, but it is only valid (and has fans) if it has a usable fan
+   description and its backend opens. unless in standby, the fan speed is
+   applied to the hardware before returning. */
+struct locl_subsystem *fand_subsystem_create(const char *name,
+                                             const char *hw_desc_dir,
+                                             const char *override,
+                                             const char *backend_type);
+
+/* remove a subsystem and its fans from the dictionaries and free them,
+   along with its backend and hardware description */
+void fand_subsystem_destroy(struct locl_subsystem *subsystem);
+
+/* the fan of "subsystem" called "name" (its full name), or NULL */
+struct locl_fan *fand_subsystem_find_fan(
+    const struct locl_subsystem *subsystem, const char *name);
+
+/* read the current state of all fans in the subsystem */
+void fand_subsystem_sample(struct locl_subsystem *subsystem);
+
+/* sample "n" subsystems at once. the register reads of those whose backend
+   class is "concurrent" are done in parallel, on up to 8 threads. */
+void fand_subsystems_sample(struct locl_subsystem *subsystems[], size_t n);
+
+/* start reading the files in hardware description directory "dir" into
+   the page cache in the background, ahead of fand_subsystem_create() */
+void fand_subsystem_prefetch(const char *dir);
+
+/* re-read the fans of any FRU whose watched fds (see fandbackend.h) have
+   fired. returns true if there were any. */
+bool fand_subsystem_run_events(struct locl_subsystem *subsystem);
+
+/* apply the speed requested by the temperature sensors ("sensor_speed")
+   and the configured override (fan_speed_override string, or NULL) to the
+   subsystem's fans, and update the fan LEDs */
+void fand_subsystem_set_speed(struct locl_subsystem *subsystem,
+                              enum fanspeed sensor_speed,
+                              const char *override);
+
+#endif /* _FANDSUBSYS_H_ */
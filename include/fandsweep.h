@@ -0,0 +1,98 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for the fan sweep and publish cycle.
+ *
+ * Each poll loop iteration, the fans of FRUs whose events fired are
+ * re-read, and every sweep interval (or after a configuration change) all
+ * fans are sampled, spread over several iterations if a sweep budget is
+ * set. A complete sweep, or an event, is then published: to OVSDB through
+ * the update function that fand.c sets, and to the shared memory segment,
+ * the checkpoint and the metrics file. Nothing here depends on OVSDB, so
+ * test drivers run the same cycle with an update function of their own.
+ ***************************************************************************/
+
+#ifndef _FANDSWEEP_H_
+#define _FANDSWEEP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "fand-locl.h"
+
+/* daemon-wide counters */
+extern struct fand_stats fand_stats;
+
+/* write the state of the fans that differs from their Fan rows. returns
+   the number of columns written. */
+typedef int fand_sweep_update_func(void);
+
+/* configuration: the update function (NULL to publish nothing to OVSDB),
+   the time between sweeps and the time a sweep may take in one poll loop
+   iteration (0 for no limit), in msec (under the virtual clock, the
+   number of subsystems sampled in one iteration), whether to publish to
+   the shared memory segment and the checkpoint, and the metrics file (or
+   NULL) and how often to rewrite it, in msec */
+void fand_sweep_set_update(fand_sweep_update_func *update);
+void fand_sweep_set_interval(int msec);
+void fand_sweep_set_budget(int msec);
+int fand_sweep_budget(void);
+void fand_sweep_set_publish(bool shm, bool ckpt);
+void fand_sweep_set_metrics(const char *file, int interval_msec);
+
+/* subsystems have been added: their first samples are taken together at
+   the start of the next sweep slice */
+void fand_sweep_subsystems_added(void);
+
+/* re-read the fans of FRUs whose events fired, sweep all fans when it's
+   due (or "reconfigured" may have changed their speed), and publish. while
+   a sweep is in progress, only a complete sweep is published. in standby
+   only the cache is kept warm. */
+void fand_sweep_run(bool reconfigured);
+
+/* publish the last complete sweep again (on leaving standby). one still
+   in progress is published when it completes. */
+void fand_sweep_republish(void);
+
+/* wake the poll loop for the next sweep or sweep slice, and for the next
+   metrics file write */
+void fand_sweep_wait(void);
+
+/* the columns of a Fan row that ops-fand writes */
+struct fand_fan_row {
+    const char *status;
+    const char *speed;
+    const char *direction;
+    const int64_t *rpm;
+    size_t n_rpm;
+};
+
+#define FAND_FAN_ROW_STATUS     (1u << 0)
+#define FAND_FAN_ROW_SPEED      (1u << 1)
+#define FAND_FAN_ROW_DIRECTION  (1u << 2)
+#define FAND_FAN_ROW_RPM        (1u << 3)
+
+/* the columns of "row" (FAND_FAN_ROW_*) that differ from the state of
+   "fan". doesn't allocate, so that most sweeps, which change nothing,
+   don't either. */
+unsigned int fand_fan_row_diff(const struct fand_fan_row *row,
+                               const struct locl_fan *fan);
+
+#endif /* _FANDSWEEP_H_ */
@@ -0,0 +1,103 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for subsystem fan topologies.
+ *
+ * A topology is the fan part of a subsystem's hardware description: the
+ * YamlFanInfo and the fan FRUs with their fans and bit operations. All of
+ * ops-fand gets it from here rather than from the config-yaml lookups.
+ *
+ * With --hw-cache=DIR, the topology parsed from a hw_desc_dir is also
+ * written to a binary cache file in DIR. The cache file is keyed by the
+ * names, sizes and content hashes of the files in the directory, not by
+ * its path. While they match, later loads (after a restart, or of another
+ * directory with the same files) map the cache file and use the topology
+ * in it directly instead of parsing the fan description.
+ *
+ * Builds for fixed platforms can also compile topologies in (cmake
+ * -DFAND_BUILTIN_HWDESC=DIR[;DIR...], see build-aux/fand-gen-topo.py). A
+ * subsystem whose fans.yaml is byte for byte the one a built-in topology
+ * was generated from uses the const tables of that topology.
+ ***************************************************************************/
+
+#ifndef _FANDTOPO_H_
+#define _FANDTOPO_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config-yaml.h"
+#include "dynamic-string.h"
+
+enum fand_topo_source {
+    FAND_TOPO_YAML,             /* parsed from the hw_desc_dir */
+    FAND_TOPO_CACHE,            /* mapped from the --hw-cache file */
+    FAND_TOPO_BUILTIN           /* compiled in */
+};
+
+struct fand_topo {
+    YamlConfigHandle yaml;      /* config-yaml handle holding just this
+                                   subsystem's description */
+    const YamlFanInfo *info;    /* NULL if the subsystem has no fan info */
+    const YamlFanFru **frus;
+    int n_frus;
+    enum fand_topo_source source;
+};
+
+/* a compiled in topology, generated from a hw_desc_dir's fans.yaml */
+struct fand_topo_builtin {
+    const char *platform;       /* name of the hw_desc_dir */
+    uint64_t fans_size;         /* size of fans.yaml */
+    uint64_t fans_hash;         /* FNV-1a hash of fans.yaml */
+    const YamlFanInfo *info;
+    const YamlFanFru *const *frus;
+    int n_frus;
+};
+
+#ifdef HAVE_TOPO_BUILTINS
+extern const struct fand_topo_builtin fand_topo_builtins[];
+extern const size_t fand_topo_n_builtins;
+#endif
+
+/* cache topologies in directory "dir" (NULL to stop caching) */
+void fand_topo_set_cache_dir(const char *dir);
+
+/* load the topology of subsystem "name" from hardware description
+   directory "dir", adding the subsystem to a config-yaml handle of its
+   own. returns NULL if the description can't be loaded (the error is
+   logged). */
+const struct fand_topo *fand_topo_load(const char *name, const char *dir);
+
+/* the topology loaded for subsystem "name", or NULL */
+const struct fand_topo *fand_topo_find(const char *name);
+
+/* forget subsystem "name"'s topology, and free its config-yaml handle
+   with everything parsed into it */
+void fand_topo_unload(const char *name);
+
+/* parse subsystem "name"'s devices into its handle, for i2c register
+   access, and resolve the ones its fans use. only the fans are parsed when
+   a topology is loaded. returns 0 or the config-yaml error. */
+int fand_topo_need_devices(const char *name);
+
+/* describe the cache, for ops-fand/dump */
+void fand_topo_dump(struct ds *ds);
+
+#endif /* _FANDTOPO_H_ */
@@ -0,0 +1,112 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-fand
+ *
+ * @file
+ * Header file for capture and replay of hardware register traffic.
+ *
+ * With --hw-capture=FILE every register read and write is appended to a
+ * binary trace. With --hw-replay=FILE the trace is fed back to the daemon
+ * in place of the hardware, by the "replay" backend.
+ *
+ * A trace is a struct fand_trace_header followed by records. Each record
+ * starts with a one byte type. Subsystem and device names are interned: a
+ * FAND_TRACE_STRING record (struct fand_trace_string followed by "len"
+ * bytes, not NUL terminated) defines string "id" before its first use by a
+ * FAND_TRACE_READ or FAND_TRACE_WRITE record (struct fand_trace_access).
+ * All fields are in the byte order of the capturing host (see
+ * "byte_order").
+ ***************************************************************************/
+
+#ifndef _FANDTRACE_H_
+#define _FANDTRACE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "config-yaml.h"
+#include "dynamic-string.h"
+
+#define FAND_TRACE_MAGIC        "FANDTRC"
+#define FAND_TRACE_VERSION      1
+#define FAND_TRACE_BYTE_ORDER   0x01020304
+
+enum fand_trace_type {
+    FAND_TRACE_STRING = 1,
+    FAND_TRACE_READ = 2,
+    FAND_TRACE_WRITE = 3
+};
+
+struct fand_trace_header {
+    char magic[8];              /* FAND_TRACE_MAGIC */
+    uint32_t version;           /* FAND_TRACE_VERSION */
+    uint32_t byte_order;        /* FAND_TRACE_BYTE_ORDER */
+};
+
+struct fand_trace_string {
+    uint8_t type;               /* FAND_TRACE_STRING */
+    uint8_t pad;
+    uint16_t id;
+    uint16_t len;
+};
+
+struct fand_trace_access {
+    uint8_t type;               /* FAND_TRACE_READ or FAND_TRACE_WRITE */
+    uint8_t pad;
+    uint16_t subsystem;         /* string id */
+    uint16_t device;            /* string id */
+    uint16_t pad2;
+    uint32_t address;           /* i2c_bit_op register_address */
+    uint32_t mask;              /* i2c_bit_op bit_mask */
+    uint32_t value;             /* value read or written */
+    int32_t rc;                 /* result of the access */
+    uint32_t latency_nsec;      /* how long the access took */
+    uint64_t timestamp_usec;    /* wall clock time the access started */
+};
+
+/* start appending every register access to "path". returns 0 or an errno
+   value. */
+int fand_trace_capture_open(const char *path);
+
+/* load the trace in "path" to be replayed in place of the hardware. with
+   "max_speed" the recorded timing is ignored. returns 0 or an errno
+   value. */
+int fand_trace_replay_open(const char *path, bool max_speed);
+
+bool fand_trace_capturing(void);
+bool fand_trace_replaying(void);
+
+/* monotonic time in nanoseconds, for measuring access latency */
+long long int fand_trace_nsec(void);
+
+/* append an access made in a batch of "batch" accesses that started at
+   "start_nsec" (from fand_trace_nsec()) */
+void fand_trace_capture(enum fand_trace_type type, const char *subsystem_name,
+                        const i2c_bit_op *op, uint32_t value, int rc,
+                        long long int start_nsec, size_t batch);
+
+/* push buffered capture records to the file (e.g. after each sweep) */
+void fand_trace_flush(void);
+
+/* flush and close the capture file and drop any loaded replay trace */
+void fand_trace_close(void);
+
+/* describe the capture or replay state, for ops-fand/dump */
+void fand_trace_dump(struct ds *ds);
+
+#endif /* _FANDTRACE_H_ */
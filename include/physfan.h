@@ -28,4 +28,24 @@ void fand_set_fanspeed(struct locl_subsystem *subsystem);
 
 void fand_set_fanleds(struct locl_subsystem *subsystem);
 
+/* after a warm restart, the speed and led registers found to hold the
+   values checkpointed by the previous instance aren't written again until
+   a different value is set. this makes the next fand_set_fanspeed() and
+   fand_set_fanleds() write them regardless. */
+void fand_forget_warm(struct locl_subsystem *subsystem);
+
+/* build the subsystem's batches of register accesses from its hardware
+   description, once its fans exist. they are allocated from the
+   subsystem's arena. */
+void fand_prepare_io(struct locl_subsystem *subsystem);
+
+/* read the registers of every fan in the subsystem: the fru presence and
+   direction registers in one batch, then the speed and fault registers of
+   the fans whose fru is present in another */
+void fand_read_subsystem(struct locl_subsystem *subsystem);
+
+/* re-read just the sample_ios of the fans in "fru", in the same way */
+void fand_read_fru(struct locl_subsystem *subsystem, const YamlFanFru *fru);
+
+/* update "fan" from the last fand_read_subsystem() or fand_read_fru() */
 void fand_read_fan_status(struct locl_fan *fan);
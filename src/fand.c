@@ -25,6 +25,7 @@
 #define _GNU_SOURCE
 #include <errno.h>
 #include <getopt.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <signal.h>
 #include <stdlib.h>
@@ -59,6 +60,19 @@
 #include "physfan.h"
 #include "fand-locl.h"
 #include "eventlog.h"
+#include "fand-probes.h"
+#include "fandshm.h"
+#include "fand-shm.h"
+#include "fandchanges.h"
+#include "fandckpt.h"
+#include "fandsubsys.h"
+#include "fandbackend.h"
+#include "fandsim.h"
+#include "fandtrace.h"
+#include "fandclock.h"
+#include "fandshard.h"
+#include "fandsweep.h"
+#include "fandtopo.h"
 
 #define FAN_POLL_INTERVAL   5    /* OPS_TODO: should this be configurable? */
                                  /*             or should it be vendor spec? */
@@ -66,6 +80,12 @@
 
 #define MSEC_PER_SEC        1000
 
+/* with --shard, how often to check that no unsharded instance is running,
+   and how long "ops_fand" may stay held by another process before that is
+   taken to be one (another shard only holds it for a moment) */
+#define SHARD_CHECK_INTERVAL_MSEC   (FAN_POLL_INTERVAL * MSEC_PER_SEC)
+#define SHARD_CHECK_GRACE_MSEC      2000
+
 #define NAME_IN_DAEMON_TABLE "ops-fand"
 
 VLOG_DEFINE_THIS_MODULE(ops_fand);
@@ -77,24 +97,63 @@ static struct ovsdb_idl *idl;
 static unsigned int idl_seqno;
 
 static unixctl_cb_func fand_unixctl_dump;
+static unixctl_cb_func fand_unixctl_changes;
+static unixctl_cb_func fand_unixctl_hw_sim;
+static unixctl_cb_func fand_unixctl_clock_advance;
+
+static fand_sweep_update_func fand_update_fans;
 
 static bool cur_hw_set = false;
 
-/* define a shash (string hash) to hold the subsystems (by name) */
-struct shash subsystem_data;
-/* define a shash (string hash) to hold the fans (by name) */
-struct shash fan_data;
+/* metrics file (--metrics-file) and how often to rewrite it, in seconds */
+static char *metrics_file = NULL;
+static int metrics_interval = FAN_POLL_INTERVAL;
 
-/* global yaml config handle */
-YamlConfigHandle yaml_handle;
+/* time a sweep may run in one poll loop iteration (--sweep-budget), in
+   msec, or 0 for no limit */
+static int sweep_budget = 0;
 
-/* initialize the subsystem data (and the fan data) dictionaries */
-static void
-init_subsystems(void)
-{
-    shash_init(&subsystem_data);
-    shash_init(&fan_data);
-}
+/* live fan state shared memory segment (--shm) */
+static bool shm_enabled = false;
+static const char *shm_name = NULL;
+
+/* warm restart checkpoint (--checkpoint) */
+static bool ckpt_enabled = false;
+static const char *ckpt_file = NULL;
+
+/* register traffic capture (--hw-capture) and replay (--hw-replay) */
+static const char *capture_file = NULL;
+static const char *replay_file = NULL;
+static bool replay_max_speed = false;
+
+/* keep subsystems loaded and sampled while another instance holds the
+   lock (--hot-standby) */
+static bool hot_standby = false;
+
+/* whether this instance has taken over the fans since getting the lock */
+static bool has_control = false;
+
+/* with --shard, a second connection that requests the "ops_fand" lock of
+   an unsharded instance every SHARD_CHECK_INTERVAL_MSEC, to check that
+   none is running: before this instance requests its own lock, and for as
+   long as it runs. "shard_blocked" is set while one is. the checks are
+   timed with time_msec(), as the lock traffic runs in real time. */
+static struct ovsdb_idl *global_lock_idl = NULL;
+static bool shard_blocked = true;
+static bool shard_started = false;
+static long long int shard_check_start = LLONG_MIN;
+static long long int shard_check_next = LLONG_MIN;
+
+/* subsystems whose Fan rows are to be bound in the next fan state
+   transaction */
+static bool rows_pending = false;
+
+/* when the process started, and how long after that cur_hw was set
+   (time_usec()) */
+static long long int start_usec;
+
+/* ops-fand/clock-advance waiting for the virtual clock (--virtual-clock) */
+static struct unixctl_conn *clock_conn = NULL;
 
 struct ovsrec_fan *
 lookup_fan(const char *name)
@@ -110,170 +169,205 @@ lookup_fan(const char *name)
     return(NULL);
 }
 
-/* create a new subsystem structure and add all the dependent ports
-   as a side-effect, create all fans in the database */
-static struct locl_subsystem *
-add_subsystem(const struct ovsrec_subsystem *ovsrec_subsys)
+/* account for a committed transaction in the daemon counters */
+static void
+fand_count_txn(enum ovsdb_idl_txn_status txn_status)
 {
-    struct locl_subsystem *result;
-    int rc;
-    int total_fans;
-    unsigned int idx;
-    struct ovsdb_idl_txn *txn;
-    struct ovsrec_fan **fan_array;
-    int total_fan_idx;
-    int fan_fru_count;
-    const char *dir;
-    int fan_idx;
-    const YamlFanInfo *fan_info;
-    const char *override;
-    enum fanspeed override_value = FAND_SPEED_NONE;
-
-    VLOG_DBG("Adding new subsystem %s", ovsrec_subsys->name);
-    result = (struct locl_subsystem *)malloc(sizeof(struct locl_subsystem));
-    memset(result, 0, sizeof(struct locl_subsystem));
-    (void)shash_add(&subsystem_data, ovsrec_subsys->name, (void *)result);
-    result->name = strdup(ovsrec_subsys->name);
-    result->marked = false;
-    result->valid = false;
-    result->parent_subsystem = NULL;  /* OPS_TODO: find parent subsystem */
-    shash_init(&result->subsystem_fans);
-    override = smap_get(&ovsrec_subsys->other_config, "fan_speed_override");
-    if (override != NULL) {
-        override_value = fan_speed_string_to_enum(override);
-    }
-    result->fan_speed_override = override_value;
-
-    /* OPS_TODO: could check to see if the temp sensors have been populated
-       with data and use that for the sensor speed when initializing the
-       fan_speed value. */
-    result->fan_speed = FAND_SPEED_NORMAL;
-
-    /* use a default if the hw_desc_dir has not been populated */
-    dir = ovsrec_subsys->hw_desc_dir;
-
-    if (dir == NULL || strlen(dir) == 0) {
-        VLOG_ERR("No h/w description directory for subsystem %s",
-                 ovsrec_subsys->name);
-        return(NULL);
+    fand_stats.n_txn_commits++;
+    if (txn_status != TXN_SUCCESS && txn_status != TXN_UNCHANGED) {
+        fand_stats.n_txn_errors++;
     }
+}
 
-    /* since this is a new subsystem, load all of the hardware description
-       information about devices and fans (just for this subsystem).
-       parse fan and device data for subsystem */
-    rc = yaml_add_subsystem(yaml_handle, ovsrec_subsys->name, dir);
+/* compare the state of "fan" with its Fan row and, unless "dry_run", write
+   the columns that differ. returns the number of columns that differ. */
+static int
+fand_update_fan_row(const struct ovsrec_fan *db_fan,
+                    const struct locl_fan *fan, bool dry_run)
+{
+    struct fand_fan_row row = {
+        .status = db_fan->status,
+        .speed = db_fan->speed,
+        .direction = db_fan->direction,
+        .rpm = db_fan->rpm,
+        .n_rpm = db_fan->n_rpm,
+    };
+    unsigned int diff = fand_fan_row_diff(&row, fan);
+    int64_t rpm[1];
+    int changes = 0;
 
-    if (rc != 0) {
-        VLOG_ERR("Error getting h/w description information for subsystem %s",
-                 ovsrec_subsys->name);
-        return(NULL);
+    if (diff & FAND_FAN_ROW_STATUS) {
+        if (!dry_run) {
+            ovsrec_fan_set_status(db_fan,
+                                  fan_status_enum_to_string(fan->status));
+        }
+        changes++;
+    }
+    if (diff & FAND_FAN_ROW_SPEED) {
+        if (!dry_run) {
+            ovsrec_fan_set_speed(db_fan, fan_speed_enum_to_string(fan->speed));
+        }
+        changes++;
+    }
+    if (diff & FAND_FAN_ROW_DIRECTION) {
+        if (!dry_run) {
+            ovsrec_fan_set_direction(db_fan, fan->direction);
+        }
+        changes++;
+    }
+    if (diff & FAND_FAN_ROW_RPM) {
+        if (!dry_run) {
+            rpm[0] = fan->rpm;
+            ovsrec_fan_set_rpm(db_fan, rpm, 1);
+        }
+        changes++;
     }
+    return changes;
+}
 
-    rc = yaml_parse_devices(yaml_handle, ovsrec_subsys->name);
+/* compare every fan with its Fan row and, unless "dry_run", write the
+   columns that differ. returns the number of columns that differ. */
+static int
+fand_update_fan_rows(struct ovsdb_idl *idl, bool dry_run)
+{
+    const struct ovsrec_fan *db_fan;
+    int changes = 0;
 
-    if (rc != 0) {
-        VLOG_ERR("Unable to parse subsystem %s devices file (in %s)",
-                 ovsrec_subsys->name, dir);
-        return(NULL);
+    OVSREC_FAN_FOR_EACH(db_fan, idl) {
+        const struct locl_fan *fan = shash_find_data(&fan_data, db_fan->name);
+
+        /* NULL for another shard's fan */
+        if (fan != NULL) {
+            changes += fand_update_fan_row(db_fan, fan, dry_run);
+        }
     }
+    return changes;
+}
 
-    rc = yaml_parse_fans(yaml_handle, ovsrec_subsys->name);
+/* in "txn", create Fan rows for the fans of "subsystem" that don't have
+   one, and link them all from the Subsystem row. the fans have been
+   sampled: new rows get their state, and rows left by a previous instance
+   only the columns that differ. returns the number of fans. */
+static int
+fand_bind_fan_rows(struct ovsdb_idl_txn *txn,
+                   const struct ovsrec_subsystem *ovsrec_subsys,
+                   struct locl_subsystem *subsystem)
+{
+    int total_fans;
+    size_t idx;
+    struct ovsrec_fan **fan_array;
+    struct locl_fan *fan;
+    int64_t rpm[1];
 
-    if (rc != 0) {
-        VLOG_ERR("Unable to parse subsystem %s fan file (in %s)",
-                 ovsrec_subsys->name, dir);
-        return(NULL);
-    }
+    total_fans = subsystem->n_fans;
+    fan_array = (struct ovsrec_fan **)malloc(total_fans * sizeof(struct ovsrec_fan *));
+    memset(fan_array, 0, total_fans * sizeof(struct ovsrec_fan *));
 
-    fan_info = yaml_get_fan_info(yaml_handle, ovsrec_subsys->name);
+    /* walk through fans and add them to DB */
+    idx = 0;
+    LOCL_FAN_FOR_EACH(fan, subsystem) {
+        struct ovsrec_fan *ovs_fan;
 
-    if (fan_info == NULL) {
-        VLOG_INFO("subsystem %s has no fan info", ovsrec_subsys->name);
-        return(NULL);
-    }
+        /* look for existing Fan rows */
+        ovs_fan = lookup_fan(fan->name);
 
-    result->multiplier = fan_info->fan_speed_multiplier;
-    result->numerator  = fan_info->fan_speed_numerator;
+        if (ovs_fan == NULL) {
+            ovs_fan = ovsrec_fan_insert(txn);
+            ovsrec_fan_set_name(ovs_fan, fan->name);
+            ovsrec_fan_set_status(ovs_fan,
+                                  fan_status_enum_to_string(fan->status));
+            ovsrec_fan_set_direction(ovs_fan, fan->direction);
+            ovsrec_fan_set_speed(ovs_fan, fan_speed_enum_to_string(fan->speed));
+            rpm[0] = fan->rpm;
+            ovsrec_fan_set_rpm(ovs_fan, rpm, 1);
+        } else {
+            fand_update_fan_row(ovs_fan, fan, false);
+        }
 
-    /* count the total fans in the subsystem */
-    total_fans = 0;
-    total_fan_idx = 0;
+        fan_array[idx++] = ovs_fan;
+    }
 
-    fan_fru_count = yaml_get_fan_fru_count(yaml_handle, ovsrec_subsys->name);
+    ovsrec_subsystem_set_fans(ovsrec_subsys, fan_array, total_fans);
+    free(fan_array);
 
-    VLOG_DBG("There are %d fan FRUS in subsystem %s", fan_fru_count, ovsrec_subsys->name);
+    subsystem->rows_bound = true;
+    return total_fans;
+}
 
-    if (fan_fru_count <= 0) {
-        return(NULL);
+/* in "txn", bind the Fan rows of all subsystems added since the last
+   time whose fans have been sampled from the hardware. returns the number
+   of fans. */
+static int
+fand_bind_pending_rows(struct ovsdb_idl_txn *txn)
+{
+    const struct ovsrec_subsystem *cfg;
+    int n_fans = 0;
+
+    if (!rows_pending || fand_subsystems_standby()) {
+        return 0;
     }
 
-    result->valid = true;
+    rows_pending = false;
+    OVSREC_SUBSYSTEM_FOR_EACH(cfg, idl) {
+        struct locl_subsystem *subsystem;
 
-    for (idx = 0; idx < fan_fru_count; idx++) {
-        const YamlFanFru *fan_fru = yaml_get_fan_fru(yaml_handle, ovsrec_subsys->name, idx);
-        /* each FanFru has one or more fans */
-        for (fan_idx = 0; fan_fru->fans[fan_idx] != NULL; fan_idx++) {
-            ++total_fans;
+        subsystem = shash_find_data(&subsystem_data, cfg->name);
+        if (subsystem == NULL || !subsystem->valid || subsystem->rows_bound) {
+            continue;
         }
+        if (subsystem->sweep_seq == 0) {
+            /* not sampled yet (the state it has may only be restored from
+               the checkpoint) */
+            rows_pending = true;
+            continue;
+        }
+        n_fans += fand_bind_fan_rows(txn, cfg, subsystem);
     }
+    return n_fans;
+}
 
-    fan_array = (struct ovsrec_fan **)malloc(total_fans * sizeof(struct ovsrec_fan *));
-    memset(fan_array, 0, total_fans * sizeof(struct ovsrec_fan *));
-
-    txn = ovsdb_idl_txn_create(idl);
-
-    VLOG_DBG("There are %d total fans in subsystem %s", total_fans, ovsrec_subsys->name);
-    log_event("FAN_COUNT", EV_KV("count", "%d", total_fans),
-        EV_KV("subsystem", "%s", ovsrec_subsys->name ));
-
-    /* TODO walk through fans and add them to DB */
-    for (idx = 0; idx < fan_fru_count; idx++) {
-        const YamlFanFru *fan_fru = yaml_get_fan_fru(yaml_handle, ovsrec_subsys->name, idx);
-
-        /* each FanFru has one or more fans */
-        for (fan_idx = 0; fan_fru->fans[fan_idx] != NULL; fan_idx++) {
-            struct ovsrec_fan *ovs_fan;
-            char *fan_name = NULL;
-            const YamlFan *fan = fan_fru->fans[fan_idx];
-            struct locl_fan *new_fan;
-            VLOG_DBG("Adding fan %s in subsystem %s",
-                fan->name,
-                ovsrec_subsys->name);
-
-            asprintf(&fan_name, "%s-%s", ovsrec_subsys->name, fan->name);
-            new_fan = (struct locl_fan *)malloc(sizeof(struct locl_fan));
-            new_fan->name = fan_name;
-            new_fan->subsystem = result;
-            new_fan->yaml_fan = fan;
-
-            shash_add(&result->subsystem_fans, fan_name, (void *)new_fan);
-            shash_add(&fan_data, fan_name, (void *)new_fan);
-
-            /* look for existing Fan rows */
-            ovs_fan = lookup_fan(fan_name);
-
-            if (ovs_fan == NULL) {
-                ovs_fan = ovsrec_fan_insert(txn);
-            }
-
-            ovsrec_fan_set_name(ovs_fan, fan_name);
-            ovsrec_fan_set_status(ovs_fan,
-                fan_status_enum_to_string(FAND_STATUS_UNINITIALIZED));
-            /* OPS_TODO: these have to be set, but "f2b" and "normal"
-               may not be the right values for defaults. */
-            ovsrec_fan_set_direction(ovs_fan, "f2b");
-            ovsrec_fan_set_speed(ovs_fan, fan_speed_enum_to_string(FAND_SPEED_NORMAL));
+/* check whether the Subsystem row links a Fan row for every fan of
+   "subsystem", as left by the active ops-fand */
+static bool
+fand_fan_rows_bound(const struct ovsrec_subsystem *ovsrec_subsys,
+                    const struct locl_subsystem *subsystem)
+{
+    size_t idx;
 
-            fan_array[total_fan_idx++] = ovs_fan;
+    if (ovsrec_subsys->n_fans != subsystem->n_fans) {
+        return false;
+    }
+    for (idx = 0; idx < ovsrec_subsys->n_fans; idx++) {
+        if (fand_subsystem_find_fan(subsystem,
+                                    ovsrec_subsys->fans[idx]->name) == NULL) {
+            return false;
         }
     }
+    return true;
+}
 
-    ovsrec_subsystem_set_fans(ovsrec_subsys, fan_array, total_fans);
-    ovsdb_idl_txn_commit_block(txn);
-    ovsdb_idl_txn_destroy(txn);
-    free(fan_array);
+/* create a new subsystem structure and add all the dependent ports
+   as a side-effect, create all fans in the database (in standby, only
+   check that the active ops-fand has) */
+static struct locl_subsystem *
+add_subsystem(const struct ovsrec_subsystem *ovsrec_subsys)
+{
+    struct locl_subsystem *result;
 
-    fand_set_fanspeed(result);
+    result = fand_subsystem_create(ovsrec_subsys->name,
+                                   ovsrec_subsys->hw_desc_dir,
+                                   smap_get(&ovsrec_subsys->other_config,
+                                            "fan_speed_override"),
+                                   smap_get(&ovsrec_subsys->other_config,
+                                            "fan_backend"));
+    if (!result->valid) {
+        return(NULL);
+    }
+
+    /* the rows are created along with the first fan state published, in
+       the same transaction as those of other subsystems added meanwhile */
+    rows_pending = true;
+    fand_sweep_subsystems_added();
 
     return(result);
 }
@@ -320,32 +414,12 @@ static void
 fand_remove_unmarked_subsystems(void)
 {
     struct shash_node *node, *next;
-    struct shash_node *fan_node, *fan_next;
-    struct shash_node *global_node;
 
     SHASH_FOR_EACH_SAFE(node, next, &subsystem_data) {
         struct locl_subsystem *subsystem = node->data;
 
         if (subsystem->marked == false) {
-            /* also, delete all fans in the subsystem */
-            SHASH_FOR_EACH_SAFE(fan_node, fan_next, &subsystem->subsystem_fans) {
-                struct locl_fan *fan = (struct locl_fan *)fan_node->data;
-                /* delete the fan_data entry */
-                global_node = shash_find(&fan_data, fan->name);
-                shash_delete(&fan_data, global_node);
-                /* delete the subsystem entry */
-                shash_delete(&subsystem->subsystem_fans, fan_node);
-                /* free the allocated data */
-                free(fan->name);
-                free(fan);
-            }
-            free(subsystem->name);
-            free(subsystem);
-
-            shash_delete(&subsystem_data, node);
-
-            /* OPS_TODO: need to remove subsystem yaml data
-                           verify that ovsdb has deleted the fans (automatic) */
+            fand_subsystem_destroy(subsystem);
         }
     }
 }
@@ -356,15 +430,21 @@ fand_init(const char *remote)
 {
     int retval = 0;
 
-    /* initialize subsystems */
-    init_subsystems();
-
-    /* initialize the yaml handle */
-    yaml_handle = yaml_new_config_handle();
+    /* initialize subsystems and the yaml handle */
+    fand_subsystems_init();
 
     idl = ovsdb_idl_create(remote, &ovsrec_idl_class, false, true);
     idl_seqno = ovsdb_idl_get_seqno(idl);
-    ovsdb_idl_set_lock(idl, "ops_fand");
+    if (fand_shard_enabled()) {
+        /* the shard's own lock is requested once no unsharded instance is
+           found running (fand_shard_check_global_lock()) */
+        global_lock_idl = ovsdb_idl_create(remote, &ovsrec_idl_class, false,
+                                           true);
+        VLOG_INFO("handling subsystems \"%s\" (lock %s)",
+                  fand_shard_spec(), fand_shard_lock_name());
+    } else {
+        ovsdb_idl_set_lock(idl, fand_shard_lock_name());
+    }
     ovsdb_idl_verify_write_only(idl);
 
     /* register interest in daemon table */
@@ -407,6 +487,49 @@ fand_init(const char *remote)
 
     unixctl_command_register("ops-fand/dump", "", 0, 0,
                              fand_unixctl_dump, NULL);
+    unixctl_command_register("ops-fand/changes", "epoch:since-seq", 1, 1,
+                             fand_unixctl_changes, NULL);
+    if (fand_sim_enabled()) {
+        unixctl_command_register("ops-fand/hw-sim", "setting[,setting...]",
+                                 1, 1, fand_unixctl_hw_sim, NULL);
+    }
+    if (fand_clock_is_virtual()) {
+        unixctl_command_register("ops-fand/clock-advance", "msec", 1, 1,
+                                 fand_unixctl_clock_advance, NULL);
+    }
+
+    /* each shard publishes to a segment and keeps a checkpoint of its own,
+       named after its lock, unless told otherwise */
+    if (shm_enabled && shm_name == NULL && fand_shard_enabled()) {
+        shm_name = xasprintf("/%s", fand_shard_lock_name());
+    }
+    if (ckpt_enabled) {
+        char *path = (ckpt_file ? xstrdup(ckpt_file)
+                      : fand_shard_enabled()
+                      ? xasprintf("%s/%s.ckpt", ovs_rundir(),
+                                  fand_shard_lock_name())
+                      : xasprintf("%s/%s", ovs_rundir(),
+                                  FAND_CKPT_DEFAULT_NAME));
+
+        if (fand_ckpt_open(path) != 0) {
+            ckpt_enabled = false;
+        }
+        free(path);
+    }
+
+    fand_sweep_set_update(fand_update_fans);
+    fand_sweep_set_interval(FAN_POLL_INTERVAL * MSEC_PER_SEC);
+    fand_sweep_set_budget(sweep_budget);
+    fand_sweep_set_publish(shm_enabled, ckpt_enabled);
+    fand_sweep_set_metrics(metrics_file, metrics_interval * MSEC_PER_SEC);
+
+    if (replay_file != NULL
+            && fand_trace_replay_open(replay_file, replay_max_speed) != 0) {
+        VLOG_FATAL("unable to replay %s", replay_file);
+    }
+    if (capture_file != NULL) {
+        fand_trace_capture_open(capture_file);
+    }
 
     retval = event_log_init("FAN");
     if(retval < 0) {
@@ -417,61 +540,38 @@ fand_init(const char *remote)
 static void
 fand_exit(void)
 {
+    fand_shm_destroy();
+    fand_ckpt_close();
+    fand_trace_close();
+    if (global_lock_idl != NULL) {
+        ovsdb_idl_destroy(global_lock_idl);
+    }
     ovsdb_idl_destroy(idl);
 }
 
-static void
-fand_read_status(struct ovsdb_idl *idl)
+/* write the cached state of every fan that differs from its DB row.
+   returns the number of columns changed. */
+static int
+fand_update_fans(void)
 {
-    const struct ovsrec_fan *db_fan;
     const struct ovsrec_daemon *db_daemon;
-    const struct shash_node *node;
-    const struct shash_node *fan_node;
     struct ovsdb_idl_txn *txn;
-    int64_t rpm[1];
-    bool change;
+    enum ovsdb_idl_txn_status txn_status;
+    int changes;
 
-    /* read all fan status */
-    SHASH_FOR_EACH(node, &subsystem_data) {
-        struct locl_subsystem *subsystem = (struct locl_subsystem *)node->data;
-        SHASH_FOR_EACH(fan_node, &subsystem->subsystem_fans) {
-            struct locl_fan *fan;
-            fan = (struct locl_fan *)fan_node->data;
-            fan->speed = subsystem->speed;
-            fand_read_fan_status(fan);
-            VLOG_DBG("fan %s rpm set to %d\n", fan->name, fan->rpm);
-        }
+    /* most sweeps change nothing. comparing with the rows doesn't allocate,
+       so only a sweep with something to write pays for a transaction. */
+    if (!rows_pending && cur_hw_set && !fand_update_fan_rows(idl, true)) {
+        return 0;
     }
 
     txn = ovsdb_idl_txn_create(idl);
 
-    change = false;
-    /* walk through each fan in DB and update status from cached data */
-    OVSREC_FAN_FOR_EACH(db_fan, idl) {
-        struct locl_fan *fan;
-        fan_node = shash_find(&fan_data, db_fan->name);
-        fan = (struct locl_fan *)fan_node->data;
+    /* new subsystems' rows go in along with their first state */
+    changes = fand_bind_pending_rows(txn);
 
-        const char *status = fan_status_enum_to_string(fan->status);
-        if (strcmp(db_fan->status, status) != 0) {
-            ovsrec_fan_set_status(db_fan, status);
-            change = true;
-        }
-        const char *speed = fan_speed_enum_to_string(fan->speed);
-        if (strcmp(db_fan->speed, speed) != 0) {
-            ovsrec_fan_set_speed(db_fan, speed);
-            change = true;
-        }
-        if (strcmp(db_fan->direction, fan->direction) != 0) {
-            ovsrec_fan_set_direction(db_fan, fan->direction);
-            change = true;
-        }
-        if (db_fan->rpm == NULL || db_fan->rpm[0] != fan->rpm) {
-            rpm[0] = fan->rpm;
-            ovsrec_fan_set_rpm(db_fan, rpm, 1);
-            change = true;
-        }
-    }
+    /* walk through each fan in DB and update status from cached data */
+    changes += fand_update_fan_rows(idl, false);
 
     /* Set cur_hw = 1 if this is first time through. */
     if (!cur_hw_set) {
@@ -479,26 +579,106 @@ fand_read_status(struct ovsdb_idl *idl)
             if (strcmp(db_daemon->name, NAME_IN_DAEMON_TABLE) == 0) {
                 ovsrec_daemon_set_cur_hw(db_daemon, (int64_t) 1);
                 cur_hw_set = true;
-                change = true;
+                changes++;
                 break;
             }
         }
     }
 
-    if (change) {
-        ovsdb_idl_txn_commit_block(txn);
+    if (changes) {
+        FAND_PROBE2(txn__commit, "fan_status", changes);
+        txn_status = ovsdb_idl_txn_commit_block(txn);
+        FAND_PROBE2(txn__result, "fan_status", txn_status);
+        fand_count_txn(txn_status);
+
+        if (cur_hw_set && fand_stats.ready_usec == 0) {
+            fand_stats.ready_usec = time_usec() - start_usec;
+            VLOG_INFO("fans ready (cur_hw set) %lld ms after start",
+                      fand_stats.ready_usec / 1000);
+        }
     }
 
     ovsdb_idl_txn_destroy(txn);
+
+    return changes;
 }
 
-static void
-fand_run__(void)
+/* with --shard, check for an unsharded instance, which holds the
+   "ops_fand" lock and controls every fan: request that lock, and give it
+   up as soon as it is granted. the shard's own lock is requested after the
+   first check. if the lock stays held elsewhere for SHARD_CHECK_GRACE_MSEC
+   the shard stops, keeping its own lock, until it is granted again, and
+   then takes control of its fans again. returns true if the shard may
+   run. */
+static bool
+fand_shard_check_global_lock(void)
 {
-    fand_read_status(idl);
+    long long int now = time_msec();
+
+    if (global_lock_idl == NULL) {
+        return true;
+    }
+
+    ovsdb_idl_run(global_lock_idl);
+    if (ovsdb_idl_has_lock(global_lock_idl)) {
+        ovsdb_idl_set_lock(global_lock_idl, NULL);
+        shard_check_start = LLONG_MIN;
+        shard_check_next = now + SHARD_CHECK_INTERVAL_MSEC;
+        if (!shard_started) {
+            ovsdb_idl_set_lock(idl, fand_shard_lock_name());
+            shard_started = true;
+        } else if (shard_blocked) {
+            VLOG_INFO("lock ops_fand is free again, resuming shard \"%s\"",
+                      fand_shard_spec());
+        }
+        shard_blocked = false;
+    } else if (shard_check_start == LLONG_MIN) {
+        if (now >= shard_check_next) {
+            ovsdb_idl_set_lock(global_lock_idl, "ops_fand");
+            shard_check_start = now;
+        }
+    } else if (ovsdb_idl_is_lock_contended(global_lock_idl)
+               && (!shard_started
+                   || now >= shard_check_start + SHARD_CHECK_GRACE_MSEC)) {
+        static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 1);
+
+        if (!shard_blocked) {
+            VLOG_ERR("another ops-fand process holds lock ops_fand, "
+                     "stopping shard \"%s\" until it goes away",
+                     fand_shard_spec());
+            shard_blocked = true;
+            /* the speeds and leds are written again on resuming, as on a
+               takeover from standby */
+            fand_subsystems_set_standby(true);
+            has_control = false;
+        } else {
+            VLOG_ERR_RL(&rl, "another ops-fand process holds lock ops_fand, "
+                        "not running shard \"%s\" until it goes away",
+                        fand_shard_spec());
+        }
+    }
+    return !shard_blocked;
 }
 
+/* wake the poll loop for the next check for an unsharded instance, or for
+   the end of the grace period of the one in progress */
 static void
+fand_shard_wait(void)
+{
+    if (global_lock_idl == NULL) {
+        return;
+    }
+
+    ovsdb_idl_wait(global_lock_idl);
+    if (shard_check_start == LLONG_MIN) {
+        poll_timer_wait_until(shard_check_next);
+    } else if (!shard_blocked) {
+        poll_timer_wait_until(shard_check_start + SHARD_CHECK_GRACE_MSEC);
+    }
+}
+
+/* returns true if the configuration changed */
+static bool
 fand_reconfigure(struct ovsdb_idl *idl)
 {
     const struct ovsrec_subsystem *cfg;
@@ -507,20 +687,35 @@ fand_reconfigure(struct ovsdb_idl *idl)
     COVERAGE_INC(fand_reconfigure);
 
     if (new_idl_seqno == idl_seqno){
-        return;
+        return false;
     }
 
     idl_seqno = new_idl_seqno;
+    fand_stats.n_reconfigures++;
+
+    FAND_PROBE1(reconfigure__begin, idl_seqno);
 
     fand_unmark_subsystems();
 
+    /* start reading the hardware descriptions of all new subsystems, so
+       that they're parsed from memory one after the other */
+    OVSREC_SUBSYSTEM_FOR_EACH(cfg, idl) {
+        if (fand_shard_owns(cfg->name)
+                && !shash_find(&subsystem_data, cfg->name)) {
+            fand_subsystem_prefetch(cfg->hw_desc_dir);
+        }
+    }
+
     OVSREC_SUBSYSTEM_FOR_EACH(cfg, idl) {
-        const char *override = NULL;
-        enum fanspeed override_value;
         struct locl_subsystem *subsystem;
         size_t idx;
         enum fanspeed highest = FAND_SPEED_SLOW;
 
+        /* another shard's subsystem */
+        if (!fand_shard_owns(cfg->name)) {
+            continue;
+        }
+
         subsystem = get_subsystem(cfg);
 
         /* Skip if this subsystem is to be ignored. */
@@ -528,6 +723,10 @@ fand_reconfigure(struct ovsdb_idl *idl)
             continue;
         }
 
+        if (fand_subsystems_standby()) {
+            subsystem->rows_bound = fand_fan_rows_bound(cfg, subsystem);
+        }
+
         /* find the highest fan_state value in the subsystem */
         for (idx = 0; idx < cfg->n_temp_sensors; idx++) {
             struct ovsrec_temp_sensor *sensor = cfg->temp_sensors[idx];
@@ -537,18 +736,11 @@ fand_reconfigure(struct ovsdb_idl *idl)
                 highest = speed;
             }
         }
-        /* record that as the current speed by sensor */
-        subsystem->fan_speed = highest;
-
-        /* but also check to see if we have an override value */
-        override = smap_get(&cfg->other_config, "fan_speed_override");
-        override_value = fan_speed_string_to_enum(override);
-        if (subsystem->fan_speed_override != override_value) {
-            subsystem->fan_speed_override = override_value;
-        }
-
-        fand_set_fanspeed(subsystem);
-        fand_set_fanleds(subsystem);
+        /* record that as the current speed by sensor, and apply it along
+           with any override value */
+        fand_subsystem_set_speed(subsystem, highest,
+                                 smap_get(&cfg->other_config,
+                                          "fan_speed_override"));
 
         /* "mark" the subsystem, to indicate that it is still present */
         subsystem->marked = true;
@@ -556,26 +748,87 @@ fand_reconfigure(struct ovsdb_idl *idl)
 
     /* delete all subsystems that aren't actually present in the DB */
     fand_remove_unmarked_subsystems();
+
+    FAND_PROBE1(reconfigure__end, shash_count(&subsystem_data));
+    return true;
 }
 
+/* this instance has just got the lock: take control of the fans, publish
+   their state and log how long that took. a hot standby has its
+   subsystems loaded and a sample of all fans at hand already. */
 static void
-fand_run(void)
+fand_takeover(void)
 {
-    ovsdb_idl_run(idl);
+    const struct ovsrec_subsystem *cfg;
+    long long int start = time_usec();
+    bool warm = fand_subsystems_standby();
+
+    /* the segment belongs to whoever controls the fans, so it isn't
+       touched before */
+    if (shm_enabled && fand_shm_create(shm_name) != 0) {
+        shm_enabled = false;
+        fand_sweep_set_publish(shm_enabled, ckpt_enabled);
+    }
 
-    if (ovsdb_idl_is_lock_contended(idl)) {
-        static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 1);
+    if (warm) {
+        fand_subsystems_set_standby(false);
 
-        VLOG_ERR_RL(&rl, "another ops-fand process is running, "
-                    "disabling this process until it goes away");
+        OVSREC_SUBSYSTEM_FOR_EACH(cfg, idl) {
+            struct locl_subsystem *subsystem;
 
-        return;
-    } else if (!ovsdb_idl_has_lock(idl)) {
+            subsystem = shash_find_data(&subsystem_data, cfg->name);
+            if (subsystem != NULL && subsystem->valid
+                    && !fand_fan_rows_bound(cfg, subsystem)) {
+                subsystem->rows_bound = false;
+                rows_pending = true;
+            }
+        }
+
+        fand_sweep_republish();
+    }
+
+    fand_sweep_run(fand_reconfigure(idl));
+
+    fand_stats.takeover_usec = time_usec() - start;
+    VLOG_INFO("took over fan control in %lld ms (%s)",
+              fand_stats.takeover_usec / 1000,
+              warm ? "hot standby" : "cold start");
+}
+
+static void
+fand_run(void)
+{
+    ovsdb_idl_run(idl);
+
+    if (!fand_shard_check_global_lock()) {
         return;
     }
 
-    fand_reconfigure(idl);
-    fand_run__();
+    if (!ovsdb_idl_has_lock(idl)) {
+        if (ovsdb_idl_is_lock_contended(idl)) {
+            static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 1);
+
+            if (hot_standby) {
+                VLOG_INFO_RL(&rl, "another ops-fand process is running, "
+                             "standing by until it goes away");
+            } else {
+                VLOG_ERR_RL(&rl, "another ops-fand process is running, "
+                            "disabling this process until it goes away");
+            }
+        }
+        has_control = false;
+        if (!hot_standby) {
+            return;
+        }
+
+        fand_subsystems_set_standby(true);
+        fand_sweep_run(fand_reconfigure(idl));
+    } else if (!has_control) {
+        fand_takeover();
+        has_control = true;
+    } else {
+        fand_sweep_run(fand_reconfigure(idl));
+    }
 
     daemonize_complete();
     vlog_enable_async();
@@ -585,8 +838,32 @@ fand_run(void)
 static void
 fand_wait(void)
 {
+    struct shash_node *node;
+
     ovsdb_idl_wait(idl);
-    poll_timer_wait(FAN_POLL_INTERVAL * MSEC_PER_SEC);
+    fand_shard_wait();
+    if ((ovsdb_idl_has_lock(idl) || hot_standby)
+            && (global_lock_idl == NULL || !shard_blocked)) {
+        fand_sweep_wait();
+    } else {
+        fand_clock_timer_wait(FAN_POLL_INTERVAL * MSEC_PER_SEC);
+    }
+    SHASH_FOR_EACH(node, &subsystem_data) {
+        struct locl_subsystem *subsystem = node->data;
+
+        if (subsystem->backend != NULL) {
+            fand_backend_wait(subsystem->backend);
+        }
+    }
+
+    /* the sweep at the end of a virtual clock advance has now run */
+    if (clock_conn != NULL && !fand_clock_stepping()) {
+        char *reply = xasprintf("%lld", fand_clock_msec());
+        unixctl_command_reply(clock_conn, reply);
+        free(reply);
+        clock_conn = NULL;
+    }
+    fand_clock_wait();
 }
 
 static void
@@ -596,7 +873,6 @@ fand_unixctl_dump(struct unixctl_conn *conn, int argc OVS_UNUSED,
     const struct locl_subsystem *subsystem = NULL;
     const struct locl_fan *fan = NULL;
     const struct shash_node *node = NULL;
-    const struct shash_node *fan_node = NULL;
     struct ds ds = DS_EMPTY_INITIALIZER;
 
     SHASH_FOR_EACH(node, &subsystem_data) {
@@ -611,16 +887,19 @@ fand_unixctl_dump(struct unixctl_conn *conn, int argc OVS_UNUSED,
         ds_put_format(&ds, "    Fan speed: %s\n",
                       fan_speed_enum_to_string(subsystem->fan_speed));
 
+        if (subsystem->backend != NULL) {
+            fand_backend_dump(subsystem->backend, &ds);
+        }
+
         ds_put_cstr(&ds, "    Fan details:");
 
-        if (shash_is_empty(&subsystem->subsystem_fans)) {
+        if (subsystem->n_fans == 0) {
             ds_put_cstr(&ds, "No Fans found.\n");
             continue;
         }
         ds_put_cstr(&ds, "\n");
 
-        SHASH_FOR_EACH(fan_node, &subsystem->subsystem_fans) {
-            fan = (struct locl_fan *)fan_node->data;
+        LOCL_FAN_FOR_EACH(fan, subsystem) {
             ds_put_format(&ds, "        Name: %s\n", fan->name);
             ds_put_format(&ds, "            rpm: %d\n", fan->rpm);
             ds_put_format(&ds, "            direction: %s\n",
@@ -630,11 +909,165 @@ fand_unixctl_dump(struct unixctl_conn *conn, int argc OVS_UNUSED,
         }
     }
 
+    if (fand_stats.ready_usec != 0) {
+        ds_put_format(&ds, "Ready: %lld us after start\n",
+                      fand_stats.ready_usec);
+    }
+    if (hot_standby) {
+        if (fand_subsystems_standby()) {
+            ds_put_cstr(&ds, "Hot standby: standing by\n");
+        } else {
+            ds_put_format(&ds, "Hot standby: active, took over in %lld us\n",
+                          fand_stats.takeover_usec);
+        }
+    }
+    if (fand_shard_enabled()) {
+        ds_put_format(&ds, "Shard: %s (lock %s)%s\n", fand_shard_spec(),
+                      fand_shard_lock_name(),
+                      shard_blocked ? ", not running: waiting for lock "
+                                      "ops_fand" : "");
+    }
+    if (sweep_budget > 0) {
+        ds_put_format(&ds, "Sweep budget: %d ms\n", sweep_budget);
+        ds_put_format(&ds, "    Last sweep: %u slices, %lld us\n",
+                      fand_stats.last_sweep_slices,
+                      fand_stats.last_sweep_usec);
+        ds_put_format(&ds, "    Yields: %"PRIu64", overruns: %"PRIu64"\n",
+                      fand_stats.n_sweep_yields, fand_stats.n_sweep_overruns);
+    }
+
+    fand_topo_dump(&ds);
+    fand_ckpt_dump(&ds);
+    fand_sim_dump(&ds);
+    fand_trace_dump(&ds);
+
     unixctl_command_reply(conn, ds_cstr(&ds));
 
     ds_destroy(&ds);
 }
 
+/* change the simulated hardware (e.g. inject a fault) at runtime */
+static void
+fand_unixctl_hw_sim(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                    const char *argv[], void *aux OVS_UNUSED)
+{
+    char *error = fand_sim_configure(argv[1]);
+
+    if (error) {
+        unixctl_command_reply_error(conn, error);
+        free(error);
+        return;
+    }
+
+    unixctl_command_reply(conn, NULL);
+}
+
+/* run the daemon through the next "msec" of virtual time, replying with the
+   new virtual time once the last poll interval has been run */
+static void
+fand_unixctl_clock_advance(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                           const char *argv[], void *aux OVS_UNUSED)
+{
+    long long int msec;
+    char *end;
+
+    errno = 0;
+    msec = strtoll(argv[1], &end, 10);
+    if (errno || *argv[1] == '\0' || *end != '\0' || msec < 0) {
+        unixctl_command_reply_error(conn, "invalid number of milliseconds");
+        return;
+    }
+
+    if (clock_conn != NULL) {
+        unixctl_command_reply_error(conn, "clock is already being advanced");
+        return;
+    }
+
+    clock_conn = conn;
+    fand_clock_run_until(msec);
+}
+
+/* append the current value of every attribute, for a full resync */
+static void
+fand_changes_full_state(struct ds *ds)
+{
+    const struct shash_node *node;
+    const struct locl_fan *fan;
+
+    SHASH_FOR_EACH(node, &subsystem_data) {
+        const struct locl_subsystem *subsystem = node->data;
+
+        if (!subsystem->valid) {
+            continue;
+        }
+
+        fand_changes_format_state(ds, FAND_CHANGE_SUBSYSTEM, subsystem->name,
+                "speed", fan_speed_enum_to_string(subsystem->speed));
+        fand_changes_format_state(ds, FAND_CHANGE_SUBSYSTEM, subsystem->name,
+                "sensor_speed", fan_speed_enum_to_string(subsystem->fan_speed));
+        fand_changes_format_state(ds, FAND_CHANGE_SUBSYSTEM, subsystem->name,
+                "override",
+                subsystem->fan_speed_override == FAND_SPEED_NONE ? NULL :
+                fan_speed_enum_to_string(subsystem->fan_speed_override));
+
+        LOCL_FAN_FOR_EACH(fan, subsystem) {
+            char rpm[16];
+
+            snprintf(rpm, sizeof(rpm), "%d", fan->rpm);
+            fand_changes_format_state(ds, FAND_CHANGE_FAN, fan->name,
+                    "status", fan_status_enum_to_string(fan->status));
+            fand_changes_format_state(ds, FAND_CHANGE_FAN, fan->name,
+                    "rpm", rpm);
+            fand_changes_format_state(ds, FAND_CHANGE_FAN, fan->name,
+                    "direction", fan->direction);
+            fand_changes_format_state(ds, FAND_CHANGE_FAN, fan->name,
+                    "speed", fan_speed_enum_to_string(fan->speed));
+        }
+    }
+}
+
+/* reply with the changes since "EPOCH:SEQ", as given in the first line of
+   an earlier reply. the first line is the new high-water mark ("seq
+   EPOCH:N"). if the epoch is another instance's (or missing, as in a
+   first query) or the requested changes are no longer in the log, a
+   "resync" line follows and then the full state. */
+static void
+fand_unixctl_changes(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                     const char *argv[], void *aux OVS_UNUSED)
+{
+    struct ds ds = DS_EMPTY_INITIALIZER;
+    unsigned long long epoch = 0;
+    unsigned long long since;
+    const char *arg = argv[1];
+    char *end;
+
+    errno = 0;
+    if (strchr(arg, ':') != NULL) {
+        epoch = strtoull(arg, &end, 16);
+        if (errno || end == arg || *end != ':') {
+            unixctl_command_reply_error(conn, "invalid epoch");
+            return;
+        }
+        arg = end + 1;
+    }
+    since = strtoull(arg, &end, 10);
+    if (errno || *arg == '\0' || *end != '\0') {
+        unixctl_command_reply_error(conn, "invalid sequence number");
+        return;
+    }
+
+    ds_put_format(&ds, "seq %016llx:%llu\n",
+                  (unsigned long long)fand_changes_epoch(),
+                  (unsigned long long)fand_changes_seq());
+    if (!fand_changes_format(&ds, epoch, since)) {
+        ds_put_cstr(&ds, "resync\n");
+        fand_changes_full_state(&ds);
+    }
+
+    unixctl_command_reply(conn, ds_cstr(&ds));
+
+    ds_destroy(&ds);
+}
 
 static unixctl_cb_func ops_fand_exit;
 
@@ -650,6 +1083,7 @@ main(int argc, char *argv[])
     bool exiting;
     int retval;
 
+    start_usec = time_usec();
     set_program_name(argv[0]);
 
     proctitle_init(argc, argv);
@@ -699,6 +1133,19 @@ parse_options(int argc, char *argv[], char **unixctl_pathp)
         OPT_DISABLE_SYSTEM,
         DAEMON_OPTION_ENUMS,
         OPT_DPDK,
+        OPT_METRICS_FILE,
+        OPT_METRICS_INTERVAL,
+        OPT_SWEEP_BUDGET,
+        OPT_HOT_STANDBY,
+        OPT_SHARD,
+        OPT_HW_CACHE,
+        OPT_CHECKPOINT,
+        OPT_SHM,
+        OPT_HW_SIM,
+        OPT_HW_CAPTURE,
+        OPT_HW_REPLAY,
+        OPT_HW_REPLAY_SPEED,
+        OPT_VIRTUAL_CLOCK,
     };
     static const struct option long_options[] = {
         {"help",        no_argument, NULL, 'h'},
@@ -709,6 +1156,19 @@ parse_options(int argc, char *argv[], char **unixctl_pathp)
         STREAM_SSL_LONG_OPTIONS,
         {"peer-ca-cert", required_argument, NULL, OPT_PEER_CA_CERT},
         {"bootstrap-ca-cert", required_argument, NULL, OPT_BOOTSTRAP_CA_CERT},
+        {"metrics-file", required_argument, NULL, OPT_METRICS_FILE},
+        {"metrics-interval", required_argument, NULL, OPT_METRICS_INTERVAL},
+        {"sweep-budget", required_argument, NULL, OPT_SWEEP_BUDGET},
+        {"hot-standby", no_argument, NULL, OPT_HOT_STANDBY},
+        {"shard", required_argument, NULL, OPT_SHARD},
+        {"hw-cache", required_argument, NULL, OPT_HW_CACHE},
+        {"checkpoint", optional_argument, NULL, OPT_CHECKPOINT},
+        {"shm", optional_argument, NULL, OPT_SHM},
+        {"hw-sim", optional_argument, NULL, OPT_HW_SIM},
+        {"hw-capture", required_argument, NULL, OPT_HW_CAPTURE},
+        {"hw-replay", required_argument, NULL, OPT_HW_REPLAY},
+        {"hw-replay-speed", required_argument, NULL, OPT_HW_REPLAY_SPEED},
+        {"virtual-clock", optional_argument, NULL, OPT_VIRTUAL_CLOCK},
         {NULL, 0, NULL, 0},
     };
     char *short_options = long_options_to_short_options(long_options);
@@ -745,6 +1205,85 @@ parse_options(int argc, char *argv[], char **unixctl_pathp)
             stream_ssl_set_ca_cert_file(optarg, true);
             break;
 
+        case OPT_METRICS_FILE:
+            metrics_file = optarg;
+            break;
+
+        case OPT_METRICS_INTERVAL:
+            metrics_interval = atoi(optarg);
+            if (metrics_interval <= 0) {
+                VLOG_FATAL("--metrics-interval must be a positive number "
+                           "of seconds");
+            }
+            break;
+
+        case OPT_SWEEP_BUDGET:
+            sweep_budget = atoi(optarg);
+            if (sweep_budget < 0) {
+                VLOG_FATAL("--sweep-budget must be a number of msec, or 0 "
+                           "for no limit");
+            }
+            break;
+
+        case OPT_HOT_STANDBY:
+            hot_standby = true;
+            break;
+
+        case OPT_SHARD: {
+            char *error = fand_shard_set(optarg);
+            if (error) {
+                VLOG_FATAL("--shard: %s", error);
+            }
+            break;
+        }
+
+        case OPT_HW_CACHE:
+            fand_topo_set_cache_dir(optarg);
+            break;
+
+        case OPT_CHECKPOINT:
+            ckpt_enabled = true;
+            ckpt_file = optarg;
+            break;
+
+        case OPT_SHM:
+            shm_enabled = true;
+            shm_name = optarg;
+            break;
+
+        case OPT_HW_SIM: {
+            char *error = fand_sim_enable(optarg);
+            if (error) {
+                VLOG_FATAL("--hw-sim: %s", error);
+            }
+            fand_backend_set_default("sim");
+            break;
+        }
+
+        case OPT_HW_CAPTURE:
+            capture_file = optarg;
+            break;
+
+        case OPT_HW_REPLAY:
+            replay_file = optarg;
+            fand_backend_set_default("replay");
+            break;
+
+        case OPT_HW_REPLAY_SPEED:
+            if (!strcmp(optarg, "max")) {
+                replay_max_speed = true;
+            } else if (!strcmp(optarg, "original")) {
+                replay_max_speed = false;
+            } else {
+                VLOG_FATAL("--hw-replay-speed must be \"original\" or "
+                           "\"max\"");
+            }
+            break;
+
+        case OPT_VIRTUAL_CLOCK:
+            fand_clock_enable_virtual(optarg ? atoll(optarg) : -1);
+            break;
+
         case '?':
             exit(EXIT_FAILURE);
 
@@ -754,6 +1293,10 @@ parse_options(int argc, char *argv[], char **unixctl_pathp)
     }
     free(short_options);
 
+    if (replay_file != NULL && fand_sim_enabled()) {
+        VLOG_FATAL("--hw-replay and --hw-sim are mutually exclusive");
+    }
+
     argc -= optind;
     argv += optind;
 
@@ -781,6 +1324,64 @@ usage(void)
     stream_usage("DATABASE", true, false, true);
     daemon_usage();
     vlog_usage();
+    printf("\nShared memory options:\n"
+           "  --shm[=NAME]            publish live fan state in shared "
+           "memory segment NAME\n"
+           "                          (default: %s, or /LOCK with "
+           "--shard)\n", FAND_SHM_DEFAULT_NAME);
+    printf("\nMetrics options:\n"
+           "  --metrics-file=FILE     write Prometheus text format metrics "
+           "to FILE\n"
+           "  --metrics-interval=SECS rewrite the metrics file every SECS "
+           "seconds\n"
+           "                          (default: %d)\n", FAN_POLL_INTERVAL);
+    printf("\nSweep options:\n"
+           "  --sweep-budget=MSEC     sample fans for at most about MSEC per "
+           "poll loop\n"
+           "                          iteration, finishing a sweep over "
+           "several\n"
+           "                          (default: 0, no limit). with "
+           "--virtual-clock,\n"
+           "                          sample at most MSEC subsystems per "
+           "iteration\n");
+    printf("\nStandby options:\n"
+           "  --hot-standby           while another ops-fand holds the lock, "
+           "keep the\n"
+           "                          fans loaded and sampled (read only), "
+           "ready to\n"
+           "                          take over\n"
+           "  --shard=PATTERN|N/M     only handle subsystems whose name "
+           "matches\n"
+           "                          PATTERN, or that hash to slot N of M, "
+           "under a\n"
+           "                          lock of their own\n");
+    printf("\nStartup options:\n"
+           "  --hw-cache=DIR          keep parsed fan hardware descriptions "
+           "in DIR\n"
+           "                          and load them from there while "
+           "unchanged\n"
+           "  --checkpoint[=FILE]     keep the fan state in FILE, and resume "
+           "from it\n"
+           "                          after a restart (default: "
+           "%s/%s,\n"
+           "                          or %s/LOCK.ckpt with --shard)\n",
+           ovs_rundir(), FAND_CKPT_DEFAULT_NAME, ovs_rundir());
+    printf("\nSimulation options:\n"
+           "  --hw-sim[=SETTINGS]     simulate the fan hardware instead of "
+           "using i2c\n"
+           "                          (see fandsim.h for SETTINGS)\n"
+           "  --hw-capture=FILE       record all register traffic to FILE\n"
+           "  --hw-replay=FILE        replay the register traffic recorded in "
+           "FILE\n"
+           "                          instead of using i2c\n"
+           "  --hw-replay-speed=original|max\n"
+           "                          replay with the recorded timing "
+           "(default) or\n"
+           "                          as fast as possible\n"
+           "  --virtual-clock[=SECS]  only advance time with "
+           "ops-fand/clock-advance,\n"
+           "                          starting at wall clock time SECS "
+           "since the epoch\n");
     printf("\nOther options:\n"
            "  --unixctl=SOCKET        override default control socket name\n"
            "  -h, --help              display this help message\n"
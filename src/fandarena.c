@@ -0,0 +1,171 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for subsystem memory arenas.
+ ***************************************************************************/
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+#include "fandarena.h"
+
+/* alignment of every allocation, as malloc()'s */
+#define FAND_ARENA_ALIGN        16
+/* the first chunk is sized for a small subsystem. later ones double, up to
+   FAND_ARENA_MAX_CHUNK, unless an allocation needs more. */
+#define FAND_ARENA_FIRST_CHUNK  2048
+#define FAND_ARENA_MAX_CHUNK    65536
+
+struct fand_arena_chunk {
+    struct fand_arena_chunk *next;
+    size_t size;                /* bytes in data[] */
+    size_t used;
+    /* data[] follows, at FAND_ARENA_CHUNK_HDR */
+};
+
+#define FAND_ARENA_CHUNK_HDR \
+    ROUND_UP(sizeof(struct fand_arena_chunk), FAND_ARENA_ALIGN)
+
+/* lives at the start of its first chunk */
+struct fand_arena {
+    struct fand_arena_chunk *chunks;    /* newest first */
+    size_t used;
+    size_t size;
+};
+
+static uint8_t *
+chunk_data(struct fand_arena_chunk *chunk)
+{
+    return (uint8_t *)chunk + FAND_ARENA_CHUNK_HDR;
+}
+
+static struct fand_arena_chunk *
+chunk_create(size_t size)
+{
+    struct fand_arena_chunk *chunk = xmalloc(FAND_ARENA_CHUNK_HDR + size);
+
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+struct fand_arena *
+fand_arena_create(void)
+{
+    struct fand_arena_chunk *chunk = chunk_create(FAND_ARENA_FIRST_CHUNK);
+    struct fand_arena *arena = (struct fand_arena *)chunk_data(chunk);
+
+    chunk->used = ROUND_UP(sizeof *arena, FAND_ARENA_ALIGN);
+    arena->chunks = chunk;
+    arena->used = 0;
+    arena->size = chunk->size;
+    return arena;
+}
+
+void
+fand_arena_destroy(struct fand_arena *arena)
+{
+    struct fand_arena_chunk *chunk, *next;
+
+    if (arena == NULL) {
+        return;
+    }
+
+    /* the arena itself goes with the last (first created) chunk */
+    for (chunk = arena->chunks; chunk != NULL; chunk = next) {
+        next = chunk->next;
+        free(chunk);
+    }
+}
+
+void *
+fand_arena_alloc(struct fand_arena *arena, size_t size)
+{
+    struct fand_arena_chunk *chunk = arena->chunks;
+    void *p;
+
+    size = ROUND_UP(MAX(size, 1), FAND_ARENA_ALIGN);
+    if (chunk->size - chunk->used < size) {
+        chunk = chunk_create(MAX(size, MIN(chunk->size * 2,
+                                           FAND_ARENA_MAX_CHUNK)));
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+        arena->size += chunk->size;
+    }
+
+    p = chunk_data(chunk) + chunk->used;
+    chunk->used += size;
+    arena->used += size;
+    memset(p, 0, size);
+    return p;
+}
+
+void *
+fand_arena_memdup(struct fand_arena *arena, const void *p, size_t size)
+{
+    void *copy = fand_arena_alloc(arena, size);
+
+    if (size) {
+        memcpy(copy, p, size);
+    }
+    return copy;
+}
+
+char *
+fand_arena_strdup(struct fand_arena *arena, const char *s)
+{
+    return fand_arena_memdup(arena, s, strlen(s) + 1);
+}
+
+char *
+fand_arena_asprintf(struct fand_arena *arena, const char *format, ...)
+{
+    va_list args;
+    char *s;
+    int len;
+
+    va_start(args, format);
+    len = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    ovs_assert(len >= 0);
+
+    s = fand_arena_alloc(arena, len + 1);
+    va_start(args, format);
+    vsnprintf(s, len + 1, format, args);
+    va_end(args);
+    return s;
+}
+
+size_t
+fand_arena_used(const struct fand_arena *arena)
+{
+    return arena->used;
+}
+
+size_t
+fand_arena_size(const struct fand_arena *arena)
+{
+    return arena->size;
+}
@@ -0,0 +1,527 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for the fan hardware backends, and the i2c backend.
+ ***************************************************************************/
+
+#include <errno.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "poll-loop.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "config-yaml.h"
+#include "fand-probes.h"
+#include "fandbackend.h"
+#include "fandtopo.h"
+#include "fandclock.h"
+#include "fandtrace.h"
+
+VLOG_DEFINE_THIS_MODULE(fandbackend);
+
+static const struct fand_backend_class *backend_classes[] = {
+    &fand_i2c_backend_class,
+    &fand_sim_backend_class,
+    &fand_replay_backend_class,
+    &fand_hwmon_backend_class,
+};
+
+static const char *default_type = "i2c";
+
+void
+fand_backend_set_default(const char *type)
+{
+    default_type = type;
+}
+
+const char *
+fand_backend_get_default(void)
+{
+    return default_type;
+}
+
+int
+fand_backend_open(const char *type, const char *subsystem_name,
+                  struct fand_backend **backendp)
+{
+    const char *arg;
+    size_t type_len;
+    size_t idx;
+
+    if (type == NULL) {
+        type = default_type;
+    }
+
+    type_len = strcspn(type, ":");
+    arg = type[type_len] == ':' ? &type[type_len + 1] : NULL;
+
+    for (idx = 0; idx < ARRAY_SIZE(backend_classes); idx++) {
+        const char *class_type = backend_classes[idx]->type;
+
+        if (strlen(class_type) == type_len
+                && !strncmp(class_type, type, type_len)) {
+            return backend_classes[idx]->open(subsystem_name, arg, backendp);
+        }
+    }
+
+    VLOG_ERR("subsystem %s: unknown fan backend %s", subsystem_name, type);
+    return EINVAL;
+}
+
+void
+fand_backend_close(struct fand_backend *backend)
+{
+    if (backend != NULL) {
+        backend->class->close(backend);
+    }
+}
+
+void
+fand_backend_init(struct fand_backend *backend,
+                  const struct fand_backend_class *class,
+                  const char *subsystem_name)
+{
+    backend->class = class;
+    backend->subsystem_name = xstrdup(subsystem_name);
+    backend->watches = NULL;
+    backend->pollfds = NULL;
+    backend->n_watches = 0;
+    shash_init(&backend->breakers);
+    backend->n_batches = 0;
+    backend->n_recoveries = 0;
+    backend->scratch = NULL;
+    backend->n_scratch = 0;
+}
+
+void
+fand_backend_uninit(struct fand_backend *backend)
+{
+    struct shash_node *node, *next;
+
+    free(backend->subsystem_name);
+    free(backend->watches);
+    free(backend->pollfds);
+    SHASH_FOR_EACH_SAFE (node, next, &backend->breakers) {
+        struct fand_breaker *breaker = node->data;
+
+        shash_delete(&backend->breakers, node);
+        free(breaker->device);
+        free(breaker);
+    }
+    shash_destroy(&backend->breakers);
+    free(backend->scratch);
+}
+
+static struct fand_breaker *
+fand_breaker_get(struct fand_backend *backend, const i2c_bit_op *op)
+{
+    const char *device = op->device ? op->device : "";
+    struct fand_breaker *breaker = shash_find_data(&backend->breakers, device);
+
+    if (breaker == NULL) {
+        breaker = xzalloc(sizeof *breaker);
+        breaker->device = xstrdup(device);
+        breaker->state = FAND_BREAKER_CLOSED;
+        shash_add(&backend->breakers, device, breaker);
+    }
+    return breaker;
+}
+
+/* true if an access to "breaker"'s device may go ahead at "now" */
+static bool
+fand_breaker_allow(struct fand_breaker *breaker, long long int now)
+{
+    if (breaker->state != FAND_BREAKER_OPEN) {
+        return true;
+    } else if (now >= breaker->retry_msec) {
+        breaker->state = FAND_BREAKER_HALF_OPEN;
+        return true;
+    }
+    breaker->n_skipped++;
+    return false;
+}
+
+/* record whether "breaker"'s device answered any access in a batch */
+static void
+fand_breaker_update(struct fand_backend *backend,
+                    struct fand_breaker *breaker, bool ok, long long int now)
+{
+    if (ok) {
+        if (breaker->state != FAND_BREAKER_CLOSED) {
+            VLOG_INFO("subsystem %s: device %s is responding again",
+                      backend->subsystem_name, breaker->device);
+            breaker->state = FAND_BREAKER_CLOSED;
+            backend->n_recoveries++;
+        }
+        breaker->n_failures = 0;
+        return;
+    }
+
+    breaker->n_failures++;
+
+    if (breaker->state == FAND_BREAKER_HALF_OPEN) {
+        breaker->backoff_msec = MIN(breaker->backoff_msec * 2,
+                                    FAND_BREAKER_MAX_BACKOFF_MSEC);
+    } else if (breaker->state == FAND_BREAKER_CLOSED
+               && breaker->n_failures >= FAND_BREAKER_THRESHOLD) {
+        breaker->backoff_msec = FAND_BREAKER_BACKOFF_MSEC;
+        breaker->n_opens++;
+        VLOG_WARN("subsystem %s: device %s failed %d batches in a row, "
+                  "not accessing it for %lld ms", backend->subsystem_name,
+                  breaker->device, breaker->n_failures,
+                  breaker->backoff_msec);
+    } else {
+        return;
+    }
+    breaker->state = FAND_BREAKER_OPEN;
+    breaker->retry_msec = now + breaker->backoff_msec;
+}
+
+/* every batch from ops-fand goes through this helper, so that accesses to
+   a failing device can be held back by its breaker, and every access can
+   be traced. "name" in each io identifies the fan, fru or subsystem control
+   that the register belongs to. the latency is only known for the whole
+   batch, so each access is given an equal share of it. */
+static void
+fand_backend_batch(struct fand_backend *backend, enum fand_trace_type type,
+                   struct fand_reg_io ios[], size_t n)
+{
+    long long int now = fand_clock_msec();
+    long long int start_nsec;
+    long long int nsec;
+    struct fand_reg_io *batch = ios;
+    size_t n_batch = 0;
+    size_t idx;
+
+    if (n == 0) {
+        return;
+    }
+
+    /* leave out the accesses to devices whose breaker is open */
+    for (idx = 0; idx < n; idx++) {
+        if (ios[idx].breaker == NULL) {
+            ios[idx].breaker = fand_breaker_get(backend, ios[idx].op);
+        }
+        if (fand_breaker_allow(ios[idx].breaker, now)) {
+            n_batch++;
+        }
+    }
+    if (n_batch < n) {
+        if (n_batch > backend->n_scratch) {
+            backend->scratch = xrealloc(backend->scratch,
+                                        n_batch * sizeof *backend->scratch);
+            backend->n_scratch = n_batch;
+        }
+        batch = backend->scratch;
+        n_batch = 0;
+        for (idx = 0; idx < n; idx++) {
+            if (ios[idx].breaker->state != FAND_BREAKER_OPEN) {
+                ios[idx].rc = 0;
+                batch[n_batch++] = ios[idx];
+            } else {
+                ios[idx].value = 0;
+                ios[idx].rc = FAND_IO_SKIPPED;
+            }
+        }
+    }
+
+    start_nsec = fand_trace_nsec();
+    if (n_batch > 0) {
+        if (type == FAND_TRACE_READ) {
+            backend->class->read(backend, batch, n_batch);
+        } else {
+            backend->class->write(backend, batch, n_batch);
+        }
+    }
+    nsec = (fand_trace_nsec() - start_nsec) / MAX(n_batch, 1);
+
+    /* a device has failed a batch if none of its accesses worked */
+    backend->n_batches++;
+    for (idx = 0; idx < n_batch; idx++) {
+        struct fand_breaker *breaker = batch[idx].breaker;
+
+        if (breaker->batch != backend->n_batches) {
+            breaker->batch = backend->n_batches;
+            breaker->batch_ok = false;
+        }
+        if (batch[idx].rc == 0) {
+            breaker->batch_ok = true;
+        } else {
+            breaker->failed_nsec += nsec;
+        }
+    }
+
+    for (idx = 0; idx < n_batch; idx++) {
+        struct fand_reg_io *io = &batch[idx];
+
+        if (io->breaker->batch == backend->n_batches) {
+            fand_breaker_update(backend, io->breaker, io->breaker->batch_ok,
+                                now);
+            io->breaker->batch = 0;
+        }
+        if (fand_trace_capturing()) {
+            fand_trace_capture(type, backend->subsystem_name, io->op,
+                               io->value, io->rc, start_nsec, n_batch);
+        }
+        if (type == FAND_TRACE_READ) {
+            FAND_PROBE5(reg__read, backend->subsystem_name, io->name,
+                        io->op->register_address, io->value, io->rc);
+        } else {
+            FAND_PROBE5(reg__write, backend->subsystem_name, io->name,
+                        io->op->register_address, io->value, io->rc);
+        }
+    }
+
+    if (batch != ios) {
+        size_t i = 0;
+
+        for (idx = 0; idx < n; idx++) {
+            if (ios[idx].rc != FAND_IO_SKIPPED) {
+                ios[idx] = batch[i++];
+            }
+        }
+    }
+}
+
+void
+fand_backend_read(struct fand_backend *backend, struct fand_reg_io ios[],
+                  size_t n)
+{
+    fand_backend_batch(backend, FAND_TRACE_READ, ios, n);
+}
+
+void
+fand_backend_write(struct fand_backend *backend, struct fand_reg_io ios[],
+                   size_t n)
+{
+    fand_backend_batch(backend, FAND_TRACE_WRITE, ios, n);
+}
+
+void
+fand_backend_watch(struct fand_backend *backend, int fd,
+                   const YamlFanFru *fru)
+{
+    struct fand_watch *watch;
+    struct pollfd *pfd;
+    struct stat st;
+
+    backend->watches = xrealloc(backend->watches, (backend->n_watches + 1)
+                                                  * sizeof *backend->watches);
+    backend->pollfds = xrealloc(backend->pollfds, (backend->n_watches + 1)
+                                                  * sizeof *backend->pollfds);
+    watch = &backend->watches[backend->n_watches];
+    pfd = &backend->pollfds[backend->n_watches];
+    backend->n_watches++;
+
+    watch->fd = fd;
+    watch->is_attr = !fstat(fd, &st) && S_ISREG(st.st_mode);
+    watch->fru = fru;
+    pfd->fd = fd;
+    pfd->events = watch->is_attr ? POLLPRI : POLLIN;
+    pfd->revents = 0;
+}
+
+void
+fand_backend_wait(const struct fand_backend *backend)
+{
+    size_t idx;
+
+    for (idx = 0; idx < backend->n_watches; idx++) {
+        poll_fd_wait(backend->pollfds[idx].fd, backend->pollfds[idx].events);
+    }
+}
+
+/* consume the event on "watch", so that it doesn't fire again until the
+   next change */
+static void
+fand_watch_rearm(const struct fand_watch *watch)
+{
+    char buf[64];
+
+    if (watch->is_attr) {
+        ignore(pread(watch->fd, buf, sizeof buf, 0) >= 0);
+    } else {
+        ignore(read(watch->fd, buf, sizeof buf) >= 0);
+    }
+}
+
+size_t
+fand_backend_poll_events(struct fand_backend *backend,
+                         const YamlFanFru *frus[], size_t max)
+{
+    size_t n = 0;
+    size_t idx;
+
+    if (backend->n_watches == 0
+            || poll(backend->pollfds, backend->n_watches, 0) <= 0) {
+        return 0;
+    }
+
+    for (idx = 0; idx < backend->n_watches && n < max; idx++) {
+        const struct fand_watch *watch = &backend->watches[idx];
+        size_t i;
+
+        if (!(backend->pollfds[idx].revents
+              & (backend->pollfds[idx].events | POLLERR | POLLHUP))) {
+            continue;
+        }
+
+        fand_watch_rearm(watch);
+        FAND_PROBE2(fru__event, backend->subsystem_name, watch->fru->number);
+
+        for (i = 0; i < n && frus[i] != watch->fru; i++) {
+            continue;
+        }
+        if (i == n) {
+            frus[n++] = watch->fru;
+        }
+    }
+
+    return n;
+}
+
+static const char *
+fand_breaker_state_to_string(enum fand_breaker_state state)
+{
+    switch (state) {
+    case FAND_BREAKER_CLOSED:
+        return "ok";
+    case FAND_BREAKER_OPEN:
+        return "open";
+    case FAND_BREAKER_HALF_OPEN:
+        return "half-open";
+    }
+    return "unknown";
+}
+
+void
+fand_backend_dump(const struct fand_backend *backend, struct ds *ds)
+{
+    const struct shash_node *node;
+
+    ds_put_format(ds, "    Backend: %s\n", backend->class->type);
+    if (backend->class->dump) {
+        backend->class->dump(backend, ds);
+    }
+
+    /* devices that have had trouble */
+    SHASH_FOR_EACH (node, &backend->breakers) {
+        const struct fand_breaker *breaker = node->data;
+
+        if (breaker->state == FAND_BREAKER_CLOSED && !breaker->n_failures
+                && !breaker->n_opens) {
+            continue;
+        }
+        ds_put_format(ds, "        Device %s: %s, %d failed batches in a row, "
+                      "opened %"PRIu64" times, %"PRIu64" accesses skipped, "
+                      "%lld ms in failed accesses",
+                      breaker->device,
+                      fand_breaker_state_to_string(breaker->state),
+                      breaker->n_failures, breaker->n_opens,
+                      breaker->n_skipped, breaker->failed_nsec / 1000000);
+        if (breaker->state == FAND_BREAKER_OPEN) {
+            ds_put_format(ds, ", retry in %lld ms",
+                          MAX(breaker->retry_msec - fand_clock_msec(), 0));
+        }
+        ds_put_cstr(ds, "\n");
+    }
+}
+
+/* i2c backend: the config-yaml i2c register access, one access at a time */
+
+struct i2c_backend {
+    struct fand_backend up;
+    YamlConfigHandle yaml;      /* the subsystem's, from its topology */
+};
+
+static struct i2c_backend *
+i2c_backend_cast(const struct fand_backend *backend)
+{
+    return CONTAINER_OF(backend, struct i2c_backend, up);
+}
+
+static int
+i2c_backend_open(const char *subsystem_name, const char *arg OVS_UNUSED,
+                 struct fand_backend **backendp)
+{
+    const struct fand_topo *topo = fand_topo_find(subsystem_name);
+    struct i2c_backend *backend;
+
+    /* config-yaml resolves the devices of the bit ops */
+    if (topo == NULL || fand_topo_need_devices(subsystem_name) != 0) {
+        return EINVAL;
+    }
+
+    backend = xmalloc(sizeof *backend);
+    fand_backend_init(&backend->up, &fand_i2c_backend_class, subsystem_name);
+    backend->yaml = topo->yaml;
+    *backendp = &backend->up;
+    return 0;
+}
+
+static void
+i2c_backend_close(struct fand_backend *backend_)
+{
+    struct i2c_backend *backend = i2c_backend_cast(backend_);
+
+    fand_backend_uninit(&backend->up);
+    free(backend);
+}
+
+static void
+i2c_backend_read(struct fand_backend *backend_, struct fand_reg_io ios[],
+                 size_t n)
+{
+    struct i2c_backend *backend = i2c_backend_cast(backend_);
+    size_t idx;
+
+    for (idx = 0; idx < n; idx++) {
+        ios[idx].value = 0;
+        ios[idx].rc = i2c_reg_read(backend->yaml, backend->up.subsystem_name,
+                                   ios[idx].op, &ios[idx].value);
+    }
+}
+
+static void
+i2c_backend_write(struct fand_backend *backend_, struct fand_reg_io ios[],
+                  size_t n)
+{
+    struct i2c_backend *backend = i2c_backend_cast(backend_);
+    size_t idx;
+
+    for (idx = 0; idx < n; idx++) {
+        ios[idx].rc = i2c_reg_write(backend->yaml, backend->up.subsystem_name,
+                                    ios[idx].op, ios[idx].value);
+    }
+}
+
+const struct fand_backend_class fand_i2c_backend_class = {
+    "i2c",
+    i2c_backend_open,
+    i2c_backend_close,
+    i2c_backend_read,
+    i2c_backend_write,
+    NULL,                       /* dump */
+};
@@ -0,0 +1,147 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for the fan state change log.
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "fandchanges.h"
+
+/* the log is a fixed ring of entries, so recording a change never allocates.
+   the oldest entries are overwritten once it is full. */
+#define CHANGE_LOG_SIZE     4096
+#define CHANGE_NAME_LEN     64
+#define CHANGE_ATTR_LEN     16
+#define CHANGE_VALUE_LEN    16
+
+struct change_entry {
+    uint64_t seq;
+    enum fand_change_object object;
+    char name[CHANGE_NAME_LEN];
+    char attr[CHANGE_ATTR_LEN];
+    char value[CHANGE_VALUE_LEN];
+};
+
+static struct change_entry change_log[CHANGE_LOG_SIZE];
+
+/* sequence number of the latest change (0 if nothing changed yet) */
+static uint64_t change_seq = 0;
+
+/* identifies this instance's sequence, which starts again at 0 after a
+   restart (0 until first needed) */
+static uint64_t change_epoch = 0;
+
+static const char *
+object_to_string(enum fand_change_object object)
+{
+    return object == FAND_CHANGE_FAN ? "fan" : "subsystem";
+}
+
+void
+fand_changes_record(enum fand_change_object object, const char *name,
+                    const char *attr, const char *value)
+{
+    struct change_entry *entry;
+
+    change_seq++;
+    entry = &change_log[change_seq % CHANGE_LOG_SIZE];
+    entry->seq = change_seq;
+    entry->object = object;
+    snprintf(entry->name, sizeof(entry->name), "%s", name);
+    snprintf(entry->attr, sizeof(entry->attr), "%s", attr);
+    snprintf(entry->value, sizeof(entry->value), "%s", value ? value : "-");
+}
+
+void
+fand_changes_record_int(enum fand_change_object object, const char *name,
+                        const char *attr, int value)
+{
+    char buf[CHANGE_VALUE_LEN];
+
+    snprintf(buf, sizeof(buf), "%d", value);
+    fand_changes_record(object, name, attr, buf);
+}
+
+uint64_t
+fand_changes_seq(void)
+{
+    return change_seq;
+}
+
+uint64_t
+fand_changes_epoch(void)
+{
+    struct timespec ts;
+
+    /* real time even under the virtual clock, which starts at the same
+       time on every run */
+    while (change_epoch == 0) {
+        clock_gettime(CLOCK_REALTIME, &ts);
+        change_epoch = ((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000)
+                       ^ ((uint64_t)getpid() << 48);
+    }
+    return change_epoch;
+}
+
+bool
+fand_changes_format(struct ds *ds, uint64_t epoch, uint64_t since)
+{
+    uint64_t oldest;
+    uint64_t seq;
+
+    /* a sequence number from another instance means nothing here */
+    if (epoch != fand_changes_epoch()) {
+        return false;
+    }
+
+    /* the log holds the last CHANGE_LOG_SIZE changes. if anything after
+       "since" is older than that, it's gone. */
+    oldest = change_seq > CHANGE_LOG_SIZE ? change_seq - CHANGE_LOG_SIZE + 1
+                                          : 1;
+    if (since + 1 < oldest || since > change_seq) {
+        return false;
+    }
+
+    for (seq = since + 1; seq <= change_seq; seq++) {
+        const struct change_entry *entry;
+
+        entry = &change_log[seq % CHANGE_LOG_SIZE];
+        ds_put_format(ds, "%llu %s %s %s %s\n",
+                      (unsigned long long)entry->seq,
+                      object_to_string(entry->object),
+                      entry->name, entry->attr, entry->value);
+    }
+
+    return true;
+}
+
+void
+fand_changes_format_state(struct ds *ds, enum fand_change_object object,
+                          const char *name, const char *attr,
+                          const char *value)
+{
+    ds_put_format(ds, "%llu %s %s %s %s\n",
+                  (unsigned long long)change_seq, object_to_string(object),
+                  name, attr, value ? value : "-");
+}
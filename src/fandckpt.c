@@ -0,0 +1,393 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for the warm restart checkpoint.
+ ***************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "openvswitch/vlog.h"
+#include "util.h"
+#include "fandckpt.h"
+#include "fandarena.h"
+#include "fandbackend.h"
+#include "fandclock.h"
+#include "fandirection.h"
+#include "fandsubsys.h"
+
+VLOG_DEFINE_THIS_MODULE(fandckpt);
+
+static struct fand_ckpt *ckpt = NULL;
+static char *ckpt_path = NULL;
+
+/* the state the previous instance saved, while there are subsystems left
+   to restore from it */
+static struct fand_ckpt *prev = NULL;
+
+static char boot_id[FAND_CKPT_BOOT_ID_LEN];
+
+static uint64_t n_restored;         /* subsystems */
+static uint64_t n_fans_restored;
+static uint64_t n_speed_kept;       /* subsystems whose registers held */
+static uint64_t n_leds_kept;        /* ...the checkpointed values */
+static uint64_t n_mismatched;       /* subsystems whose fans differ */
+
+static void
+read_boot_id(char id[FAND_CKPT_BOOT_ID_LEN])
+{
+    FILE *f = fopen("/proc/sys/kernel/random/boot_id", "r");
+
+    memset(id, 0, FAND_CKPT_BOOT_ID_LEN);
+    if (f != NULL) {
+        if (fgets(id, FAND_CKPT_BOOT_ID_LEN, f) != NULL) {
+            id[strcspn(id, "\n")] = '\0';
+        }
+        fclose(f);
+    }
+}
+
+/* whether "c" is a complete checkpoint saved since the last boot */
+static bool
+ckpt_valid(const struct fand_ckpt *c)
+{
+    return !memcmp(c->hdr.magic, FAND_CKPT_MAGIC, sizeof c->hdr.magic)
+           && c->hdr.version == FAND_CKPT_VERSION
+           && c->hdr.byte_order == FAND_CKPT_BYTE_ORDER
+           && c->hdr.size == sizeof *c
+           && !(c->hdr.seq & 1)
+           && c->hdr.n_subsystems <= FAND_CKPT_MAX_SUBSYSTEMS
+           && c->hdr.n_fans <= FAND_CKPT_MAX_FANS
+           && !strncmp(c->hdr.boot_id, boot_id, sizeof c->hdr.boot_id);
+}
+
+int
+fand_ckpt_open(const char *path)
+{
+    struct stat st;
+    void *addr;
+    int error;
+    int fd;
+
+    read_boot_id(boot_id);
+
+    fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        error = errno;
+        VLOG_ERR("unable to open checkpoint %s (%s)", path, strerror(error));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return error;
+    }
+
+    if (ftruncate(fd, sizeof(struct fand_ckpt)) < 0) {
+        error = errno;
+        VLOG_ERR("unable to size checkpoint %s (%s)", path, strerror(error));
+        close(fd);
+        return error;
+    }
+
+    addr = mmap(NULL, sizeof(struct fand_ckpt), PROT_READ | PROT_WRITE,
+                MAP_SHARED, fd, 0);
+    error = errno;
+    close(fd);
+
+    if (addr == MAP_FAILED) {
+        VLOG_ERR("unable to map checkpoint %s (%s)", path, strerror(error));
+        return error;
+    }
+
+    ckpt = addr;
+    ckpt_path = xstrdup(path);
+
+    /* the mapping is rewritten from the first save on, so restore from a
+       copy */
+    if (st.st_size == sizeof(struct fand_ckpt) && ckpt_valid(ckpt)) {
+        prev = xmemdup(ckpt, sizeof *ckpt);
+        VLOG_INFO("warm restart: checkpoint %s has %"PRIu32" subsystems "
+                  "from pid %"PRId32, path, prev->hdr.n_subsystems,
+                  prev->hdr.pid);
+    } else if (st.st_size != 0) {
+        VLOG_INFO("ignoring checkpoint %s (incomplete, or from another "
+                  "boot or version)", path);
+    }
+
+    return 0;
+}
+
+/* the subsystem named "name" in the previous checkpoint, if it hasn't been
+   restored yet */
+static struct fand_ckpt_subsystem *
+ckpt_find_prev(const char *name)
+{
+    uint32_t idx;
+
+    for (idx = 0; idx < prev->hdr.n_subsystems; idx++) {
+        struct fand_ckpt_subsystem *subsys = &prev->subsystems[idx];
+
+        if (!strncmp(subsys->name, name, sizeof subsys->name)) {
+            return subsys;
+        }
+    }
+    return NULL;
+}
+
+/* whether the "n" registers in "ios", read back, hold "values" (or "value"
+   if "values" is NULL) */
+static bool
+ckpt_registers_hold(const struct fand_reg_io ios[], size_t n,
+                    const uint32_t values[], uint32_t value)
+{
+    size_t idx;
+
+    for (idx = 0; idx < n; idx++) {
+        if (ios[idx].rc != 0
+                || ios[idx].value != (values ? values[idx] : value)) {
+            return false;
+        }
+    }
+    return n > 0;
+}
+
+void
+fand_ckpt_restore(struct locl_subsystem *subsystem)
+{
+    struct fand_ckpt_subsystem *subsys;
+    struct fand_reg_io *ios;
+    size_t n_ios;
+    bool speed_kept;
+    bool leds_kept;
+    uint32_t idx;
+
+    if (prev == NULL || subsystem->backend == NULL
+            || fand_subsystems_standby()) {
+        return;
+    }
+
+    subsys = ckpt_find_prev(subsystem->name);
+    if (subsys == NULL) {
+        return;
+    }
+    /* each checkpointed subsystem is restored once */
+    subsys->name[0] = '\0';
+
+    /* the hardware description must not have changed */
+    if (subsys->n_fans != subsystem->n_fans
+            || subsys->first_fan + subsys->n_fans > prev->hdr.n_fans) {
+        goto mismatch;
+    }
+    for (idx = 0; idx < subsys->n_fans; idx++) {
+        const struct fand_ckpt_fan *cfan = &prev->fans[subsys->first_fan + idx];
+
+        if (!fand_subsystem_find_fan(subsystem, cfan->name)) {
+            goto mismatch;
+        }
+    }
+
+    /* read back what the previous instance wrote. the new instance only
+       trusts registers that still hold it. */
+    n_ios = subsystem->n_speed_ios + subsystem->n_led_ios;
+    ios = xmalloc(MAX(n_ios, 1) * sizeof *ios);
+    memcpy(ios, subsystem->speed_ios,
+           subsystem->n_speed_ios * sizeof *ios);
+    memcpy(ios + subsystem->n_speed_ios, subsystem->led_ios,
+           subsystem->n_led_ios * sizeof *ios);
+    fand_backend_read(subsystem->backend, ios, n_ios);
+
+    speed_kept = (subsys->n_speed_ios == subsystem->n_speed_ios
+                  && ckpt_registers_hold(ios, subsystem->n_speed_ios, NULL,
+                                         subsys->speed_value));
+    leds_kept = (subsys->n_led_ios == subsystem->n_led_ios
+                 && ckpt_registers_hold(ios + subsystem->n_speed_ios,
+                                        subsystem->n_led_ios,
+                                        subsys->led_values, 0));
+    free(ios);
+
+    for (idx = 0; idx < subsys->n_fans; idx++) {
+        const struct fand_ckpt_fan *cfan = &prev->fans[subsys->first_fan + idx];
+        struct locl_fan *fan = fand_subsystem_find_fan(subsystem,
+                                                       cfan->name);
+
+        if (cfan->sample_usec == 0) {
+            continue;
+        }
+        fan->rpm = cfan->rpm;
+        fan->status = cfan->status;
+        fan->direction = fan_direction_enum_to_string(cfan->direction);
+        fan->speed = cfan->speed;
+        fan->sample_usec = cfan->sample_usec;
+        n_fans_restored++;
+    }
+    subsystem->fan_speed = subsys->fan_speed;
+    subsystem->speed = subsys->speed;
+
+    if (speed_kept) {
+        subsystem->warm_speed = true;
+        subsystem->warm_speed_value = subsys->speed_value;
+        n_speed_kept++;
+    }
+    if (leds_kept) {
+        subsystem->warm_led_values =
+            fand_arena_memdup(subsystem->arena, subsys->led_values,
+                              subsystem->n_led_ios
+                              * sizeof *subsys->led_values);
+        n_leds_kept++;
+    }
+    n_restored++;
+
+    VLOG_INFO("subsystem %s: restored from checkpoint (speed registers %s, "
+              "led registers %s)", subsystem->name,
+              speed_kept ? "kept" : "rewritten",
+              leds_kept ? "kept" : "rewritten");
+    return;
+
+mismatch:
+    n_mismatched++;
+    VLOG_INFO("subsystem %s: fans differ from checkpoint, starting cold",
+              subsystem->name);
+}
+
+static void
+copy_name(char *dst, const char *src)
+{
+    strncpy(dst, src, FAND_CKPT_NAME_LEN - 1);
+    dst[FAND_CKPT_NAME_LEN - 1] = '\0';
+}
+
+void
+fand_ckpt_save(const struct shash *subsystems)
+{
+    const struct shash_node *node;
+    const struct locl_fan *fan;
+    uint32_t n_subsystems = 0;
+    uint32_t n_fans = 0;
+    uint64_t seq;
+
+    if (ckpt == NULL) {
+        return;
+    }
+
+    /* odd while rewriting, so that a crash midway leaves it invalid */
+    seq = ckpt->hdr.seq | 1;
+    __atomic_store_n(&ckpt->hdr.seq, seq, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    SHASH_FOR_EACH(node, subsystems) {
+        const struct locl_subsystem *subsystem = node->data;
+        struct fand_ckpt_subsystem *subsys;
+        size_t idx;
+
+        if (!subsystem->valid) {
+            continue;
+        }
+        if (n_subsystems == FAND_CKPT_MAX_SUBSYSTEMS
+                || n_fans + subsystem->n_fans
+                   > FAND_CKPT_MAX_FANS) {
+            VLOG_WARN_ONCE("too many subsystems or fans for checkpoint");
+            break;
+        }
+
+        subsys = &ckpt->subsystems[n_subsystems++];
+        copy_name(subsys->name, subsystem->name);
+        subsys->speed = subsystem->speed;
+        subsys->fan_speed = subsystem->fan_speed;
+        subsys->first_fan = n_fans;
+        subsys->n_speed_ios = subsystem->n_speed_ios;
+        subsys->speed_value = (subsystem->n_speed_ios
+                               ? subsystem->speed_ios[0].value : 0);
+        subsys->n_led_ios = 0;
+        if (subsystem->n_led_ios <= FAND_CKPT_MAX_LEDS) {
+            subsys->n_led_ios = subsystem->n_led_ios;
+            for (idx = 0; idx < subsystem->n_led_ios; idx++) {
+                subsys->led_values[idx] = subsystem->led_ios[idx].value;
+            }
+        }
+
+        LOCL_FAN_FOR_EACH(fan, subsystem) {
+            struct fand_ckpt_fan *cfan = &ckpt->fans[n_fans++];
+
+            copy_name(cfan->name, fan->name);
+            cfan->rpm = fan->rpm;
+            cfan->status = fan->status;
+            cfan->direction = (fan->direction
+                               ? fan_direction_string_to_enum(fan->direction)
+                               : FAND_DIRECTION_F2B);
+            cfan->speed = fan->speed;
+            cfan->sample_usec = fan->sample_usec;
+        }
+        subsys->n_fans = n_fans - subsys->first_fan;
+    }
+
+    memcpy(ckpt->hdr.magic, FAND_CKPT_MAGIC, sizeof ckpt->hdr.magic);
+    ckpt->hdr.version = FAND_CKPT_VERSION;
+    ckpt->hdr.byte_order = FAND_CKPT_BYTE_ORDER;
+    ckpt->hdr.size = sizeof *ckpt;
+    ckpt->hdr.pid = getpid();
+    ckpt->hdr.update_usec = fand_clock_wall_usec();
+    memcpy(ckpt->hdr.boot_id, boot_id, sizeof ckpt->hdr.boot_id);
+    ckpt->hdr.n_subsystems = n_subsystems;
+    ckpt->hdr.n_fans = n_fans;
+
+    __atomic_store_n(&ckpt->hdr.seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+void
+fand_ckpt_close(void)
+{
+    if (ckpt != NULL) {
+        munmap(ckpt, sizeof *ckpt);
+        ckpt = NULL;
+    }
+    free(ckpt_path);
+    ckpt_path = NULL;
+    free(prev);
+    prev = NULL;
+}
+
+void
+fand_ckpt_dump(struct ds *ds)
+{
+    const struct shash_node *node;
+    uint64_t n_skips = 0;
+
+    if (ckpt == NULL) {
+        return;
+    }
+
+    SHASH_FOR_EACH(node, &subsystem_data) {
+        const struct locl_subsystem *subsystem = node->data;
+
+        n_skips += subsystem->n_warm_skips;
+    }
+    ds_put_format(ds, "Checkpoint: %s\n", ckpt_path);
+    ds_put_format(ds, "    Restored: %"PRIu64" subsystems (%"PRIu64" fans), "
+                  "%"PRIu64" mismatched\n", n_restored, n_fans_restored,
+                  n_mismatched);
+    ds_put_format(ds, "    Registers kept: speed %"PRIu64", led %"PRIu64
+                  " subsystems, writes skipped: %"PRIu64"\n",
+                  n_speed_kept, n_leds_kept, n_skips);
+}
@@ -0,0 +1,130 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for the ops-fand clock.
+ ***************************************************************************/
+
+#include <limits.h>
+
+#include "poll-loop.h"
+#include "timeval.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "fandclock.h"
+
+VLOG_DEFINE_THIS_MODULE(fandclock);
+
+static bool virtual_clock = false;
+static long long int virtual_msec = 0;
+static long long int virtual_wall_base_usec = 0;
+
+/* earliest timer registered in this poll loop iteration */
+static long long int next_timer = LLONG_MAX;
+
+/* end of the current fand_clock_run_until(), or LLONG_MIN */
+static long long int run_until = LLONG_MIN;
+
+void
+fand_clock_enable_virtual(long long int wall_sec)
+{
+    virtual_clock = true;
+    virtual_msec = 0;
+    virtual_wall_base_usec = wall_sec < 0 ? time_wall_usec()
+                                          : wall_sec * 1000 * 1000;
+    VLOG_INFO("using a virtual clock");
+}
+
+bool
+fand_clock_is_virtual(void)
+{
+    return virtual_clock;
+}
+
+long long int
+fand_clock_msec(void)
+{
+    return virtual_clock ? virtual_msec : time_msec();
+}
+
+long long int
+fand_clock_wall_usec(void)
+{
+    return virtual_clock ? virtual_wall_base_usec + virtual_msec * 1000
+                         : time_wall_usec();
+}
+
+void
+fand_clock_timer_wait(long long int msec)
+{
+    fand_clock_timer_wait_until(fand_clock_msec() + msec);
+}
+
+void
+fand_clock_timer_wait_until(long long int when)
+{
+    if (!virtual_clock) {
+        poll_timer_wait_until(when);
+    } else if (when < next_timer) {
+        next_timer = when;
+    }
+}
+
+void
+fand_clock_advance(long long int msec)
+{
+    if (msec > 0) {
+        virtual_msec += msec;
+    }
+}
+
+void
+fand_clock_run_until(long long int msec)
+{
+    run_until = virtual_msec + MAX(msec, 0);
+}
+
+bool
+fand_clock_stepping(void)
+{
+    return run_until != LLONG_MIN;
+}
+
+void
+fand_clock_wait(void)
+{
+    if (!virtual_clock) {
+        return;
+    }
+
+    if (next_timer <= virtual_msec) {
+        /* already expired, as with poll_timer_wait_until() */
+        poll_immediate_wake();
+    } else if (run_until != LLONG_MIN) {
+        if (next_timer <= run_until) {
+            virtual_msec = next_timer;
+        } else {
+            virtual_msec = run_until;
+            run_until = LLONG_MIN;
+        }
+        poll_immediate_wake();
+    }
+
+    next_timer = LLONG_MAX;
+}
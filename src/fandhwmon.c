@@ -0,0 +1,601 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for the Linux hwmon backend.
+ *
+ * The fans of the hardware description are numbered from 1 in fru order,
+ * and fan N is served by the attributes of the hwmon directory given as
+ * "hwmon:DIR":
+ *
+ *     fan_speed           fanN_input (rpm, so use fan_speed_multiplier: 1)
+ *     fan_speed_msb       always 0
+ *     fan_fault           fanN_fault, or 0 without it
+ *     fan_speed_control   pwmN of every fan that the control covers (read
+ *                         back from the first). the value is written as
+ *                         is, so fan_speed_settings must be pwm duty
+ *                         cycles, 0 to 255; others fail with ERANGE
+ *     fan_present         fruF_present (F is the fru number, e.g. a GPIO
+ *                         value file linked in), or always present
+ *     fan_direction_detect always the front-to-back value
+ *     leds                ignored
+ *
+ * Several fans or frus may share an i2c_bit_op (the generated built-in
+ * tables and the topology cache keep one object per distinct op). Such an
+ * op is served by the attribute of the first fan or fru that has it.
+ *
+ * The attribute files are opened once, when the backend is opened. With
+ * liburing (HAVE_LIBURING) they are registered with an io_uring, and all
+ * of the reads of a sample are submitted and reaped with one system call;
+ * otherwise, or if the kernel refuses io_uring, each is read with pread().
+ *
+ * fanN_fault and fruF_present are also watched for poll() events, so that
+ * a fault or a pulled fru is seen without waiting for the next sweep.
+ ***************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+#include "hash.h"
+#include "hmap.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "config-yaml.h"
+#include "fandbackend.h"
+#include "fandtopo.h"
+#include "fandtrace.h"
+
+VLOG_DEFINE_THIS_MODULE(fandhwmon);
+
+/* longest attribute value read */
+#define HWMON_BUF_SIZE 32
+
+/* largest value of a pwmN attribute */
+#define HWMON_PWM_MAX 255
+
+/* most reads in flight on one ring */
+#define HWMON_MAX_RING_ENTRIES 256
+
+/* what an i2c_bit_op of the hardware description maps to */
+struct hwmon_op {
+    struct hmap_node node;      /* in hwmon_backend "ops" */
+    const i2c_bit_op *op;
+    int fd;                     /* attribute to read, or -1 */
+    int fd_index;               /* index of "fd" in hwmon_backend "fds" */
+    uint32_t value;             /* value read if there is no attribute */
+    int *pwm_fds;               /* attributes that a write goes to */
+    size_t n_pwm_fds;
+};
+
+struct hwmon_backend {
+    struct fand_backend up;
+    char *dir;
+    struct hmap ops;            /* struct hwmon_op */
+    int *fds;                   /* every open attribute */
+    size_t n_fds;
+
+#ifdef HAVE_LIBURING
+    struct io_uring ring;
+    bool use_ring;              /* ring is set up, with "fds" registered */
+    unsigned int ring_entries;
+    char (*bufs)[HWMON_BUF_SIZE];       /* one per ring entry */
+    struct fand_reg_io **pending;       /* one per ring entry */
+#endif
+
+    /* read batches, for ops-fand/dump */
+    uint64_t n_batches;
+    uint64_t n_reads;
+    uint64_t n_syscalls;
+    long long int last_batch_nsec;
+    long long int total_batch_nsec;
+};
+
+static struct hwmon_backend *
+hwmon_backend_cast(const struct fand_backend *backend)
+{
+    return CONTAINER_OF(backend, struct hwmon_backend, up);
+}
+
+static struct hwmon_op *
+hwmon_op_find(const struct hwmon_backend *hwmon, const i2c_bit_op *op)
+{
+    struct hwmon_op *hop;
+
+    HMAP_FOR_EACH_WITH_HASH (hop, node, hash_pointer(op, 0), &hwmon->ops) {
+        if (hop->op == op) {
+            return hop;
+        }
+    }
+    return NULL;
+}
+
+/* find or add the hwmon_op for "op" (NULL if "op" is). "*is_new" (if
+   nonnull) tells whether it was added, and so still needs its attribute. */
+static struct hwmon_op *
+hwmon_op_add(struct hwmon_backend *hwmon, const i2c_bit_op *op, bool *is_new)
+{
+    struct hwmon_op *hop;
+
+    if (is_new != NULL) {
+        *is_new = false;
+    }
+    if (op == NULL) {
+        return NULL;
+    }
+
+    hop = hwmon_op_find(hwmon, op);
+    if (hop == NULL) {
+        if (is_new != NULL) {
+            *is_new = true;
+        }
+        hop = xzalloc(sizeof *hop);
+        hop->op = op;
+        hop->fd = -1;
+        hop->fd_index = -1;
+        hmap_insert(&hwmon->ops, &hop->node, hash_pointer(op, 0));
+    }
+    return hop;
+}
+
+/* open attribute "<dir>/<name><number><suffix>", returning the fd or -1.
+   the fd's index in "fds" is stored in "*indexp" (if nonnull). */
+static int
+hwmon_attr_open(struct hwmon_backend *hwmon, const char *name, int number,
+                const char *suffix, int flags, int *indexp)
+{
+    char path[256];
+    int fd;
+
+    snprintf(path, sizeof(path), "%s/%s%d%s", hwmon->dir, name, number,
+             suffix);
+    fd = open(path, flags);
+    if (fd >= 0) {
+        hwmon->fds = xrealloc(hwmon->fds,
+                              (hwmon->n_fds + 1) * sizeof *hwmon->fds);
+        if (indexp != NULL) {
+            *indexp = hwmon->n_fds;
+        }
+        hwmon->fds[hwmon->n_fds++] = fd;
+    }
+    return fd;
+}
+
+#ifdef HAVE_LIBURING
+/* set up the ring, or leave "use_ring" false to fall back to pread() */
+static void
+hwmon_ring_init(struct hwmon_backend *hwmon)
+{
+    int error;
+
+    hwmon->ring_entries = MIN(MAX(hwmon->n_fds, 1), HWMON_MAX_RING_ENTRIES);
+    error = io_uring_queue_init(hwmon->ring_entries, &hwmon->ring, 0);
+    if (error < 0) {
+        VLOG_INFO("subsystem %s: io_uring unavailable (%s), using pread()",
+                  hwmon->up.subsystem_name, ovs_strerror(-error));
+        return;
+    }
+
+    error = io_uring_register_files(&hwmon->ring, hwmon->fds, hwmon->n_fds);
+    if (error < 0) {
+        VLOG_INFO("subsystem %s: unable to register hwmon files with "
+                  "io_uring (%s), using pread()",
+                  hwmon->up.subsystem_name, ovs_strerror(-error));
+        io_uring_queue_exit(&hwmon->ring);
+        return;
+    }
+
+    hwmon->bufs = xmalloc(hwmon->ring_entries * sizeof *hwmon->bufs);
+    hwmon->pending = xmalloc(hwmon->ring_entries * sizeof *hwmon->pending);
+    hwmon->use_ring = true;
+}
+
+/* drop the ring for good, cancelling any reads still in flight. the
+   buffers are kept until the backend is closed, since a cancelled read
+   may still be writing into one. */
+static void
+hwmon_ring_destroy(struct hwmon_backend *hwmon)
+{
+    if (hwmon->use_ring) {
+        io_uring_queue_exit(&hwmon->ring);
+        hwmon->use_ring = false;
+    }
+}
+#endif
+
+static void
+hwmon_backend_close(struct fand_backend *backend)
+{
+    struct hwmon_backend *hwmon = hwmon_backend_cast(backend);
+    struct hwmon_op *hop, *next;
+    size_t idx;
+
+    HMAP_FOR_EACH_SAFE (hop, next, node, &hwmon->ops) {
+        hmap_remove(&hwmon->ops, &hop->node);
+        free(hop->pwm_fds);
+        free(hop);
+    }
+    hmap_destroy(&hwmon->ops);
+
+#ifdef HAVE_LIBURING
+    hwmon_ring_destroy(hwmon);
+    free(hwmon->bufs);
+    free(hwmon->pending);
+#endif
+    for (idx = 0; idx < hwmon->n_fds; idx++) {
+        close(hwmon->fds[idx]);
+    }
+    free(hwmon->fds);
+    free(hwmon->dir);
+    fand_backend_uninit(backend);
+    free(hwmon);
+}
+
+static int
+hwmon_backend_open(const char *subsystem_name, const char *arg,
+                   struct fand_backend **backendp)
+{
+    struct hwmon_backend *hwmon;
+    const struct fand_topo *topo;
+    const YamlFanInfo *info;
+    int fru_count;
+    int fru_idx;
+    int number;
+
+    if (arg == NULL || arg[0] == '\0') {
+        VLOG_ERR("subsystem %s: the hwmon backend needs a directory "
+                 "(hwmon:DIR)", subsystem_name);
+        return EINVAL;
+    }
+
+    topo = fand_topo_find(subsystem_name);
+    if (topo == NULL || topo->info == NULL || topo->n_frus <= 0) {
+        return ENOENT;
+    }
+    info = topo->info;
+    fru_count = topo->n_frus;
+
+    hwmon = xzalloc(sizeof *hwmon);
+    fand_backend_init(&hwmon->up, &fand_hwmon_backend_class, subsystem_name);
+    hwmon->dir = xstrdup(arg);
+    hmap_init(&hwmon->ops);
+
+    number = 0;
+    for (fru_idx = 0; fru_idx < fru_count; fru_idx++) {
+        const YamlFanFru *fru = topo->frus[fru_idx];
+        struct hwmon_op *hop;
+        size_t fan_idx;
+        bool is_new;
+
+        hop = hwmon_op_add(hwmon, fru->fan_present, &is_new);
+        if (is_new) {
+            hop->value = 1;
+            hop->fd = hwmon_attr_open(hwmon, "fru", fru->number, "_present",
+                                      O_RDONLY, &hop->fd_index);
+            if (hop->fd >= 0) {
+                fand_backend_watch(&hwmon->up, hop->fd, fru);
+            }
+        }
+        hop = hwmon_op_add(hwmon, fru->fan_direction_detect, NULL);
+        if (hop != NULL) {
+            hop->value = info->direction_values.f2b;
+        }
+
+        for (fan_idx = 0; fru->fans[fan_idx] != NULL; fan_idx++) {
+            const YamlFan *fan = fru->fans[fan_idx];
+            const i2c_bit_op *control;
+            int fd;
+
+            number++;
+
+            hop = hwmon_op_add(hwmon, fan->fan_speed, &is_new);
+            if (hop == NULL || is_new) {
+                fd = hwmon_attr_open(hwmon, "fan", number, "_input", O_RDONLY,
+                                     hop ? &hop->fd_index : NULL);
+                if (fd < 0) {
+                    int error = errno;
+
+                    VLOG_ERR("subsystem %s: unable to open %s/fan%d_input "
+                             "(%s)", subsystem_name, hwmon->dir, number,
+                             ovs_strerror(error));
+                    hwmon_backend_close(&hwmon->up);
+                    return error;
+                }
+                if (hop != NULL) {
+                    hop->fd = fd;
+                }
+            }
+            hwmon_op_add(hwmon, fan->fan_speed_msb, NULL);
+
+            hop = hwmon_op_add(hwmon, fan->fan_fault, &is_new);
+            if (is_new) {
+                hop->fd = hwmon_attr_open(hwmon, "fan", number, "_fault",
+                                          O_RDONLY, &hop->fd_index);
+                if (hop->fd >= 0) {
+                    fand_backend_watch(&hwmon->up, hop->fd, fru);
+                }
+            }
+
+            if (info->fan_speed_control_type == PER_FAN) {
+                control = fan->fan_speed_control;
+            } else if (info->fan_speed_control_type == PER_FRU) {
+                control = fru->fan_speed_control;
+            } else {
+                control = info->fan_speed_control;
+            }
+            hop = hwmon_op_add(hwmon, control, NULL);
+            fd = hwmon_attr_open(hwmon, "pwm", number, "", O_RDWR, NULL);
+            if (hop != NULL && fd >= 0) {
+                hop->pwm_fds = xrealloc(hop->pwm_fds, (hop->n_pwm_fds + 1)
+                                                      * sizeof *hop->pwm_fds);
+                hop->pwm_fds[hop->n_pwm_fds++] = fd;
+            }
+        }
+    }
+
+#ifdef HAVE_LIBURING
+    hwmon_ring_init(hwmon);
+#endif
+
+    VLOG_INFO("subsystem %s: %d fans on hwmon %s", subsystem_name, number,
+              hwmon->dir);
+    *backendp = &hwmon->up;
+    return 0;
+}
+
+static void
+hwmon_parse(struct fand_reg_io *io, char *buf, ssize_t n)
+{
+    if (n < 0) {
+        io->rc = n;
+    } else {
+        buf[n] = '\0';
+        io->value = strtoul(buf, NULL, 10);
+        io->rc = 0;
+    }
+}
+
+static void
+hwmon_pread(struct hwmon_backend *hwmon, int fd, struct fand_reg_io *io)
+{
+    char buf[HWMON_BUF_SIZE];
+    ssize_t n;
+
+    n = pread(fd, buf, sizeof buf - 1, 0);
+    hwmon_parse(io, buf, n < 0 ? -errno : n);
+    hwmon->n_reads++;
+    hwmon->n_syscalls++;
+}
+
+/* handle a read that doesn't need an attribute, or that isn't worth
+   batching. returns the op to read from its attribute, or NULL if "io" is
+   complete. */
+static const struct hwmon_op *
+hwmon_read_start(struct hwmon_backend *hwmon, struct fand_reg_io *io)
+{
+    const struct hwmon_op *hop = hwmon_op_find(hwmon, io->op);
+
+    io->value = 0;
+    if (hop == NULL) {
+        io->rc = -ENOENT;
+    } else if (hop->fd < 0 && hop->n_pwm_fds > 0) {
+        /* a speed control reads back from its first pwmN (on a warm
+           restart, see fandckpt.h) */
+        hwmon_pread(hwmon, hop->pwm_fds[0], io);
+    } else if (hop->fd < 0) {
+        io->value = hop->value;
+        io->rc = 0;
+    } else {
+        io->rc = -EIO;          /* until the read completes */
+        return hop;
+    }
+    return NULL;
+}
+
+#ifdef HAVE_LIBURING
+/* read up to "ring_entries" attributes from "ios", starting at "*idxp",
+   with a single io_uring_submit_and_wait() */
+static void
+hwmon_ring_read(struct hwmon_backend *hwmon, struct fand_reg_io ios[],
+                size_t n, size_t *idxp)
+{
+    struct io_uring_cqe *cqe;
+    unsigned int n_pending = 0;
+    unsigned int n_done;
+    unsigned int slot;
+    int submitted;
+    int error;
+
+    for (; *idxp < n && n_pending < hwmon->ring_entries; (*idxp)++) {
+        const struct hwmon_op *hop = hwmon_read_start(hwmon, &ios[*idxp]);
+        struct io_uring_sqe *sqe;
+
+        if (hop == NULL) {
+            continue;
+        }
+
+        sqe = io_uring_get_sqe(&hwmon->ring);
+        io_uring_prep_read(sqe, hop->fd_index, hwmon->bufs[n_pending],
+                           HWMON_BUF_SIZE - 1, 0);
+        sqe->flags |= IOSQE_FIXED_FILE;
+        io_uring_sqe_set_data(sqe, (void *) (uintptr_t) n_pending);
+        hwmon->pending[n_pending++] = &ios[*idxp];
+    }
+
+    if (n_pending == 0) {
+        return;
+    }
+
+    /* the kernel doesn't wait if it submits fewer than asked for */
+    submitted = io_uring_submit_and_wait(&hwmon->ring, n_pending);
+    hwmon->n_syscalls++;
+    error = submitted < 0 ? submitted : 0;
+
+    /* each completion clears its slot */
+    for (n_done = 0; n_done < (unsigned int) MAX(submitted, 0); n_done++) {
+        uintptr_t idx;
+
+        do {
+            error = io_uring_wait_cqe(&hwmon->ring, &cqe);
+        } while (error == -EINTR);
+        if (error < 0) {
+            break;
+        }
+        idx = (uintptr_t) io_uring_cqe_get_data(cqe);
+        hwmon_parse(hwmon->pending[idx], hwmon->bufs[idx], cqe->res);
+        hwmon->pending[idx] = NULL;
+        hwmon->n_reads++;
+        io_uring_cqe_seen(&hwmon->ring, cqe);
+    }
+    if (n_done == n_pending) {
+        return;
+    }
+
+    /* a failed or short submit, or a completion that can't be reaped.
+       what's left on the ring would complete into a later batch, so drop
+       the ring for good and finish this batch with pread() */
+    if (error < 0) {
+        VLOG_WARN("subsystem %s: io_uring failed (%s), using pread()",
+                  hwmon->up.subsystem_name, ovs_strerror(-error));
+    } else {
+        VLOG_WARN("subsystem %s: io_uring submitted %d of %u reads, using "
+                  "pread()", hwmon->up.subsystem_name, submitted, n_pending);
+    }
+    hwmon_ring_destroy(hwmon);
+    for (slot = 0; slot < n_pending; slot++) {
+        struct fand_reg_io *io = hwmon->pending[slot];
+
+        if (io != NULL) {
+            hwmon_pread(hwmon, hwmon_op_find(hwmon, io->op)->fd, io);
+        }
+    }
+}
+#endif
+
+static void
+hwmon_backend_read(struct fand_backend *backend, struct fand_reg_io ios[],
+                   size_t n)
+{
+    struct hwmon_backend *hwmon = hwmon_backend_cast(backend);
+    long long int start_nsec = fand_trace_nsec();
+    size_t idx = 0;
+
+#ifdef HAVE_LIBURING
+    while (idx < n && hwmon->use_ring) {
+        hwmon_ring_read(hwmon, ios, n, &idx);
+    }
+#endif
+
+    /* without a ring (or what's left after losing it) */
+    for (; idx < n; idx++) {
+        const struct hwmon_op *hop = hwmon_read_start(hwmon, &ios[idx]);
+
+        if (hop != NULL) {
+            hwmon_pread(hwmon, hop->fd, &ios[idx]);
+        }
+    }
+
+    hwmon->n_batches++;
+    hwmon->last_batch_nsec = fand_trace_nsec() - start_nsec;
+    hwmon->total_batch_nsec += hwmon->last_batch_nsec;
+}
+
+static int
+hwmon_attr_write(int fd, uint32_t value)
+{
+    char buf[16];
+    int len;
+
+    if (value > HWMON_PWM_MAX) {
+        return -ERANGE;
+    }
+
+    len = snprintf(buf, sizeof buf, "%u\n", value);
+    if (pwrite(fd, buf, len, 0) != len) {
+        return -errno;
+    }
+    /* sysfs ignores this, but a stand-in regular file must not keep the
+       tail of a longer previous value */
+    ignore(ftruncate(fd, len));
+    return 0;
+}
+
+static void
+hwmon_backend_write(struct fand_backend *backend, struct fand_reg_io ios[],
+                    size_t n)
+{
+    const struct hwmon_backend *hwmon = hwmon_backend_cast(backend);
+    size_t idx;
+
+    for (idx = 0; idx < n; idx++) {
+        const struct hwmon_op *hop = hwmon_op_find(hwmon, ios[idx].op);
+        size_t pwm_idx;
+
+        /* leds and controls without a pwm attribute have nothing to do */
+        ios[idx].rc = 0;
+        for (pwm_idx = 0; hop != NULL && pwm_idx < hop->n_pwm_fds;
+             pwm_idx++) {
+            int rc = hwmon_attr_write(hop->pwm_fds[pwm_idx], ios[idx].value);
+            if (rc != 0) {
+                ios[idx].rc = rc;
+            }
+        }
+    }
+}
+
+static void
+hwmon_backend_dump(const struct fand_backend *backend, struct ds *ds)
+{
+    const struct hwmon_backend *hwmon = hwmon_backend_cast(backend);
+    bool use_ring = false;
+
+#ifdef HAVE_LIBURING
+    use_ring = hwmon->use_ring;
+#endif
+    ds_put_format(ds, "        hwmon %s, %d attribute files, reads by %s\n",
+                  hwmon->dir, (int) hwmon->n_fds,
+                  use_ring ? "io_uring" : "pread()");
+    ds_put_format(ds, "        %"PRIu64" sample batches, %"PRIu64" reads, "
+                  "%"PRIu64" system calls\n",
+                  hwmon->n_batches, hwmon->n_reads, hwmon->n_syscalls);
+    if (hwmon->n_batches) {
+        ds_put_format(ds, "        batch latency: last %lld us, "
+                      "average %lld us\n",
+                      hwmon->last_batch_nsec / 1000,
+                      hwmon->total_batch_nsec / 1000
+                      / (long long int) hwmon->n_batches);
+    }
+}
+
+const struct fand_backend_class fand_hwmon_backend_class = {
+    "hwmon",
+    hwmon_backend_open,
+    hwmon_backend_close,
+    hwmon_backend_read,
+    hwmon_backend_write,
+    hwmon_backend_dump,
+    true,                       /* concurrent */
+};
@@ -0,0 +1,303 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for the Prometheus text format metrics exporter.
+ *
+ * The output is meant for the node-exporter textfile collector. It is
+ * generated only from the daemon's in-memory state, never from OVSDB.
+ ***************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dynamic-string.h"
+#include "openvswitch/vlog.h"
+#include "fandmetrics.h"
+#include "fanspeed.h"
+#include "fanstatus.h"
+#include "fandirection.h"
+
+VLOG_DEFINE_THIS_MODULE(fandmetrics);
+
+#define USEC_PER_SEC    1000000.0
+
+/* label values are quoted, so escape the characters that the text format
+   reserves inside quotes */
+static void
+put_label(struct ds *ds, const char *name, const char *value)
+{
+    ds_put_format(ds, "%s=\"", name);
+    for (; *value; value++) {
+        switch (*value) {
+        case '\\':
+            ds_put_cstr(ds, "\\\\");
+            break;
+        case '"':
+            ds_put_cstr(ds, "\\\"");
+            break;
+        case '\n':
+            ds_put_cstr(ds, "\\n");
+            break;
+        default:
+            ds_put_char(ds, *value);
+            break;
+        }
+    }
+    ds_put_char(ds, '"');
+}
+
+static void
+put_header(struct ds *ds, const char *metric, const char *type,
+           const char *help)
+{
+    ds_put_format(ds, "# HELP %s %s\n", metric, help);
+    ds_put_format(ds, "# TYPE %s %s\n", metric, type);
+}
+
+static void
+put_fan_metrics(struct ds *ds, const struct shash *subsystems)
+{
+    const struct shash_node *node;
+    const struct locl_fan *fan;
+    size_t i;
+
+    put_header(ds, "ops_fand_fan_rpm", "gauge",
+               "Fan speed in revolutions per minute.");
+    SHASH_FOR_EACH(node, subsystems) {
+        const struct locl_subsystem *subsystem = node->data;
+        LOCL_FAN_FOR_EACH(fan, subsystem) {
+            ds_put_cstr(ds, "ops_fand_fan_rpm{");
+            put_label(ds, "subsystem", subsystem->name);
+            ds_put_char(ds, ',');
+            put_label(ds, "fan", fan->name);
+            ds_put_format(ds, "} %d\n", fan->rpm);
+        }
+    }
+
+    put_header(ds, "ops_fand_fan_status", "gauge",
+               "Fan status, 1 for the current status.");
+    SHASH_FOR_EACH(node, subsystems) {
+        const struct locl_subsystem *subsystem = node->data;
+        LOCL_FAN_FOR_EACH(fan, subsystem) {
+            for (i = FAND_STATUS_UNINITIALIZED; i <= FAND_STATUS_FAULT; i++) {
+                ds_put_cstr(ds, "ops_fand_fan_status{");
+                put_label(ds, "subsystem", subsystem->name);
+                ds_put_char(ds, ',');
+                put_label(ds, "fan", fan->name);
+                ds_put_char(ds, ',');
+                put_label(ds, "status", fan_status_enum_to_string(i));
+                ds_put_format(ds, "} %d\n", fan->status == i);
+            }
+        }
+    }
+
+    put_header(ds, "ops_fand_fan_direction", "gauge",
+               "Fan airflow direction, 1 for the current direction.");
+    SHASH_FOR_EACH(node, subsystems) {
+        const struct locl_subsystem *subsystem = node->data;
+        LOCL_FAN_FOR_EACH(fan, subsystem) {
+            for (i = FAND_DIRECTION_F2B; i <= FAND_DIRECTION_B2F; i++) {
+                const char *direction = fan_direction_enum_to_string(i);
+                bool match = fan->direction != NULL &&
+                             strcmp(fan->direction, direction) == 0;
+
+                ds_put_cstr(ds, "ops_fand_fan_direction{");
+                put_label(ds, "subsystem", subsystem->name);
+                ds_put_char(ds, ',');
+                put_label(ds, "fan", fan->name);
+                ds_put_char(ds, ',');
+                put_label(ds, "direction", direction);
+                ds_put_format(ds, "} %d\n", match);
+            }
+        }
+    }
+
+    put_header(ds, "ops_fand_fan_speed_level", "gauge",
+               "Fan speed level (0=slow, 1=normal, 2=medium, 3=fast, 4=max).");
+    SHASH_FOR_EACH(node, subsystems) {
+        const struct locl_subsystem *subsystem = node->data;
+        LOCL_FAN_FOR_EACH(fan, subsystem) {
+            ds_put_cstr(ds, "ops_fand_fan_speed_level{");
+            put_label(ds, "subsystem", subsystem->name);
+            ds_put_char(ds, ',');
+            put_label(ds, "fan", fan->name);
+            ds_put_format(ds, "} %d\n", (int)fan->speed);
+        }
+    }
+}
+
+static void
+put_subsystem_metrics(struct ds *ds, const struct shash *subsystems)
+{
+    const struct shash_node *node;
+
+    put_header(ds, "ops_fand_subsystem_speed_level", "gauge",
+               "Fan speed level applied to the subsystem.");
+    SHASH_FOR_EACH(node, subsystems) {
+        const struct locl_subsystem *subsystem = node->data;
+        ds_put_cstr(ds, "ops_fand_subsystem_speed_level{");
+        put_label(ds, "subsystem", subsystem->name);
+        ds_put_format(ds, "} %d\n", (int)subsystem->speed);
+    }
+
+    put_header(ds, "ops_fand_subsystem_sensor_speed_level", "gauge",
+               "Fan speed level requested by the temperature sensors.");
+    SHASH_FOR_EACH(node, subsystems) {
+        const struct locl_subsystem *subsystem = node->data;
+        ds_put_cstr(ds, "ops_fand_subsystem_sensor_speed_level{");
+        put_label(ds, "subsystem", subsystem->name);
+        ds_put_format(ds, "} %d\n", (int)subsystem->fan_speed);
+    }
+
+    put_header(ds, "ops_fand_subsystem_speed_override_level", "gauge",
+               "Configured fan speed override level (-1 if none).");
+    SHASH_FOR_EACH(node, subsystems) {
+        const struct locl_subsystem *subsystem = node->data;
+        ds_put_cstr(ds, "ops_fand_subsystem_speed_override_level{");
+        put_label(ds, "subsystem", subsystem->name);
+        ds_put_format(ds, "} %d\n", (int)subsystem->fan_speed_override);
+    }
+}
+
+static void
+put_daemon_metrics(struct ds *ds, const struct fand_stats *stats)
+{
+    put_header(ds, "ops_fand_sweeps_total", "counter",
+               "Completed fan status sweeps.");
+    ds_put_format(ds, "ops_fand_sweeps_total %llu\n",
+                  (unsigned long long)stats->n_sweeps);
+
+    put_header(ds, "ops_fand_sweep_seconds_total", "counter",
+               "Time spent in fan status sweeps.");
+    ds_put_format(ds, "ops_fand_sweep_seconds_total %.6f\n",
+                  stats->total_sweep_usec / USEC_PER_SEC);
+
+    put_header(ds, "ops_fand_last_sweep_seconds", "gauge",
+               "Duration of the last fan status sweep.");
+    ds_put_format(ds, "ops_fand_last_sweep_seconds %.6f\n",
+                  stats->last_sweep_usec / USEC_PER_SEC);
+
+    put_header(ds, "ops_fand_last_sweep_slices", "gauge",
+               "Poll loop iterations the last sweep was spread over.");
+    ds_put_format(ds, "ops_fand_last_sweep_slices %u\n",
+                  stats->last_sweep_slices);
+
+    put_header(ds, "ops_fand_sweep_yields_total", "counter",
+               "Times a sweep ran out of its time budget and yielded.");
+    ds_put_format(ds, "ops_fand_sweep_yields_total %llu\n",
+                  (unsigned long long)stats->n_sweep_yields);
+
+    put_header(ds, "ops_fand_sweep_overruns_total", "counter",
+               "Sweep iterations that took longer than the time budget.");
+    ds_put_format(ds, "ops_fand_sweep_overruns_total %llu\n",
+                  (unsigned long long)stats->n_sweep_overruns);
+
+    put_header(ds, "ops_fand_takeover_seconds", "gauge",
+               "Time from getting the ops_fand lock to controlling the fans.");
+    ds_put_format(ds, "ops_fand_takeover_seconds %.6f\n",
+                  stats->takeover_usec / USEC_PER_SEC);
+
+    put_header(ds, "ops_fand_ready_seconds", "gauge",
+               "Time from process start to the fans being ready (cur_hw).");
+    ds_put_format(ds, "ops_fand_ready_seconds %.6f\n",
+                  stats->ready_usec / USEC_PER_SEC);
+
+    put_header(ds, "ops_fand_reconfigures_total", "counter",
+               "Reconfigurations triggered by database changes.");
+    ds_put_format(ds, "ops_fand_reconfigures_total %llu\n",
+                  (unsigned long long)stats->n_reconfigures);
+
+    put_header(ds, "ops_fand_txn_commits_total", "counter",
+               "OVSDB transactions committed.");
+    ds_put_format(ds, "ops_fand_txn_commits_total %llu\n",
+                  (unsigned long long)stats->n_txn_commits);
+
+    put_header(ds, "ops_fand_txn_errors_total", "counter",
+               "OVSDB transactions that did not succeed.");
+    ds_put_format(ds, "ops_fand_txn_errors_total %llu\n",
+                  (unsigned long long)stats->n_txn_errors);
+}
+
+int
+fand_metrics_write(const char *path, const struct shash *subsystems,
+                   const struct fand_stats *stats)
+{
+    /* kept between writes, so that once it has grown to fit, writing the
+       metrics doesn't allocate */
+    static struct ds ds = DS_EMPTY_INITIALIZER;
+    char tmp_path[PATH_MAX];
+    size_t ofs;
+    int error = 0;
+    int fd;
+
+    /* the temporary file must be in the same directory (and file system)
+       for the rename to be atomic. the collector only reads *.prom files,
+       so it ignores the temporary file. */
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path)
+            >= (int)sizeof(tmp_path)) {
+        return ENAMETOOLONG;
+    }
+
+    ds_clear(&ds);
+    put_fan_metrics(&ds, subsystems);
+    put_subsystem_metrics(&ds, subsystems);
+    put_daemon_metrics(&ds, stats);
+
+    fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        error = errno;
+        VLOG_WARN("unable to create metrics file %s (%s)",
+                  tmp_path, strerror(error));
+        return error;
+    }
+
+    for (ofs = 0; ofs < ds.length; ) {
+        ssize_t n = write(fd, ds.string + ofs, ds.length - ofs);
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            error = errno;
+            break;
+        }
+        ofs += n;
+    }
+    if (close(fd) != 0 && !error) {
+        error = errno;
+    }
+
+    if (!error && rename(tmp_path, path) != 0) {
+        error = errno;
+    }
+
+    if (error) {
+        VLOG_WARN("unable to write metrics file %s (%s)",
+                  path, strerror(error));
+        unlink(tmp_path);
+    }
+
+    return error;
+}
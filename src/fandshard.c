@@ -0,0 +1,96 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for sharding subsystems across ops-fand instances.
+ ***************************************************************************/
+
+#include <fnmatch.h>
+#include <stdio.h>
+
+#include "hash.h"
+#include "util.h"
+#include "fandshard.h"
+
+static char *shard_spec = NULL;
+static char *shard_lock_name = NULL;
+
+/* hash slot "slot" of "n_slots", or a pattern if "n_slots" is 0 */
+static unsigned int slot;
+static unsigned int n_slots;
+
+char *
+fand_shard_set(const char *spec)
+{
+    unsigned int n, m;
+    int len;
+
+    free(shard_spec);
+    free(shard_lock_name);
+    shard_spec = xstrdup(spec);
+
+    if (sscanf(spec, "%u/%u%n", &n, &m, &len) == 2 && spec[len] == '\0') {
+        if (m == 0 || n >= m) {
+            return xasprintf("hash slot %u of %u does not exist", n, m);
+        }
+        slot = n;
+        n_slots = m;
+        shard_lock_name = xasprintf("ops_fand_slot_%u_of_%u", n, m);
+    } else {
+        if (spec[0] == '\0') {
+            return xstrdup("empty subsystem name pattern");
+        }
+        n_slots = 0;
+        /* lock names may only contain letters, digits and underscores */
+        shard_lock_name = xasprintf("ops_fand_shard_%08x",
+                                    hash_string(spec, 0));
+    }
+    return NULL;
+}
+
+bool
+fand_shard_enabled(void)
+{
+    return shard_spec != NULL;
+}
+
+bool
+fand_shard_owns(const char *name)
+{
+    if (shard_spec == NULL) {
+        return true;
+    } else if (n_slots) {
+        return hash_string(name, 0) % n_slots == slot;
+    } else {
+        return fnmatch(shard_spec, name, 0) == 0;
+    }
+}
+
+const char *
+fand_shard_spec(void)
+{
+    return shard_spec;
+}
+
+const char *
+fand_shard_lock_name(void)
+{
+    return shard_lock_name != NULL ? shard_lock_name : "ops_fand";
+}
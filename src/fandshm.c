@@ -0,0 +1,194 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for the writer side of the live fan state shared memory
+ * segment.
+ ***************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "openvswitch/vlog.h"
+#include "timeval.h"
+#include "fand-shm.h"
+#include "fandshm.h"
+#include "fand-locl.h"
+#include "fandirection.h"
+#include "fandclock.h"
+
+VLOG_DEFINE_THIS_MODULE(fandshm);
+
+static struct fand_shm *shm = NULL;
+
+int
+fand_shm_create(const char *name)
+{
+    void *addr;
+    int error;
+    int fd;
+
+    if (shm != NULL) {
+        /* control has been regained: take the segment back */
+        goto claim;
+    }
+    if (name == NULL) {
+        name = FAND_SHM_DEFAULT_NAME;
+    }
+
+    fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        error = errno;
+        VLOG_ERR("unable to open shared memory segment %s (%s)",
+                 name, strerror(error));
+        return error;
+    }
+
+    if (ftruncate(fd, sizeof(struct fand_shm)) < 0) {
+        error = errno;
+        VLOG_ERR("unable to size shared memory segment %s (%s)",
+                 name, strerror(error));
+        close(fd);
+        return error;
+    }
+
+    addr = mmap(NULL, sizeof(struct fand_shm), PROT_READ | PROT_WRITE,
+                MAP_SHARED, fd, 0);
+    error = errno;
+    close(fd);
+
+    if (addr == MAP_FAILED) {
+        VLOG_ERR("unable to map shared memory segment %s (%s)",
+                 name, strerror(error));
+        return error;
+    }
+
+    shm = addr;
+
+claim:
+    /* a previous instance may have left the segment mid-update, or with an
+       older layout. mark it as being updated until the first publish. */
+    if (!(shm->hdr.seq & 1)) {
+        __atomic_store_n(&shm->hdr.seq, shm->hdr.seq + 1, __ATOMIC_RELAXED);
+    }
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    shm->hdr.magic = FAND_SHM_MAGIC;
+    shm->hdr.version = FAND_SHM_VERSION;
+    shm->hdr.size = sizeof(struct fand_shm);
+    shm->hdr.pid = getpid();
+    shm->hdr.n_subsystems = 0;
+    shm->hdr.n_fans = 0;
+
+    return 0;
+}
+
+static void
+copy_name(char *dst, const char *src)
+{
+    strncpy(dst, src, FAND_SHM_NAME_LEN - 1);
+    dst[FAND_SHM_NAME_LEN - 1] = '\0';
+}
+
+void
+fand_shm_publish(const struct shash *subsystems)
+{
+    const struct shash_node *node;
+    const struct locl_fan *fan;
+    uint32_t n_subsystems = 0;
+    uint32_t n_fans = 0;
+    uint64_t seq;
+
+    if (shm == NULL) {
+        return;
+    }
+
+    /* make the sequence odd (if it isn't already, from create) before any
+       of the data is touched */
+    seq = shm->hdr.seq | 1;
+    __atomic_store_n(&shm->hdr.seq, seq, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    SHASH_FOR_EACH(node, subsystems) {
+        const struct locl_subsystem *subsystem = node->data;
+        struct fand_shm_subsystem *shm_subsys;
+
+        if (n_subsystems == FAND_SHM_MAX_SUBSYSTEMS) {
+            VLOG_WARN_ONCE("too many subsystems for shared memory segment");
+            break;
+        }
+
+        shm_subsys = &shm->subsystems[n_subsystems];
+        copy_name(shm_subsys->name, subsystem->name);
+        shm_subsys->speed = subsystem->speed;
+        shm_subsys->fan_speed = subsystem->fan_speed;
+        shm_subsys->fan_speed_override = subsystem->fan_speed_override;
+        shm_subsys->first_fan = n_fans;
+
+        LOCL_FAN_FOR_EACH(fan, subsystem) {
+            struct fand_shm_fan *shm_fan;
+
+            if (n_fans == FAND_SHM_MAX_FANS) {
+                VLOG_WARN_ONCE("too many fans for shared memory segment");
+                break;
+            }
+
+            shm_fan = &shm->fans[n_fans++];
+            copy_name(shm_fan->name, fan->name);
+            shm_fan->subsystem = n_subsystems;
+            shm_fan->rpm = fan->rpm;
+            shm_fan->status = fan->status;
+            shm_fan->direction = fan_direction_string_to_enum(fan->direction);
+            shm_fan->speed = fan->speed;
+            shm_fan->sample_usec = fan->sample_usec;
+        }
+
+        shm_subsys->n_fans = n_fans - shm_subsys->first_fan;
+        n_subsystems++;
+    }
+
+    shm->hdr.n_subsystems = n_subsystems;
+    shm->hdr.n_fans = n_fans;
+    shm->hdr.update_usec = fand_clock_wall_usec();
+
+    __atomic_store_n(&shm->hdr.seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+void
+fand_shm_destroy(void)
+{
+    if (shm != NULL) {
+        /* tell readers the data is no longer being kept up to date, unless
+           another instance has taken the segment over since */
+        if (shm->hdr.pid == getpid()) {
+            uint64_t seq = shm->hdr.seq | 1;
+
+            __atomic_store_n(&shm->hdr.seq, seq, __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_RELEASE);
+            shm->hdr.pid = 0;
+            __atomic_store_n(&shm->hdr.seq, seq + 1, __ATOMIC_RELEASE);
+        }
+
+        munmap(shm, sizeof(struct fand_shm));
+        shm = NULL;
+    }
+}
@@ -0,0 +1,789 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for the simulated fan controller.
+ ***************************************************************************/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hash.h"
+#include "hmap.h"
+#include "shash.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "config-yaml.h"
+#include "fandbackend.h"
+#include "fandsim.h"
+#include "fandclock.h"
+#include "fandtopo.h"
+
+VLOG_DEFINE_THIS_MODULE(fandsim);
+
+#define SIM_ALL_DEVICES     "*"
+
+/* what a simulated bit operation reads */
+enum sim_role {
+    SIM_REG,            /* plain register contents */
+    SIM_TACH,           /* fan tachometer (least significant byte) */
+    SIM_TACH_MSB,       /* fan tachometer (most significant byte) */
+    SIM_PRESENT         /* fan FRU presence */
+};
+
+/* forced bits in one register of a device */
+struct sim_stuck {
+    uint32_t address;
+    uint32_t mask;
+    uint32_t value;
+};
+
+/* per-device fault injection settings */
+struct sim_device {
+    int latency_usec;
+    int nak_percent;
+    struct sim_stuck *stuck;
+    size_t n_stuck;
+};
+
+/* one register of one device in a subsystem */
+struct sim_reg {
+    char *device;
+    uint32_t address;
+    uint32_t value;
+};
+
+struct sim_fru {
+    int number;
+    bool present;
+};
+
+struct sim_fan {
+    const char *name;
+    const i2c_bit_op *control_op;   /* speed control driving this fan */
+    struct sim_reg *control;
+    struct sim_fru *fru;
+    bool has_msb;
+    double rpm;
+    long long int updated;          /* fand_clock_msec() of last model update */
+};
+
+struct sim_op {
+    struct hmap_node node;          /* in sim_subsystem.ops, by op pointer */
+    const i2c_bit_op *op;
+    enum sim_role role;
+    struct sim_reg *reg;
+    struct sim_fan *fan;            /* for SIM_TACH and SIM_TACH_MSB */
+    struct sim_fru *fru;            /* for SIM_PRESENT */
+};
+
+struct sim_subsystem {
+    char *name;
+    const YamlFanInfo *info;
+    struct shash regs;              /* struct sim_reg, by "device:address" */
+    struct hmap ops;                /* struct sim_op */
+    struct sim_fru *frus;
+    int n_frus;
+    struct sim_fan *fans;
+    int n_fans;
+};
+
+static bool sim_enabled = false;
+static int sim_tau_msec = 3000;
+static int sim_max_rpm = 18000;
+static uint32_t sim_random = 1;
+
+static struct shash sim_devices;        /* struct sim_device, by name */
+static struct shash sim_subsystems;     /* struct sim_subsystem, by name */
+static struct shash sim_removed_frus;   /* "subsystem:fru" keys, no data */
+
+static void sim_remove_subsystem(const char *name);
+
+bool
+fand_sim_enabled(void)
+{
+    return sim_enabled;
+}
+
+char *
+fand_sim_enable(const char *spec)
+{
+    if (!sim_enabled) {
+        shash_init(&sim_devices);
+        shash_init(&sim_subsystems);
+        shash_init(&sim_removed_frus);
+        sim_enabled = true;
+    }
+
+    return fand_sim_configure(spec ? spec : "");
+}
+
+/* xorshift, so that injected NAKs are reproducible for a given seed */
+static uint32_t
+sim_rand(void)
+{
+    sim_random ^= sim_random << 13;
+    sim_random ^= sim_random >> 17;
+    sim_random ^= sim_random << 5;
+    return sim_random;
+}
+
+static struct sim_device *
+sim_device_get(const char *name)
+{
+    struct sim_device *device = shash_find_data(&sim_devices, name);
+
+    if (device == NULL) {
+        device = xzalloc(sizeof *device);
+        shash_add(&sim_devices, name, device);
+    }
+
+    return device;
+}
+
+static struct sim_device *
+sim_device_lookup(const char *name)
+{
+    struct sim_device *device = shash_find_data(&sim_devices, name);
+
+    return device ? device : shash_find_data(&sim_devices, SIM_ALL_DEVICES);
+}
+
+static void
+sim_set_stuck(struct sim_device *device, uint32_t address, uint32_t mask,
+              uint32_t value)
+{
+    size_t i;
+
+    for (i = 0; i < device->n_stuck; i++) {
+        if (device->stuck[i].address == address) {
+            break;
+        }
+    }
+
+    if (mask == 0) {
+        if (i < device->n_stuck) {
+            device->stuck[i] = device->stuck[--device->n_stuck];
+        }
+        return;
+    }
+
+    if (i == device->n_stuck) {
+        device->stuck = xrealloc(device->stuck,
+                                 ++device->n_stuck * sizeof *device->stuck);
+    }
+    device->stuck[i].address = address;
+    device->stuck[i].mask = mask;
+    device->stuck[i].value = value;
+}
+
+/* mark FRU "number" of subsystem "name" as present or pulled, now and for
+   the subsystem's future incarnations */
+static void
+sim_set_fru_present(const char *name, int number, bool present)
+{
+    struct sim_subsystem *subsys;
+    char key[128];
+    int idx;
+
+    snprintf(key, sizeof(key), "%s:%d", name, number);
+    if (present) {
+        shash_find_and_delete(&sim_removed_frus, key);
+    } else {
+        shash_add_once(&sim_removed_frus, key, NULL);
+    }
+
+    subsys = shash_find_data(&sim_subsystems, name);
+    if (subsys == NULL) {
+        return;
+    }
+    for (idx = 0; idx < subsys->n_frus; idx++) {
+        if (subsys->frus[idx].number == number) {
+            subsys->frus[idx].present = present;
+        }
+    }
+}
+
+static char *
+sim_parse_setting(const char *key, const char *value)
+{
+    char device[64];
+    char subsystem[64];
+    unsigned int address, mask, bits;
+    int number;
+
+    if (!strcmp(key, "tau")) {
+        sim_tau_msec = atoi(value);
+        if (sim_tau_msec <= 0) {
+            return xasprintf("%s: tau must be positive", value);
+        }
+    } else if (!strcmp(key, "max-rpm")) {
+        sim_max_rpm = atoi(value);
+        if (sim_max_rpm <= 0) {
+            return xasprintf("%s: max-rpm must be positive", value);
+        }
+    } else if (!strcmp(key, "seed")) {
+        sim_random = strtoul(value, NULL, 0);
+        if (sim_random == 0) {
+            sim_random = 1;
+        }
+    } else if (!strcmp(key, "latency")) {
+        if (sscanf(value, "%63[^:]:%d", device, &number) != 2
+                || number < 0) {
+            return xasprintf("%s: expected latency=DEVICE:USEC", value);
+        }
+        sim_device_get(device)->latency_usec = number;
+    } else if (!strcmp(key, "nak")) {
+        if (sscanf(value, "%63[^:]:%d", device, &number) != 2
+                || number < 0 || number > 100) {
+            return xasprintf("%s: expected nak=DEVICE:PERCENT", value);
+        }
+        sim_device_get(device)->nak_percent = number;
+    } else if (!strcmp(key, "stuck")) {
+        if (sscanf(value, "%63[^:]:%i:%i:%i", device, &address, &mask,
+                   &bits) != 4) {
+            return xasprintf("%s: expected stuck=DEVICE:REG:MASK:VALUE",
+                             value);
+        }
+        sim_set_stuck(sim_device_get(device), address, mask, bits);
+    } else if (!strcmp(key, "unstuck")) {
+        if (sscanf(value, "%63[^:]:%i", device, &address) != 2) {
+            return xasprintf("%s: expected unstuck=DEVICE:REG", value);
+        }
+        sim_set_stuck(sim_device_get(device), address, 0, 0);
+    } else if (!strcmp(key, "remove") || !strcmp(key, "insert")) {
+        if (sscanf(value, "%63[^:]:%d", subsystem, &number) != 2) {
+            return xasprintf("%s: expected %s=SUBSYSTEM:FRU", value, key);
+        }
+        sim_set_fru_present(subsystem, number, !strcmp(key, "insert"));
+    } else {
+        return xasprintf("%s: unknown hw-sim setting", key);
+    }
+
+    return NULL;
+}
+
+char *
+fand_sim_configure(const char *spec)
+{
+    char *copy = xstrdup(spec);
+    char *save_ptr = NULL;
+    char *error = NULL;
+    char *setting;
+
+    for (setting = strtok_r(copy, ",", &save_ptr); setting != NULL;
+         setting = strtok_r(NULL, ",", &save_ptr)) {
+        char *value = strchr(setting, '=');
+
+        if (value == NULL) {
+            error = xasprintf("%s: expected KEY=VALUE", setting);
+            break;
+        }
+        *value++ = '\0';
+
+        error = sim_parse_setting(setting, value);
+        if (error) {
+            break;
+        }
+    }
+
+    free(copy);
+    return error;
+}
+
+static struct sim_reg *
+sim_reg_get(struct sim_subsystem *subsys, const i2c_bit_op *op)
+{
+    struct sim_reg *reg;
+    char key[128];
+
+    snprintf(key, sizeof(key), "%s:%x", op->device ? op->device : "",
+             (unsigned int)op->register_address);
+    reg = shash_find_data(&subsys->regs, key);
+    if (reg == NULL) {
+        reg = xzalloc(sizeof *reg);
+        reg->device = xstrdup(op->device ? op->device : "");
+        reg->address = op->register_address;
+        shash_add(&subsys->regs, key, reg);
+    }
+
+    return reg;
+}
+
+static struct sim_op *
+sim_op_find(const struct sim_subsystem *subsys, const i2c_bit_op *op)
+{
+    struct sim_op *sop;
+
+    HMAP_FOR_EACH_WITH_HASH (sop, node, hash_pointer(op, 0), &subsys->ops) {
+        if (sop->op == op) {
+            return sop;
+        }
+    }
+
+    return NULL;
+}
+
+static struct sim_op *
+sim_op_add(struct sim_subsystem *subsys, const i2c_bit_op *op,
+           enum sim_role role)
+{
+    struct sim_op *sop;
+
+    if (op == NULL) {
+        return NULL;
+    }
+
+    sop = sim_op_find(subsys, op);
+    if (sop == NULL) {
+        sop = xzalloc(sizeof *sop);
+        sop->op = op;
+        sop->reg = sim_reg_get(subsys, op);
+        hmap_insert(&subsys->ops, &sop->node, hash_pointer(op, 0));
+    }
+    sop->role = role;
+
+    return sop;
+}
+
+/* the speed controls start at the "normal" setting */
+static void
+sim_init_control(struct sim_subsystem *subsys, const i2c_bit_op *op)
+{
+    struct sim_op *sop = sim_op_add(subsys, op, SIM_REG);
+
+    if (sop != NULL) {
+        sop->reg->value = (sop->reg->value & ~op->bit_mask)
+                          | (subsys->info->fan_speed_settings.normal
+                             & op->bit_mask);
+    }
+}
+
+/* build the simulated registers for subsystem "name", whose hardware
+   description has already been parsed */
+static void
+sim_add_subsystem(const char *name)
+{
+    const struct fand_topo *topo;
+    const YamlFanInfo *info;
+    struct sim_subsystem *subsys;
+    char key[128];
+    int fru_count;
+    int fru_idx;
+    int fan_idx;
+    int n_fans;
+
+    topo = fand_topo_find(name);
+    if (!sim_enabled || topo == NULL || topo->info == NULL
+            || topo->n_frus <= 0) {
+        return;
+    }
+    info = topo->info;
+    fru_count = topo->n_frus;
+
+    sim_remove_subsystem(name);
+
+    subsys = xzalloc(sizeof *subsys);
+    subsys->name = xstrdup(name);
+    subsys->info = info;
+    shash_init(&subsys->regs);
+    hmap_init(&subsys->ops);
+
+    n_fans = 0;
+    for (fru_idx = 0; fru_idx < fru_count; fru_idx++) {
+        const YamlFanFru *fru = topo->frus[fru_idx];
+        for (fan_idx = 0; fru->fans[fan_idx] != NULL; fan_idx++) {
+            n_fans++;
+        }
+    }
+    subsys->frus = xcalloc(fru_count, sizeof *subsys->frus);
+    subsys->n_frus = fru_count;
+    subsys->fans = xcalloc(n_fans ? n_fans : 1, sizeof *subsys->fans);
+
+    sim_init_control(subsys, info->fan_speed_control);
+    sim_op_add(subsys, info->fan_led, SIM_REG);
+
+    for (fru_idx = 0; fru_idx < fru_count; fru_idx++) {
+        const YamlFanFru *fru = topo->frus[fru_idx];
+        struct sim_fru *sfru = &subsys->frus[fru_idx];
+        struct sim_op *sop;
+
+        sfru->number = fru->number;
+        snprintf(key, sizeof(key), "%s:%d", name, fru->number);
+        sfru->present = !shash_find(&sim_removed_frus, key);
+
+        sop = sim_op_add(subsys, fru->fan_present, SIM_PRESENT);
+        if (sop != NULL) {
+            sop->fru = sfru;
+        }
+        sim_op_add(subsys, fru->fan_direction_detect, SIM_REG);
+        sim_op_add(subsys, fru->fan_leds, SIM_REG);
+        sim_init_control(subsys, fru->fan_speed_control);
+
+        for (fan_idx = 0; fru->fans[fan_idx] != NULL; fan_idx++) {
+            const YamlFan *fan = fru->fans[fan_idx];
+            struct sim_fan *sfan = &subsys->fans[subsys->n_fans++];
+
+            sfan->name = fan->name;
+            sfan->fru = sfru;
+            sfan->has_msb = fan->fan_speed_msb != NULL;
+            sfan->updated = fand_clock_msec();
+
+            sim_init_control(subsys, fan->fan_speed_control);
+            if (info->fan_speed_control_type == PER_FAN) {
+                sfan->control_op = fan->fan_speed_control;
+            } else if (info->fan_speed_control_type == PER_FRU) {
+                sfan->control_op = fru->fan_speed_control;
+            } else {
+                sfan->control_op = info->fan_speed_control;
+            }
+            if (sfan->control_op != NULL) {
+                sfan->control = sim_op_find(subsys, sfan->control_op)->reg;
+            }
+
+            sop = sim_op_add(subsys, fan->fan_speed, SIM_TACH);
+            if (sop != NULL) {
+                sop->fan = sfan;
+            }
+            sop = sim_op_add(subsys, fan->fan_speed_msb, SIM_TACH_MSB);
+            if (sop != NULL) {
+                sop->fan = sfan;
+            }
+            sim_op_add(subsys, fan->fan_fault, SIM_REG);
+        }
+    }
+
+    shash_add(&sim_subsystems, name, subsys);
+    VLOG_INFO("simulating %d fans in subsystem %s", subsys->n_fans, name);
+}
+
+/* discard the simulated registers of subsystem "name" */
+static void
+sim_remove_subsystem(const char *name)
+{
+    struct sim_subsystem *subsys;
+    struct shash_node *node, *next;
+    struct sim_op *sop;
+
+    if (!sim_enabled) {
+        return;
+    }
+
+    subsys = shash_find_and_delete(&sim_subsystems, name);
+    if (subsys == NULL) {
+        return;
+    }
+
+    HMAP_FOR_EACH_POP (sop, node, &subsys->ops) {
+        free(sop);
+    }
+    hmap_destroy(&subsys->ops);
+    SHASH_FOR_EACH_SAFE (node, next, &subsys->regs) {
+        struct sim_reg *reg = node->data;
+        free(reg->device);
+        free(reg);
+        shash_delete(&subsys->regs, node);
+    }
+    shash_destroy(&subsys->regs);
+    free(subsys->frus);
+    free(subsys->fans);
+    free(subsys->name);
+    free(subsys);
+}
+
+/* the rpm the fan is heading for, given its speed control setting */
+static double
+sim_target_rpm(const struct sim_subsystem *subsys, const struct sim_fan *fan)
+{
+    const YamlFanInfo *info = subsys->info;
+    uint32_t value;
+    double level;
+
+    if (!fan->fru->present) {
+        return 0;
+    }
+
+    if (fan->control == NULL) {
+        value = info->fan_speed_settings.normal;
+    } else {
+        value = fan->control->value & fan->control_op->bit_mask;
+    }
+
+    if (value == info->fan_speed_settings.slow) {
+        level = 1;
+    } else if (value == info->fan_speed_settings.normal) {
+        level = 2;
+    } else if (value == info->fan_speed_settings.medium) {
+        level = 3;
+    } else if (value == info->fan_speed_settings.fast) {
+        level = 4;
+    } else if (value == info->fan_speed_settings.max
+               || info->fan_speed_settings.max == 0) {
+        level = 5;
+    } else {
+        level = 5.0 * value / info->fan_speed_settings.max;
+    }
+
+    return sim_max_rpm * level / 5;
+}
+
+/* advance the fan's first order lag model to now */
+static void
+sim_fan_update(const struct sim_subsystem *subsys, struct sim_fan *fan)
+{
+    long long int now = fand_clock_msec();
+    double target = sim_target_rpm(subsys, fan);
+
+    if (now > fan->updated) {
+        fan->rpm = target + (fan->rpm - target)
+                   * exp(-(double)(now - fan->updated) / sim_tau_msec);
+        fan->updated = now;
+    }
+}
+
+/* the raw tachometer value that ops-fand turns back into "rpm" */
+static uint32_t
+sim_tach_value(const struct sim_subsystem *subsys, const struct sim_fan *fan)
+{
+    const YamlFanInfo *info = subsys->info;
+
+    if (info->fan_speed_multiplier) {
+        return (uint32_t)(fan->rpm / info->fan_speed_multiplier + 0.5);
+    } else if (info->fan_speed_numerator) {
+        return fan->rpm >= 1 ? (uint32_t)(info->fan_speed_numerator
+                                          / fan->rpm) : 0;
+    }
+    return (uint32_t)fan->rpm;
+}
+
+/* look up the subsystem and op, and apply the device's latency and NAK
+   injection. returns 0 if the access should go ahead. */
+static int
+sim_access(const char *subsystem_name, const i2c_bit_op *op,
+           struct sim_subsystem **subsysp, struct sim_op **sopp)
+{
+    const struct sim_device *device;
+    struct sim_subsystem *subsys;
+    struct sim_op *sop;
+
+    subsys = shash_find_data(&sim_subsystems, subsystem_name);
+    if (subsys == NULL || op == NULL) {
+        return -ENODEV;
+    }
+
+    device = sim_device_lookup(op->device ? op->device : "");
+    if (device != NULL) {
+        if (device->latency_usec) {
+            struct timespec delay;
+
+            delay.tv_sec = device->latency_usec / 1000000;
+            delay.tv_nsec = (device->latency_usec % 1000000) * 1000;
+            nanosleep(&delay, NULL);
+        }
+        if (device->nak_percent && sim_rand() % 100 < device->nak_percent) {
+            return -EIO;
+        }
+    }
+
+    sop = sim_op_find(subsys, op);
+    if (sop == NULL) {
+        /* not part of the fan description; treat it as a plain register */
+        sop = sim_op_add(subsys, op, SIM_REG);
+    }
+
+    *subsysp = subsys;
+    *sopp = sop;
+    return 0;
+}
+
+static int
+sim_reg_read(const char *subsystem_name, const i2c_bit_op *op,
+             uint32_t *value)
+{
+    const struct sim_device *device;
+    struct sim_subsystem *subsys;
+    struct sim_op *sop;
+    uint32_t raw;
+    size_t i;
+    int rc;
+
+    rc = sim_access(subsystem_name, op, &subsys, &sop);
+    if (rc) {
+        return rc;
+    }
+
+    switch (sop->role) {
+    case SIM_TACH:
+        sim_fan_update(subsys, sop->fan);
+        raw = MIN(sim_tach_value(subsys, sop->fan),
+                  sop->fan->has_msb ? 0xffff : op->bit_mask);
+        raw = sop->fan->has_msb ? raw & 0xff : raw;
+        break;
+    case SIM_TACH_MSB:
+        sim_fan_update(subsys, sop->fan);
+        raw = (MIN(sim_tach_value(subsys, sop->fan), 0xffff) >> 8) & 0xff;
+        break;
+    case SIM_PRESENT:
+        raw = sop->fru->present ? op->bit_mask : 0;
+        break;
+    case SIM_REG:
+    default:
+        raw = sop->reg->value;
+        break;
+    }
+
+    device = sim_device_lookup(op->device ? op->device : "");
+    for (i = 0; device != NULL && i < device->n_stuck; i++) {
+        if (device->stuck[i].address == op->register_address) {
+            raw = (raw & ~device->stuck[i].mask)
+                  | (device->stuck[i].value & device->stuck[i].mask);
+        }
+    }
+
+    *value = raw & op->bit_mask;
+    return 0;
+}
+
+static int
+sim_reg_write(const char *subsystem_name, const i2c_bit_op *op,
+              uint32_t value)
+{
+    struct sim_subsystem *subsys;
+    struct sim_op *sop;
+    int idx;
+    int rc;
+
+    rc = sim_access(subsystem_name, op, &subsys, &sop);
+    if (rc) {
+        return rc;
+    }
+
+    /* bring the fans up to date before their target changes */
+    for (idx = 0; idx < subsys->n_fans; idx++) {
+        if (subsys->fans[idx].control == sop->reg) {
+            sim_fan_update(subsys, &subsys->fans[idx]);
+        }
+    }
+
+    sop->reg->value = (sop->reg->value & ~op->bit_mask)
+                      | (value & op->bit_mask);
+    return 0;
+}
+
+/* sim backend */
+
+static int
+sim_backend_open(const char *subsystem_name, const char *arg OVS_UNUSED,
+                 struct fand_backend **backendp)
+{
+    struct fand_backend *backend;
+    char *error;
+
+    if (!sim_enabled) {
+        error = fand_sim_enable(NULL);
+        free(error);
+    }
+    sim_add_subsystem(subsystem_name);
+
+    backend = xmalloc(sizeof *backend);
+    fand_backend_init(backend, &fand_sim_backend_class, subsystem_name);
+    *backendp = backend;
+    return 0;
+}
+
+static void
+sim_backend_close(struct fand_backend *backend)
+{
+    sim_remove_subsystem(backend->subsystem_name);
+    fand_backend_uninit(backend);
+    free(backend);
+}
+
+static void
+sim_backend_read(struct fand_backend *backend, struct fand_reg_io ios[],
+                 size_t n)
+{
+    size_t idx;
+
+    for (idx = 0; idx < n; idx++) {
+        ios[idx].value = 0;
+        ios[idx].rc = sim_reg_read(backend->subsystem_name, ios[idx].op,
+                                   &ios[idx].value);
+    }
+}
+
+static void
+sim_backend_write(struct fand_backend *backend, struct fand_reg_io ios[],
+                  size_t n)
+{
+    size_t idx;
+
+    for (idx = 0; idx < n; idx++) {
+        ios[idx].rc = sim_reg_write(backend->subsystem_name, ios[idx].op,
+                                    ios[idx].value);
+    }
+}
+
+const struct fand_backend_class fand_sim_backend_class = {
+    "sim",
+    sim_backend_open,
+    sim_backend_close,
+    sim_backend_read,
+    sim_backend_write,
+    NULL,                       /* dump */
+};
+
+void
+fand_sim_dump(struct ds *ds)
+{
+    const struct shash_node *node;
+    int idx;
+
+    if (!sim_enabled) {
+        return;
+    }
+
+    ds_put_format(ds, "Simulated hardware: tau %d ms, max %d rpm\n",
+                  sim_tau_msec, sim_max_rpm);
+    SHASH_FOR_EACH (node, &sim_devices) {
+        const struct sim_device *device = node->data;
+        ds_put_format(ds, "    Device %s: latency %d us, nak %d%%, "
+                      "%"PRIuSIZE" stuck registers\n", node->name,
+                      device->latency_usec, device->nak_percent,
+                      device->n_stuck);
+    }
+    SHASH_FOR_EACH (node, &sim_removed_frus) {
+        ds_put_format(ds, "    FRU %s removed\n", node->name);
+    }
+    SHASH_FOR_EACH (node, &sim_subsystems) {
+        struct sim_subsystem *subsys = node->data;
+        for (idx = 0; idx < subsys->n_fans; idx++) {
+            struct sim_fan *fan = &subsys->fans[idx];
+            sim_fan_update(subsys, fan);
+            ds_put_format(ds, "    Fan %s-%s: %.0f rpm, target %.0f rpm\n",
+                          subsys->name, fan->name, fan->rpm,
+                          sim_target_rpm(subsys, fan));
+        }
+    }
+}
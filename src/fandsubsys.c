@@ -0,0 +1,477 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for subsystem and fan bookkeeping.
+ ***************************************************************************/
+
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "openvswitch/vlog.h"
+#include "ovs-thread.h"
+#include "timeval.h"
+#include "util.h"
+#include "config-yaml.h"
+#include "eventlog.h"
+#include "fanspeed.h"
+#include "fanstatus.h"
+#include "physfan.h"
+#include "fand-locl.h"
+#include "fandarena.h"
+#include "fandchanges.h"
+#include "fandbackend.h"
+#include "fandckpt.h"
+#include "fandclock.h"
+#include "fandsubsys.h"
+#include "fandtopo.h"
+#include "fandtrace.h"
+
+/* most threads used to take a first sample of several subsystems */
+#define FAND_SAMPLE_THREADS 8
+
+VLOG_DEFINE_THIS_MODULE(fandsubsys);
+
+/* define a shash (string hash) to hold the subsystems (by name) */
+struct shash subsystem_data;
+/* define a shash (string hash) to hold the fans (by name) */
+struct shash fan_data;
+
+/* true while another ops-fand instance controls the fans */
+static bool standby = false;
+
+/* initialize the subsystem data (and the fan data) dictionaries */
+void
+fand_subsystems_init(void)
+{
+    shash_init(&subsystem_data);
+    shash_init(&fan_data);
+}
+
+void
+fand_subsystems_set_standby(bool standby_)
+{
+    struct shash_node *node;
+    bool was_standby = standby;
+
+    standby = standby_;
+    if (!was_standby || standby) {
+        return;
+    }
+
+    /* taking over: apply everything decided while standing by */
+    SHASH_FOR_EACH(node, &subsystem_data) {
+        struct locl_subsystem *subsystem = node->data;
+
+        if (subsystem->valid) {
+            fand_forget_warm(subsystem);
+            fand_set_fanspeed(subsystem);
+            fand_set_fanleds(subsystem);
+        }
+    }
+}
+
+bool
+fand_subsystems_standby(void)
+{
+    return standby;
+}
+
+void
+fand_subsystem_prefetch(const char *dir)
+{
+    struct dirent *entry;
+    DIR *d;
+
+    if (dir == NULL || dir[0] == '\0') {
+        return;
+    }
+
+    d = opendir(dir);
+    if (d == NULL) {
+        return;
+    }
+    while ((entry = readdir(d)) != NULL) {
+        char *path;
+        int fd;
+
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        path = xasprintf("%s/%s", dir, entry->d_name);
+        fd = open(path, O_RDONLY);
+        if (fd >= 0) {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+            close(fd);
+        }
+        free(path);
+    }
+    closedir(d);
+}
+
+struct locl_subsystem *
+fand_subsystem_create(const char *name, const char *dir, const char *override,
+                      const char *backend_type)
+{
+    struct locl_subsystem *result;
+    struct fand_arena *arena;
+    int rc;
+    int total_fans;
+    unsigned int idx;
+    int fan_fru_count;
+    int fan_idx;
+    const YamlFanInfo *fan_info;
+    enum fanspeed override_value = FAND_SPEED_NONE;
+
+    VLOG_DBG("Adding new subsystem %s", name);
+    arena = fand_arena_create();
+    result = fand_arena_alloc(arena, sizeof *result);
+    result->arena = arena;
+    (void)shash_add(&subsystem_data, name, (void *)result);
+    result->name = fand_arena_strdup(arena, name);
+    result->marked = false;
+    result->valid = false;
+    result->parent_subsystem = NULL;  /* OPS_TODO: find parent subsystem */
+    if (override != NULL) {
+        override_value = fan_speed_string_to_enum(override);
+    }
+    result->fan_speed_override = override_value;
+
+    /* OPS_TODO: could check to see if the temp sensors have been populated
+       with data and use that for the sensor speed when initializing the
+       fan_speed value. */
+    result->fan_speed = FAND_SPEED_NORMAL;
+
+    /* use a default if the hw_desc_dir has not been populated */
+    if (dir == NULL || strlen(dir) == 0) {
+        VLOG_ERR("No h/w description directory for subsystem %s", name);
+        return(result);
+    }
+
+    /* since this is a new subsystem, load all of the hardware description
+       information about devices and fans (just for this subsystem) */
+    result->topo = fand_topo_load(name, dir);
+
+    if (result->topo == NULL) {
+        return(result);
+    }
+
+    fan_info = result->topo->info;
+
+    if (fan_info == NULL) {
+        VLOG_INFO("subsystem %s has no fan info", name);
+        return(result);
+    }
+
+    result->multiplier = fan_info->fan_speed_multiplier;
+    result->numerator  = fan_info->fan_speed_numerator;
+
+    /* count the total fans in the subsystem */
+    total_fans = 0;
+
+    fan_fru_count = result->topo->n_frus;
+
+    VLOG_DBG("There are %d fan FRUS in subsystem %s", fan_fru_count, name);
+
+    if (fan_fru_count <= 0) {
+        return(result);
+    }
+
+    rc = fand_backend_open(backend_type, name, &result->backend);
+
+    if (rc != 0) {
+        VLOG_ERR("Unable to open the fan backend for subsystem %s (%s)",
+                 name, ovs_strerror(rc));
+        return(result);
+    }
+
+    result->valid = true;
+    fand_changes_record(FAND_CHANGE_SUBSYSTEM, result->name, "added", NULL);
+
+    /* the fans are allocated together, so count them first */
+    for (idx = 0; idx < fan_fru_count; idx++) {
+        const YamlFanFru *fan_fru = result->topo->frus[idx];
+
+        for (fan_idx = 0; fan_fru->fans[fan_idx] != NULL; fan_idx++) {
+            ++total_fans;
+        }
+    }
+    result->fans = fand_arena_alloc(arena, total_fans * sizeof *result->fans);
+
+    for (idx = 0; idx < fan_fru_count; idx++) {
+        const YamlFanFru *fan_fru = result->topo->frus[idx];
+
+        /* each FanFru has one or more fans */
+        for (fan_idx = 0; fan_fru->fans[fan_idx] != NULL; fan_idx++) {
+            const YamlFan *fan = fan_fru->fans[fan_idx];
+            struct locl_fan *new_fan = &result->fans[result->n_fans++];
+            VLOG_DBG("Adding fan %s in subsystem %s", fan->name, name);
+
+            new_fan->name = fand_arena_asprintf(arena, "%s-%s",
+                                                name, fan->name);
+            new_fan->subsystem = result;
+            new_fan->yaml_fan = fan;
+
+            shash_add(&fan_data, new_fan->name, (void *)new_fan);
+            fand_changes_record(FAND_CHANGE_FAN, new_fan->name, "added",
+                                NULL);
+        }
+    }
+
+    VLOG_DBG("There are %d total fans in subsystem %s", total_fans, name);
+    log_event("FAN_COUNT", EV_KV("count", "%d", total_fans),
+        EV_KV("subsystem", "%s", name));
+
+    fand_prepare_io(result);
+    fand_ckpt_restore(result);
+    fand_set_fanspeed(result);
+
+    return(result);
+}
+
+void
+fand_subsystem_destroy(struct locl_subsystem *subsystem)
+{
+    const struct locl_fan *fan;
+
+    /* also, delete all fans in the subsystem */
+    LOCL_FAN_FOR_EACH(fan, subsystem) {
+        shash_find_and_delete(&fan_data, fan->name);
+        fand_changes_record(FAND_CHANGE_FAN, fan->name, "removed", NULL);
+    }
+    if (subsystem->valid) {
+        fand_changes_record(FAND_CHANGE_SUBSYSTEM, subsystem->name,
+                            "removed", NULL);
+    }
+
+    fand_backend_close(subsystem->backend);
+    /* with the topology goes the subsystem's YAML data */
+    fand_topo_unload(subsystem->name);
+    shash_find_and_delete(&subsystem_data, subsystem->name);
+    /* and with the arena, the subsystem, its fans and register batches */
+    fand_arena_destroy(subsystem->arena);
+
+    /* OPS_TODO: verify that ovsdb has deleted the fans (automatic) */
+}
+
+struct locl_fan *
+fand_subsystem_find_fan(const struct locl_subsystem *subsystem,
+                        const char *name)
+{
+    struct locl_fan *fan = shash_find_data(&fan_data, name);
+
+    return fan != NULL && fan->subsystem == subsystem ? fan : NULL;
+}
+
+/* log each attribute of "fan" that differs from its previous value "old" */
+static void
+fand_record_fan_changes(const struct locl_fan *old, const struct locl_fan *fan)
+{
+    if (old->status != fan->status) {
+        fand_changes_record(FAND_CHANGE_FAN, fan->name, "status",
+                            fan_status_enum_to_string(fan->status));
+    }
+    if (old->rpm != fan->rpm) {
+        fand_changes_record_int(FAND_CHANGE_FAN, fan->name, "rpm", fan->rpm);
+    }
+    if (old->direction == NULL || strcmp(old->direction, fan->direction) != 0) {
+        fand_changes_record(FAND_CHANGE_FAN, fan->name, "direction",
+                            fan->direction);
+    }
+    if (old->speed != fan->speed) {
+        fand_changes_record(FAND_CHANGE_FAN, fan->name, "speed",
+                            fan_speed_enum_to_string(fan->speed));
+    }
+}
+
+/* update "fan" from the registers just read */
+static void
+fand_fan_update(struct locl_subsystem *subsystem, struct locl_fan *fan)
+{
+    struct locl_fan old;
+
+    old = *fan;
+    fan->speed = subsystem->speed;
+    fand_read_fan_status(fan);
+    fan->sample_usec = fand_clock_wall_usec();
+    VLOG_DBG("fan %s rpm set to %d\n", fan->name, fan->rpm);
+    fand_record_fan_changes(&old, fan);
+}
+
+/* a device whose breaker was open has missed speed and led writes, so
+   apply them again once it responds */
+static void
+fand_subsystem_check_recovery(struct locl_subsystem *subsystem)
+{
+    if (subsystem->backend != NULL
+            && subsystem->n_recoveries != subsystem->backend->n_recoveries) {
+        subsystem->n_recoveries = subsystem->backend->n_recoveries;
+        fand_forget_warm(subsystem);
+        fand_set_fanspeed(subsystem);
+        fand_set_fanleds(subsystem);
+    }
+}
+
+/* update the fans of "subsystem" from its sample registers */
+static void
+fand_subsystem_update(struct locl_subsystem *subsystem)
+{
+    struct locl_fan *fan;
+
+    LOCL_FAN_FOR_EACH(fan, subsystem) {
+        fand_fan_update(subsystem, fan);
+    }
+    fand_subsystem_check_recovery(subsystem);
+}
+
+void
+fand_subsystem_sample(struct locl_subsystem *subsystem)
+{
+    fand_read_subsystem(subsystem);
+    fand_subsystem_update(subsystem);
+}
+
+/* reads subsystems[first], subsystems[first + stride], ... */
+struct sample_worker {
+    struct locl_subsystem **subsystems;
+    size_t n;
+    size_t first;
+    size_t stride;
+};
+
+static void *
+sample_worker_main(void *worker_)
+{
+    struct sample_worker *worker = worker_;
+    size_t idx;
+
+    for (idx = worker->first; idx < worker->n; idx += worker->stride) {
+        fand_read_subsystem(worker->subsystems[idx]);
+    }
+    return NULL;
+}
+
+void
+fand_subsystems_sample(struct locl_subsystem *subsystems[], size_t n)
+{
+    struct sample_worker workers[FAND_SAMPLE_THREADS];
+    pthread_t threads[FAND_SAMPLE_THREADS];
+    struct locl_subsystem **parallel;
+    size_t n_parallel = 0;
+    size_t n_threads;
+    size_t idx;
+
+    parallel = xmalloc(n * sizeof *parallel);
+    for (idx = 0; idx < n; idx++) {
+        struct fand_backend *backend = subsystems[idx]->backend;
+
+        /* a capture file is shared by all backends */
+        if (backend != NULL && backend->class->concurrent
+                && !fand_trace_capturing()) {
+            parallel[n_parallel++] = subsystems[idx];
+        } else {
+            fand_read_subsystem(subsystems[idx]);
+        }
+    }
+
+    n_threads = MIN(n_parallel, FAND_SAMPLE_THREADS);
+    for (idx = 0; idx < n_threads; idx++) {
+        workers[idx].subsystems = parallel;
+        workers[idx].n = n_parallel;
+        workers[idx].first = idx;
+        workers[idx].stride = n_threads;
+        threads[idx] = ovs_thread_create("fand_sample", sample_worker_main,
+                                         &workers[idx]);
+    }
+    for (idx = 0; idx < n_threads; idx++) {
+        xpthread_join(threads[idx], NULL);
+    }
+    free(parallel);
+
+    /* the change log and the rest aren't thread safe */
+    for (idx = 0; idx < n; idx++) {
+        fand_subsystem_update(subsystems[idx]);
+    }
+}
+
+bool
+fand_subsystem_run_events(struct locl_subsystem *subsystem)
+{
+    const YamlFanFru *frus[16];
+    struct locl_fan *fan;
+    size_t n_frus;
+    size_t idx;
+
+    if (subsystem->backend == NULL) {
+        return false;
+    }
+
+    n_frus = fand_backend_poll_events(subsystem->backend, frus,
+                                      ARRAY_SIZE(frus));
+    for (idx = 0; idx < n_frus; idx++) {
+        VLOG_DBG("subsystem %s: event on fan fru %d", subsystem->name,
+                 frus[idx]->number);
+        fand_read_fru(subsystem, frus[idx]);
+        LOCL_FAN_FOR_EACH(fan, subsystem) {
+            if (fan->fru == frus[idx]) {
+                fand_fan_update(subsystem, fan);
+            }
+        }
+    }
+
+    fand_subsystem_check_recovery(subsystem);
+    return n_frus > 0;
+}
+
+void
+fand_subsystem_set_speed(struct locl_subsystem *subsystem,
+                         enum fanspeed sensor_speed, const char *override)
+{
+    enum fanspeed override_value;
+    enum fanspeed old_speed;
+
+    /* record that as the current speed by sensor */
+    if (subsystem->fan_speed != sensor_speed) {
+        fand_changes_record(FAND_CHANGE_SUBSYSTEM, subsystem->name,
+                            "sensor_speed",
+                            fan_speed_enum_to_string(sensor_speed));
+    }
+    subsystem->fan_speed = sensor_speed;
+
+    /* but also check to see if we have an override value */
+    override_value = fan_speed_string_to_enum(override);
+    if (subsystem->fan_speed_override != override_value) {
+        subsystem->fan_speed_override = override_value;
+        fand_changes_record(FAND_CHANGE_SUBSYSTEM, subsystem->name,
+                            "override", override);
+    }
+
+    old_speed = subsystem->speed;
+    fand_set_fanspeed(subsystem);
+    if (subsystem->speed != old_speed) {
+        fand_changes_record(FAND_CHANGE_SUBSYSTEM, subsystem->name, "speed",
+                            fan_speed_enum_to_string(subsystem->speed));
+    }
+    fand_set_fanleds(subsystem);
+}
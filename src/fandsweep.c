@@ -0,0 +1,341 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for the fan sweep and publish cycle.
+ ***************************************************************************/
+
+#include <limits.h>
+#include <string.h>
+
+#include "timeval.h"
+#include "util.h"
+#include "fanspeed.h"
+#include "fanstatus.h"
+#include "fand-locl.h"
+#include "fand-probes.h"
+#include "fandckpt.h"
+#include "fandclock.h"
+#include "fandmetrics.h"
+#include "fandshm.h"
+#include "fandsubsys.h"
+#include "fandsweep.h"
+#include "fandtrace.h"
+
+struct fand_stats fand_stats;
+
+/* configuration (fand_sweep_set_*()) */
+static fand_sweep_update_func *update_fans = NULL;
+static int sweep_interval = 5000;
+static int sweep_budget = 0;
+static bool shm_enabled = false;
+static bool ckpt_enabled = false;
+static const char *metrics_file = NULL;
+static int metrics_interval = 5000;
+
+/* when the next full sweep of all fans, and the next metrics file write,
+   are due (fand_clock_msec()) */
+static long long int sweep_next = LLONG_MIN;
+static long long int metrics_next_write = LLONG_MIN;
+
+/* the sweep in progress, which may be spread over several iterations.
+   subsystems whose sweep_seq is "seq" have been sampled in it. */
+static struct {
+    bool active;
+    uint64_t seq;
+    long long int busy_usec;    /* time spent sampling so far */
+    unsigned int n_slices;      /* iterations it has run in so far */
+} sweep;
+
+/* subsystems added that haven't been sampled yet */
+static bool sample_pending = false;
+
+void
+fand_sweep_set_update(fand_sweep_update_func *update)
+{
+    update_fans = update;
+}
+
+void
+fand_sweep_set_interval(int msec)
+{
+    sweep_interval = msec;
+}
+
+void
+fand_sweep_set_budget(int msec)
+{
+    sweep_budget = msec;
+}
+
+int
+fand_sweep_budget(void)
+{
+    return sweep_budget;
+}
+
+void
+fand_sweep_set_publish(bool shm, bool ckpt)
+{
+    shm_enabled = shm;
+    ckpt_enabled = ckpt;
+}
+
+void
+fand_sweep_set_metrics(const char *file, int interval_msec)
+{
+    metrics_file = file;
+    metrics_interval = interval_msec;
+}
+
+void
+fand_sweep_subsystems_added(void)
+{
+    sample_pending = true;
+}
+
+static int
+fand_sweep_update(void)
+{
+    return update_fans != NULL ? update_fans() : 0;
+}
+
+static void
+fand_sweep_start(void)
+{
+    FAND_PROBE1(sweep__start, shash_count(&subsystem_data));
+
+    sweep.active = true;
+    sweep.seq++;
+    sweep.busy_usec = 0;
+    sweep.n_slices = 0;
+}
+
+/* whether the sweep slice that started sampling at "deadline" minus the
+   budget, and has sampled "n_sampled" subsystems, has used up its budget.
+   under the virtual clock, which doesn't move while sampling, each
+   subsystem counts as a msec, so that the slices are the same on every
+   run. */
+static bool
+fand_sweep_over_budget(long long int deadline, int n_sampled)
+{
+    if (fand_clock_is_virtual()) {
+        return sweep_budget > 0 && n_sampled >= sweep_budget;
+    }
+    return time_msec() >= deadline;
+}
+
+/* sample the subsystems that the sweep in progress hasn't reached yet,
+   until the sweep budget runs out. once all have been sampled, publish
+   the results. returns true if the sweep is complete. */
+static bool
+fand_sweep_continue(void)
+{
+    struct shash_node *node;
+    long long int start = time_usec();
+    long long int deadline = LLONG_MAX;
+    long long int elapsed;
+    bool complete = true;
+    int n_sampled = 0;
+    int changes;
+
+    if (sweep_budget > 0) {
+        deadline = time_msec() + sweep_budget;
+    }
+
+    /* take the first sample of new subsystems (e.g. all of them, at
+       startup) together */
+    if (sample_pending) {
+        struct locl_subsystem **new;
+        size_t n_new = 0;
+
+        new = xmalloc(shash_count(&subsystem_data) * sizeof *new);
+        SHASH_FOR_EACH(node, &subsystem_data) {
+            struct locl_subsystem *subsystem = node->data;
+
+            if (subsystem->sweep_seq == 0) {
+                new[n_new++] = subsystem;
+                subsystem->sweep_seq = sweep.seq;
+            }
+        }
+        fand_subsystems_sample(new, n_new);
+        free(new);
+        sample_pending = false;
+    }
+
+    /* read the status of the fans not sampled yet, at least one subsystem
+       per slice */
+    SHASH_FOR_EACH(node, &subsystem_data) {
+        struct locl_subsystem *subsystem = (struct locl_subsystem *)node->data;
+
+        if (subsystem->sweep_seq == sweep.seq) {
+            continue;
+        }
+        if (fand_sweep_over_budget(deadline, n_sampled)) {
+            complete = false;
+            break;
+        }
+        fand_subsystem_sample(subsystem);
+        subsystem->sweep_seq = sweep.seq;
+        n_sampled++;
+    }
+
+    elapsed = time_usec() - start;
+    sweep.busy_usec += elapsed;
+    sweep.n_slices++;
+    if (sweep_budget > 0 && !fand_clock_is_virtual()
+            && elapsed > sweep_budget * 1000LL) {
+        /* a single subsystem took longer than the budget */
+        fand_stats.n_sweep_overruns++;
+    }
+
+    if (!complete) {
+        fand_stats.n_sweep_yields++;
+        return false;
+    }
+
+    /* a standby only keeps its cache warm */
+    changes = fand_subsystems_standby() ? 0 : fand_sweep_update();
+
+    FAND_PROBE2(sweep__end, shash_count(&fan_data), changes);
+
+    sweep.active = false;
+    fand_stats.n_sweeps++;
+    fand_stats.last_sweep_usec = sweep.busy_usec;
+    fand_stats.total_sweep_usec += sweep.busy_usec;
+    fand_stats.last_sweep_slices = sweep.n_slices;
+    return true;
+}
+
+/* rewrite the metrics file, if one is configured and it is due */
+static void
+fand_sweep_metrics_run(void)
+{
+    long long int now;
+
+    if (metrics_file == NULL) {
+        return;
+    }
+
+    now = fand_clock_msec();
+    if (now < metrics_next_write) {
+        return;
+    }
+
+    fand_metrics_write(metrics_file, &subsystem_data, &fand_stats);
+    metrics_next_write = now + metrics_interval;
+}
+
+/* re-read the fans of FRUs whose fault or presence fds have fired.
+   returns true if there were any. */
+static bool
+fand_sweep_run_events(void)
+{
+    struct shash_node *node;
+    bool events = false;
+
+    SHASH_FOR_EACH(node, &subsystem_data) {
+        if (fand_subsystem_run_events(node->data)) {
+            events = true;
+        }
+    }
+    return events;
+}
+
+void
+fand_sweep_run(bool reconfigured)
+{
+    bool events = fand_sweep_run_events();
+    long long int now = fand_clock_msec();
+    bool published = false;
+
+    if (!sweep.active && (reconfigured || now >= sweep_next)) {
+        fand_sweep_start();
+        sweep_next = now + sweep_interval;
+    }
+
+    if (sweep.active) {
+        published = fand_sweep_continue();
+    } else if (events) {
+        if (!fand_subsystems_standby()) {
+            fand_sweep_update();
+        }
+        published = true;
+    }
+
+    if (published) {
+        fand_trace_flush();
+    }
+    if (fand_subsystems_standby()) {
+        /* the segment and the metrics file belong to the active instance */
+        return;
+    }
+    if (published && shm_enabled) {
+        fand_shm_publish(&subsystem_data);
+    }
+    if (published && ckpt_enabled) {
+        fand_ckpt_save(&subsystem_data);
+    }
+    fand_sweep_metrics_run();
+}
+
+void
+fand_sweep_republish(void)
+{
+    if (!sweep.active && sweep.seq > 0) {
+        fand_sweep_update();
+        if (shm_enabled) {
+            fand_shm_publish(&subsystem_data);
+        }
+        if (ckpt_enabled) {
+            fand_ckpt_save(&subsystem_data);
+        }
+    }
+}
+
+void
+fand_sweep_wait(void)
+{
+    /* come straight back to finish a sweep that ran out of budget */
+    fand_clock_timer_wait_until(sweep.active ? fand_clock_msec()
+                                             : sweep_next);
+    if (metrics_file != NULL && !fand_subsystems_standby()) {
+        fand_clock_timer_wait_until(metrics_next_write);
+    }
+}
+
+unsigned int
+fand_fan_row_diff(const struct fand_fan_row *row, const struct locl_fan *fan)
+{
+    unsigned int diff = 0;
+
+    if (strcmp(row->status, fan_status_enum_to_string(fan->status)) != 0) {
+        diff |= FAND_FAN_ROW_STATUS;
+    }
+    if (strcmp(row->speed, fan_speed_enum_to_string(fan->speed)) != 0) {
+        diff |= FAND_FAN_ROW_SPEED;
+    }
+    if (strcmp(row->direction, fan->direction) != 0) {
+        diff |= FAND_FAN_ROW_DIRECTION;
+    }
+    if (row->n_rpm == 0 || row->rpm[0] != fan->rpm) {
+        diff |= FAND_FAN_ROW_RPM;
+    }
+    return diff;
+}
@@ -0,0 +1,911 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for subsystem fan topologies and their binary cache.
+ *
+ * A cache file is a struct topo_cache_header followed by copies of the
+ * config-yaml structures (only the fields ops-fand uses) and strings. The
+ * pointers in them are file offsets (0 for NULL), and the header points to
+ * a table of the offsets of all pointers, which are turned back into
+ * addresses in a private mapping of the file.
+ ***************************************************************************/
+
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hash.h"
+#include "hmap.h"
+#include "shash.h"
+#include "timeval.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "fandtopo.h"
+
+VLOG_DEFINE_THIS_MODULE(fandtopo);
+
+#define TOPO_CACHE_MAGIC        "FANDTOP"
+#define TOPO_CACHE_VERSION      1
+#define TOPO_CACHE_BYTE_ORDER   0x01020304
+
+struct topo_cache_header {
+    char magic[8];              /* TOPO_CACHE_MAGIC */
+    uint32_t version;           /* TOPO_CACHE_VERSION */
+    uint32_t byte_order;        /* TOPO_CACHE_BYTE_ORDER */
+    uint32_t ptr_size;          /* sizeof(void *) */
+    uint32_t n_frus;
+    uint64_t key;               /* topo_dir_key() of the hw_desc_dir */
+    uint64_t size;              /* of the file */
+    uint64_t parse_usec;        /* time the YAML took to parse */
+    uint64_t info;              /* YamlFanInfo, or 0 */
+    uint64_t frus;              /* array of n_frus YamlFanFru pointers */
+    uint64_t relocs;            /* array of n_relocs uint64_t offsets of */
+    uint64_t n_relocs;          /* ...pointers */
+};
+
+struct topo {
+    struct fand_topo up;
+    char *name;
+    bool devices_parsed;        /* yaml_parse_devices() done */
+    struct shash devices;       /* device names the fan bit ops use */
+    long long int load_usec;    /* time fand_topo_load() took */
+    long long int devices_usec; /* time yaml_parse_devices() took */
+    off_t devices_size;         /* of the devices file, if it exists */
+    void *map;                  /* cache file mapping, or NULL */
+    size_t map_size;
+};
+
+/* struct topo, by subsystem name */
+static struct shash topos = SHASH_INITIALIZER(&topos);
+
+static char *cache_dir = NULL;
+#ifdef HAVE_TOPO_BUILTINS
+static uint64_t n_builtin;
+#endif
+static uint64_t n_hits;
+static uint64_t n_misses;
+static long long int saved_usec;
+
+void
+fand_topo_set_cache_dir(const char *dir)
+{
+    free(cache_dir);
+    cache_dir = dir ? xstrdup(dir) : NULL;
+}
+
+/* hash the name, size and contents of each file in "dir", in name order,
+   but not the path of "dir" or the files' times, so that directories with
+   identical files share a key. returns false if "dir" can't be read. */
+static bool
+topo_dir_key(const char *dir, uint64_t *keyp)
+{
+    struct dirent **entries;
+    uint32_t h1 = 0;
+    uint32_t h2 = 1;
+    bool ok = true;
+    int n;
+    int idx;
+
+    n = scandir(dir, &entries, NULL, alphasort);
+    if (n < 0) {
+        return false;
+    }
+    for (idx = 0; idx < n; idx++) {
+        const char *name = entries[idx]->d_name;
+        struct stat st;
+        char *path;
+        char *data;
+        int fd;
+
+        if (name[0] == '.' || !ok) {
+            free(entries[idx]);
+            continue;
+        }
+        path = xasprintf("%s/%s", dir, name);
+        fd = open(path, O_RDONLY);
+        free(path);
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            ok = false;
+        } else if (S_ISREG(st.st_mode)) {
+            data = xmalloc(st.st_size + 1);
+            if (read(fd, data, st.st_size + 1) != st.st_size) {
+                ok = false;
+            }
+            h1 = hash_string(name, h1);
+            h2 = hash_string(name, h2);
+            h1 = hash_bytes(&st.st_size, sizeof st.st_size, h1);
+            h2 = hash_bytes(&st.st_size, sizeof st.st_size, h2);
+            h1 = hash_bytes(data, st.st_size, h1);
+            h2 = hash_bytes(data, st.st_size, h2);
+            free(data);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        free(entries[idx]);
+    }
+    free(entries);
+
+    *keyp = ((uint64_t)h1 << 32) | h2;
+    return ok;
+}
+
+#ifdef HAVE_TOPO_BUILTINS
+/* the built-in topology generated from the fans.yaml in "dir", if any */
+static const struct fand_topo_builtin *
+topo_builtin_find(const char *dir)
+{
+    const struct fand_topo_builtin *builtin = NULL;
+    struct stat st;
+    uint64_t hash;
+    char *path;
+    char *data;
+    size_t idx;
+    int fd;
+
+    path = xasprintf("%s/fans.yaml", dir);
+    fd = open(path, O_RDONLY);
+    free(path);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+    for (idx = 0; idx < fand_topo_n_builtins; idx++) {
+        if (fand_topo_builtins[idx].fans_size == st.st_size) {
+            break;
+        }
+    }
+    if (idx >= fand_topo_n_builtins) {
+        close(fd);
+        return NULL;
+    }
+
+    data = xmalloc(st.st_size + 1);
+    if (read(fd, data, st.st_size + 1) == st.st_size) {
+        /* FNV-1a, as computed by fand-gen-topo.py */
+        hash = UINT64_C(0xcbf29ce484222325);
+        for (idx = 0; idx < st.st_size; idx++) {
+            hash = (hash ^ (uint8_t)data[idx]) * UINT64_C(0x100000001b3);
+        }
+        for (idx = 0; idx < fand_topo_n_builtins; idx++) {
+            if (fand_topo_builtins[idx].fans_size == st.st_size
+                    && fand_topo_builtins[idx].fans_hash == hash) {
+                builtin = &fand_topo_builtins[idx];
+                break;
+            }
+        }
+    }
+    free(data);
+    close(fd);
+    return builtin;
+}
+#endif
+
+/* the cache file for descriptions with "key" */
+static char *
+topo_cache_path(uint64_t key)
+{
+    return xasprintf("%s/topo-%016"PRIx64".bin", cache_dir, key);
+}
+
+/* whether the "len" bytes at "p" lie within the mapping of "size" bytes at
+   "map" ("p" may be NULL) */
+static bool
+topo_cache_fits(const char *map, size_t size, const void *p, size_t len)
+{
+    const char *c = p;
+
+    return (c == NULL
+            || (c >= map && len <= size && c - map <= size - len));
+}
+
+static bool
+topo_cache_string_ok(const char *map, size_t size, const char *s)
+{
+    return (s == NULL
+            || (topo_cache_fits(map, size, s, 1)
+                && memchr(s, '\0', map + size - s) != NULL));
+}
+
+static bool
+topo_cache_op_ok(const char *map, size_t size, const i2c_bit_op *op)
+{
+    return (op == NULL
+            || (topo_cache_fits(map, size, op, sizeof *op)
+                && topo_cache_string_ok(map, size, op->device)));
+}
+
+static bool
+topo_cache_fan_ok(const char *map, size_t size, const YamlFan *fan)
+{
+    return (fan != NULL
+            && topo_cache_fits(map, size, fan, sizeof *fan)
+            && topo_cache_string_ok(map, size, fan->name)
+            && topo_cache_op_ok(map, size, fan->fan_speed)
+            && topo_cache_op_ok(map, size, fan->fan_speed_msb)
+            && topo_cache_op_ok(map, size, fan->fan_fault)
+            && topo_cache_op_ok(map, size, fan->fan_speed_control));
+}
+
+static bool
+topo_cache_fru_ok(const char *map, size_t size, const YamlFanFru *fru)
+{
+    size_t idx;
+
+    if (fru == NULL
+            || !topo_cache_fits(map, size, fru, sizeof *fru)
+            || !topo_cache_op_ok(map, size, fru->fan_leds)
+            || !topo_cache_op_ok(map, size, fru->fan_present)
+            || !topo_cache_op_ok(map, size, fru->fan_direction_detect)
+            || !topo_cache_op_ok(map, size, fru->fan_speed_control)
+            || fru->fans == NULL) {
+        return false;
+    }
+    /* NULL terminated, within the file */
+    for (idx = 0; ; idx++) {
+        if (!topo_cache_fits(map, size, &fru->fans[idx],
+                             sizeof fru->fans[idx])) {
+            return false;
+        }
+        if (fru->fans[idx] == NULL) {
+            return true;
+        }
+        if (!topo_cache_fan_ok(map, size, fru->fans[idx])) {
+            return false;
+        }
+    }
+}
+
+/* check that every object of the relocated topology in "map" lies within
+   it, so that a corrupt or foreign file can't send the fan code outside
+   the mapping */
+static bool
+topo_cache_valid(const char *map, size_t size,
+                 const struct topo_cache_header *hdr)
+{
+    const YamlFanFru *const *frus = (const void *)(map + hdr->frus);
+    const YamlFanInfo *info = NULL;
+    uint32_t idx;
+
+    if (hdr->info) {
+        info = (const YamlFanInfo *)(map + hdr->info);
+    }
+    if (info != NULL
+            && (!topo_cache_fits(map, size, info, sizeof *info)
+                || !topo_cache_op_ok(map, size, info->fan_speed_control)
+                || !topo_cache_op_ok(map, size, info->fan_led))) {
+        return false;
+    }
+    for (idx = 0; idx < hdr->n_frus; idx++) {
+        if (!topo_cache_fru_ok(map, size, frus[idx])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* map cache file "path" into "topo", if it has the right "key" and
+   holds a well-formed topology. */
+static bool
+topo_cache_load(struct topo *topo, const char *path, uint64_t key,
+                long long int *parse_usecp)
+{
+    const struct topo_cache_header *hdr;
+    const uint64_t *relocs;
+    struct stat st;
+    char *map;
+    uint64_t idx;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size < sizeof *hdr) {
+        close(fd);
+        return false;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+
+    hdr = (const struct topo_cache_header *)map;
+    if (memcmp(hdr->magic, TOPO_CACHE_MAGIC, sizeof hdr->magic)
+            || hdr->version != TOPO_CACHE_VERSION
+            || hdr->byte_order != TOPO_CACHE_BYTE_ORDER
+            || hdr->ptr_size != sizeof(void *)
+            || hdr->size != st.st_size
+            || hdr->key != key
+            || hdr->info >= hdr->size
+            || hdr->frus >= hdr->size
+            || hdr->n_frus > (hdr->size - hdr->frus) / sizeof(void *)
+            || hdr->relocs > hdr->size
+            || hdr->n_relocs > (hdr->size - hdr->relocs) / sizeof *relocs) {
+        VLOG_DBG("%s is out of date or not a topology cache", path);
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    relocs = (const uint64_t *)(map + hdr->relocs);
+    for (idx = 0; idx < hdr->n_relocs; idx++) {
+        uintptr_t value;
+
+        if (relocs[idx] > hdr->size - sizeof value) {
+            munmap(map, st.st_size);
+            return false;
+        }
+        memcpy(&value, map + relocs[idx], sizeof value);
+        if (value >= hdr->size) {
+            munmap(map, st.st_size);
+            return false;
+        }
+        value = (uintptr_t)map + value;
+        memcpy(map + relocs[idx], &value, sizeof value);
+    }
+    if (!topo_cache_valid(map, st.st_size, hdr)) {
+        VLOG_WARN("%s is corrupt, ignoring it", path);
+        munmap(map, st.st_size);
+        return false;
+    }
+    mprotect(map, st.st_size, PROT_READ);
+
+    topo->map = map;
+    topo->map_size = st.st_size;
+    topo->up.info = hdr->info ? (const YamlFanInfo *)(map + hdr->info) : NULL;
+    topo->up.frus = (const YamlFanFru **)(map + hdr->frus);
+    topo->up.n_frus = hdr->n_frus;
+    topo->up.source = FAND_TOPO_CACHE;
+    *parse_usecp = hdr->parse_usec;
+    return true;
+}
+
+/* a cache file being built. objects are added at offsets into "data". */
+struct topo_buf {
+    char *data;
+    size_t size;
+    size_t allocated;
+    uint64_t *relocs;           /* offsets of pointer fields */
+    size_t n_relocs;
+    size_t allocated_relocs;
+    struct hmap ops;            /* struct topo_buf_op */
+};
+
+/* an i2c_bit_op already in the buffer, so that ops shared in the parsed
+   topology stay shared in the cache */
+struct topo_buf_op {
+    struct hmap_node node;
+    const i2c_bit_op *op;
+    size_t ofs;
+};
+
+/* add "size" zeroed bytes, 8-byte aligned, and return their offset */
+static size_t
+topo_buf_alloc(struct topo_buf *buf, size_t size)
+{
+    size_t ofs = ROUND_UP(buf->size, 8);
+
+    if (ofs + size > buf->allocated) {
+        buf->allocated = MAX(buf->allocated * 2, ofs + size);
+        buf->data = xrealloc(buf->data, buf->allocated);
+    }
+    memset(buf->data + buf->size, 0, ofs + size - buf->size);
+    buf->size = ofs + size;
+    return ofs;
+}
+
+/* make the pointer at "field" point to the object at "target" (0 leaves
+   it NULL) */
+static void
+topo_buf_ptr(struct topo_buf *buf, size_t field, size_t target)
+{
+    uintptr_t value = target;
+
+    if (target == 0) {
+        return;
+    }
+    memcpy(buf->data + field, &value, sizeof value);
+    if (buf->n_relocs >= buf->allocated_relocs) {
+        buf->relocs = x2nrealloc(buf->relocs, &buf->allocated_relocs,
+                                 sizeof *buf->relocs);
+    }
+    buf->relocs[buf->n_relocs++] = field;
+}
+
+static size_t
+topo_put_string(struct topo_buf *buf, const char *s)
+{
+    size_t ofs;
+
+    if (s == NULL) {
+        return 0;
+    }
+    ofs = topo_buf_alloc(buf, strlen(s) + 1);
+    strcpy(buf->data + ofs, s);
+    return ofs;
+}
+
+static size_t
+topo_put_op(struct topo_buf *buf, const i2c_bit_op *op)
+{
+    struct topo_buf_op *bop;
+    i2c_bit_op *copy;
+    uint32_t hash;
+    size_t device;
+    size_t ofs;
+
+    if (op == NULL) {
+        return 0;
+    }
+    hash = hash_pointer(op, 0);
+    HMAP_FOR_EACH_WITH_HASH (bop, node, hash, &buf->ops) {
+        if (bop->op == op) {
+            return bop->ofs;
+        }
+    }
+
+    device = topo_put_string(buf, op->device);
+    ofs = topo_buf_alloc(buf, sizeof *copy);
+    copy = (i2c_bit_op *)(buf->data + ofs);
+    copy->register_address = op->register_address;
+    copy->size = op->size;
+    copy->bit_mask = op->bit_mask;
+    copy->negative_polarity = op->negative_polarity;
+    topo_buf_ptr(buf, ofs + offsetof(i2c_bit_op, device), device);
+
+    bop = xmalloc(sizeof *bop);
+    bop->op = op;
+    bop->ofs = ofs;
+    hmap_insert(&buf->ops, &bop->node, hash);
+    return ofs;
+}
+
+static size_t
+topo_put_fan(struct topo_buf *buf, const YamlFan *fan)
+{
+    size_t name = topo_put_string(buf, fan->name);
+    size_t speed = topo_put_op(buf, fan->fan_speed);
+    size_t speed_msb = topo_put_op(buf, fan->fan_speed_msb);
+    size_t fault = topo_put_op(buf, fan->fan_fault);
+    size_t control = topo_put_op(buf, fan->fan_speed_control);
+    size_t ofs = topo_buf_alloc(buf, sizeof(YamlFan));
+
+    topo_buf_ptr(buf, ofs + offsetof(YamlFan, name), name);
+    topo_buf_ptr(buf, ofs + offsetof(YamlFan, fan_speed), speed);
+    topo_buf_ptr(buf, ofs + offsetof(YamlFan, fan_speed_msb), speed_msb);
+    topo_buf_ptr(buf, ofs + offsetof(YamlFan, fan_fault), fault);
+    topo_buf_ptr(buf, ofs + offsetof(YamlFan, fan_speed_control), control);
+    return ofs;
+}
+
+static size_t
+topo_put_fru(struct topo_buf *buf, const YamlFanFru *fru)
+{
+    size_t leds = topo_put_op(buf, fru->fan_leds);
+    size_t present = topo_put_op(buf, fru->fan_present);
+    size_t direction = topo_put_op(buf, fru->fan_direction_detect);
+    size_t control = topo_put_op(buf, fru->fan_speed_control);
+    size_t n_fans;
+    size_t fans;
+    size_t ofs;
+    size_t idx;
+
+    for (n_fans = 0; fru->fans[n_fans] != NULL; n_fans++) {
+        continue;
+    }
+    /* NULL terminated, like the parsed array */
+    fans = topo_buf_alloc(buf, (n_fans + 1) * sizeof(YamlFan *));
+    for (idx = 0; idx < n_fans; idx++) {
+        size_t fan = topo_put_fan(buf, fru->fans[idx]);
+
+        topo_buf_ptr(buf, fans + idx * sizeof(YamlFan *), fan);
+    }
+
+    ofs = topo_buf_alloc(buf, sizeof(YamlFanFru));
+    ((YamlFanFru *)(buf->data + ofs))->number = fru->number;
+    topo_buf_ptr(buf, ofs + offsetof(YamlFanFru, fans), fans);
+    topo_buf_ptr(buf, ofs + offsetof(YamlFanFru, fan_leds), leds);
+    topo_buf_ptr(buf, ofs + offsetof(YamlFanFru, fan_present), present);
+    topo_buf_ptr(buf, ofs + offsetof(YamlFanFru, fan_direction_detect),
+                 direction);
+    topo_buf_ptr(buf, ofs + offsetof(YamlFanFru, fan_speed_control), control);
+    return ofs;
+}
+
+static size_t
+topo_put_info(struct topo_buf *buf, const YamlFanInfo *info)
+{
+    size_t control = topo_put_op(buf, info->fan_speed_control);
+    size_t led = topo_put_op(buf, info->fan_led);
+    size_t ofs = topo_buf_alloc(buf, sizeof *info);
+    YamlFanInfo *copy = (YamlFanInfo *)(buf->data + ofs);
+
+    copy->number_fan_frus = info->number_fan_frus;
+    copy->fan_speed_multiplier = info->fan_speed_multiplier;
+    copy->fan_speed_numerator = info->fan_speed_numerator;
+    copy->fan_speed_control_type = info->fan_speed_control_type;
+    copy->fan_speed_settings = info->fan_speed_settings;
+    copy->direction_values = info->direction_values;
+    copy->fan_led_values = info->fan_led_values;
+    topo_buf_ptr(buf, ofs + offsetof(YamlFanInfo, fan_speed_control), control);
+    topo_buf_ptr(buf, ofs + offsetof(YamlFanInfo, fan_led), led);
+    return ofs;
+}
+
+/* write the parsed topology of "topo" to cache file "path" */
+static void
+topo_cache_write(const struct topo *topo, const char *path, uint64_t key,
+                 long long int parse_usec)
+{
+    struct topo_cache_header hdr;
+    struct topo_buf buf;
+    struct topo_buf_op *bop, *next;
+    size_t header;
+    size_t frus;
+    size_t idx;
+    char *tmp;
+    FILE *f;
+
+    memset(&buf, 0, sizeof buf);
+    hmap_init(&buf.ops);
+
+    memset(&hdr, 0, sizeof hdr);
+    header = topo_buf_alloc(&buf, sizeof hdr);
+    ovs_assert(header == 0);
+    if (topo->up.info != NULL) {
+        hdr.info = topo_put_info(&buf, topo->up.info);
+    }
+    frus = topo_buf_alloc(&buf, topo->up.n_frus * sizeof(YamlFanFru *));
+    for (idx = 0; idx < topo->up.n_frus; idx++) {
+        size_t fru = topo_put_fru(&buf, topo->up.frus[idx]);
+
+        topo_buf_ptr(&buf, frus + idx * sizeof(YamlFanFru *), fru);
+    }
+    hdr.relocs = topo_buf_alloc(&buf, buf.n_relocs * sizeof *buf.relocs);
+    memcpy(buf.data + hdr.relocs, buf.relocs,
+           buf.n_relocs * sizeof *buf.relocs);
+
+    memcpy(hdr.magic, TOPO_CACHE_MAGIC, sizeof hdr.magic);
+    hdr.version = TOPO_CACHE_VERSION;
+    hdr.byte_order = TOPO_CACHE_BYTE_ORDER;
+    hdr.ptr_size = sizeof(void *);
+    hdr.n_frus = topo->up.n_frus;
+    hdr.key = key;
+    hdr.size = buf.size;
+    hdr.parse_usec = parse_usec;
+    hdr.frus = frus;
+    hdr.n_relocs = buf.n_relocs;
+    memcpy(buf.data, &hdr, sizeof hdr);
+
+    /* write it whole, then rename it into place */
+    tmp = xasprintf("%s.%d.tmp", path, (int) getpid());
+    f = fopen(tmp, "w");
+    if (f == NULL
+            || fwrite(buf.data, buf.size, 1, f) != 1
+            || fclose(f) != 0
+            || rename(tmp, path) != 0) {
+        static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
+
+        VLOG_WARN_RL(&rl, "unable to write topology cache %s (%s)",
+                     path, ovs_strerror(errno));
+        unlink(tmp);
+    }
+    free(tmp);
+
+    HMAP_FOR_EACH_SAFE (bop, next, node, &buf.ops) {
+        hmap_remove(&buf.ops, &bop->node);
+        free(bop);
+    }
+    hmap_destroy(&buf.ops);
+    free(buf.relocs);
+    free(buf.data);
+}
+
+/* parse the fans YAML of subsystem "name" into "topo". the devices are
+   left for fand_topo_need_devices(). */
+static bool
+topo_parse(struct topo *topo, const char *name, const char *dir)
+{
+    const YamlFanFru **frus;
+    int fru_count;
+    int idx;
+    int rc;
+
+    rc = yaml_parse_fans(topo->up.yaml, name);
+
+    if (rc != 0) {
+        VLOG_ERR("Unable to parse subsystem %s fan file (in %s)",
+                 name, dir);
+        return false;
+    }
+
+    topo->up.info = yaml_get_fan_info(topo->up.yaml, name);
+    fru_count = yaml_get_fan_fru_count(topo->up.yaml, name);
+    if (topo->up.info == NULL || fru_count < 0) {
+        fru_count = 0;
+    }
+    frus = xcalloc(MAX(fru_count, 1), sizeof *frus);
+    for (idx = 0; idx < fru_count; idx++) {
+        frus[idx] = yaml_get_fan_fru(topo->up.yaml, name, idx);
+    }
+    topo->up.frus = frus;
+    topo->up.n_frus = fru_count;
+    topo->up.source = FAND_TOPO_YAML;
+    return true;
+}
+
+static void
+topo_add_device(struct topo *topo, const i2c_bit_op *op)
+{
+    if (op != NULL && op->device != NULL) {
+        shash_add_once(&topo->devices, op->device, NULL);
+    }
+}
+
+/* note the devices that the fans of "topo" use and what loading it cost */
+static void
+topo_loaded(struct topo *topo, const char *dir, long long int start)
+{
+    const YamlFanInfo *info = topo->up.info;
+    struct stat st;
+    char *path;
+    int fan_idx;
+    int idx;
+
+    topo->load_usec = time_usec() - start;
+
+    if (info != NULL) {
+        topo_add_device(topo, info->fan_speed_control);
+        topo_add_device(topo, info->fan_led);
+    }
+    for (idx = 0; idx < topo->up.n_frus; idx++) {
+        const YamlFanFru *fru = topo->up.frus[idx];
+
+        topo_add_device(topo, fru->fan_leds);
+        topo_add_device(topo, fru->fan_present);
+        topo_add_device(topo, fru->fan_direction_detect);
+        topo_add_device(topo, fru->fan_speed_control);
+        for (fan_idx = 0; fru->fans[fan_idx] != NULL; fan_idx++) {
+            const YamlFan *fan = fru->fans[fan_idx];
+
+            topo_add_device(topo, fan->fan_speed);
+            topo_add_device(topo, fan->fan_speed_msb);
+            topo_add_device(topo, fan->fan_fault);
+            topo_add_device(topo, fan->fan_speed_control);
+        }
+    }
+
+    path = xasprintf("%s/devices.yaml", dir);
+    topo->devices_size = stat(path, &st) == 0 ? st.st_size : 0;
+    free(path);
+
+    shash_add(&topos, topo->name, topo);
+}
+
+static void
+topo_free(struct topo *topo)
+{
+    shash_destroy(&topo->devices);
+    if (topo->map != NULL) {
+        munmap(topo->map, topo->map_size);
+    } else if (topo->up.source == FAND_TOPO_YAML) {
+        free(topo->up.frus);
+    }
+    yaml_free_config_handle(topo->up.yaml);
+    free(topo->name);
+    free(topo);
+}
+
+const struct fand_topo *
+fand_topo_load(const char *name, const char *dir)
+{
+    struct topo *topo;
+    long long int start = time_usec();
+    long long int parse_usec;
+    YamlConfigHandle yaml;
+    char *path = NULL;
+    uint64_t key;
+    int rc;
+
+    fand_topo_unload(name);
+
+    /* each subsystem has a handle of its own, so that all it parsed can be
+       freed when it goes away */
+    yaml = yaml_new_config_handle();
+    rc = yaml_add_subsystem(yaml, name, dir);
+
+    if (rc != 0) {
+        VLOG_ERR("Error getting h/w description information for subsystem %s",
+                 name);
+        yaml_free_config_handle(yaml);
+        return NULL;
+    }
+
+    topo = xzalloc(sizeof *topo);
+    topo->up.yaml = yaml;
+    topo->name = xstrdup(name);
+    shash_init(&topo->devices);
+
+#ifdef HAVE_TOPO_BUILTINS
+    {
+        const struct fand_topo_builtin *builtin = topo_builtin_find(dir);
+
+        if (builtin != NULL) {
+            n_builtin++;
+            topo->up.info = builtin->info;
+            topo->up.frus = (const YamlFanFru **)builtin->frus;
+            topo->up.n_frus = builtin->n_frus;
+            topo->up.source = FAND_TOPO_BUILTIN;
+            VLOG_INFO("subsystem %s: using built-in fan topology %s",
+                      name, builtin->platform);
+            topo_loaded(topo, dir, start);
+            return &topo->up;
+        }
+    }
+#endif
+
+    if (cache_dir != NULL && topo_dir_key(dir, &key)) {
+        path = topo_cache_path(key);
+        if (topo_cache_load(topo, path, key, &parse_usec)) {
+            long long int load_usec = time_usec() - start;
+
+            n_hits++;
+            saved_usec += MAX(parse_usec - load_usec, 0);
+            VLOG_INFO("subsystem %s: fan topology loaded from cache in "
+                      "%lld us (parsing took %lld us)", name, load_usec,
+                      parse_usec);
+            free(path);
+            topo_loaded(topo, dir, start);
+            return &topo->up;
+        }
+        n_misses++;
+    }
+
+    start = time_usec();
+    if (!topo_parse(topo, name, dir)) {
+        free(path);
+        topo_free(topo);
+        return NULL;
+    }
+    if (path != NULL) {
+        topo_cache_write(topo, path, key, time_usec() - start);
+        free(path);
+    }
+
+    topo_loaded(topo, dir, start);
+    return &topo->up;
+}
+
+const struct fand_topo *
+fand_topo_find(const char *name)
+{
+    struct topo *topo = shash_find_data(&topos, name);
+
+    return topo ? &topo->up : NULL;
+}
+
+void
+fand_topo_unload(const char *name)
+{
+    struct topo *topo = shash_find_and_delete(&topos, name);
+
+    if (topo != NULL) {
+        topo_free(topo);
+    }
+}
+
+int
+fand_topo_need_devices(const char *name)
+{
+    struct topo *topo = shash_find_data(&topos, name);
+    long long int start = time_usec();
+    struct shash_node *node;
+    int rc;
+
+    if (topo == NULL || topo->devices_parsed) {
+        return 0;
+    }
+    rc = yaml_parse_devices(topo->up.yaml, name);
+    if (rc != 0) {
+        VLOG_ERR("Unable to parse subsystem %s devices file", name);
+        return rc;
+    }
+    topo->devices_parsed = true;
+    topo->devices_usec = time_usec() - start;
+
+    /* resolve the devices the fans use now, rather than failing on each
+       access to them */
+    SHASH_FOR_EACH (node, &topo->devices) {
+        node->data = CONST_CAST(YamlDevice *,
+                                yaml_find_device(topo->up.yaml, name,
+                                                 node->name));
+        if (node->data == NULL) {
+            VLOG_WARN("subsystem %s: fan device %s is not in the devices "
+                      "file", name, node->name);
+        }
+    }
+    return 0;
+}
+
+void
+fand_topo_dump(struct ds *ds)
+{
+    static const char *sources[] = {
+        [FAND_TOPO_YAML] = "parsed",
+        [FAND_TOPO_CACHE] = "cached",
+        [FAND_TOPO_BUILTIN] = "built-in",
+    };
+    long long int skipped_size = 0;
+    struct shash_node *node;
+    int n_skipped = 0;
+#ifdef HAVE_TOPO_BUILTINS
+    size_t idx;
+
+    ds_put_format(ds, "Built-in fan topologies:");
+    for (idx = 0; idx < fand_topo_n_builtins; idx++) {
+        ds_put_format(ds, " %s", fand_topo_builtins[idx].platform);
+    }
+    ds_put_format(ds, "\n    Used: %"PRIu64"\n", n_builtin);
+#endif
+    if (cache_dir != NULL) {
+        ds_put_format(ds, "Hardware description cache: %s\n", cache_dir);
+        ds_put_format(ds, "    Hits: %"PRIu64", misses: %"PRIu64", "
+                      "parse time saved: %lld us\n",
+                      n_hits, n_misses, saved_usec);
+    }
+
+    if (shash_is_empty(&topos)) {
+        return;
+    }
+    ds_put_format(ds, "Fan topologies:\n");
+    SHASH_FOR_EACH (node, &topos) {
+        const struct topo *topo = node->data;
+
+        ds_put_format(ds, "    %s: %s (%lld us), %d FRUs, %"PRIuSIZE
+                      " devices used, ", topo->name,
+                      sources[topo->up.source], topo->load_usec,
+                      topo->up.n_frus, shash_count(&topo->devices));
+        if (topo->devices_parsed) {
+            ds_put_format(ds, "devices parsed in %lld us\n",
+                          topo->devices_usec);
+        } else {
+            ds_put_format(ds, "devices not loaded (%lld bytes)\n",
+                          (long long int)topo->devices_size);
+            skipped_size += topo->devices_size;
+            n_skipped++;
+        }
+    }
+    ds_put_format(ds, "    Devices not loaded for %d of %"PRIuSIZE
+                  " subsystems (%lld bytes)\n",
+                  n_skipped, shash_count(&topos), skipped_size);
+}
@@ -0,0 +1,514 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Source file for capture and replay of hardware register traffic.
+ ***************************************************************************/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "shash.h"
+#include "timeval.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "fandbackend.h"
+#include "fandtrace.h"
+
+VLOG_DEFINE_THIS_MODULE(fandtrace);
+
+/* how far ahead of the cursor replay looks for a matching access */
+#define FAND_TRACE_REPLAY_WINDOW    1024
+
+/* capture state */
+static FILE *capture_file = NULL;
+static char *capture_path = NULL;
+static struct shash capture_ids;        /* string id + 1, by string */
+static uint16_t capture_next_id = 0;
+static uint64_t capture_records = 0;
+
+/* replay state */
+static bool replay_enabled = false;
+static char *replay_path = NULL;
+static bool replay_max_speed = false;
+static struct fand_trace_access *replay_records = NULL;
+static size_t replay_n = 0;
+static size_t replay_pos = 0;
+static struct shash replay_ids;         /* string id + 1, by string */
+static long long int replay_start_nsec = 0;
+static uint64_t replay_skipped = 0;
+static uint64_t replay_mismatches = 0;
+static uint64_t replay_misses = 0;
+
+long long int
+fand_trace_nsec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+bool
+fand_trace_capturing(void)
+{
+    return capture_file != NULL;
+}
+
+bool
+fand_trace_replaying(void)
+{
+    return replay_enabled;
+}
+
+int
+fand_trace_capture_open(const char *path)
+{
+    struct fand_trace_header hdr;
+    int error;
+
+    capture_file = fopen(path, "wb");
+    if (capture_file == NULL) {
+        error = errno;
+        VLOG_ERR("unable to open capture file %s (%s)", path, strerror(error));
+        return error;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, FAND_TRACE_MAGIC, sizeof(FAND_TRACE_MAGIC));
+    hdr.version = FAND_TRACE_VERSION;
+    hdr.byte_order = FAND_TRACE_BYTE_ORDER;
+    fwrite(&hdr, sizeof(hdr), 1, capture_file);
+
+    shash_init(&capture_ids);
+    capture_path = xstrdup(path);
+    VLOG_INFO("capturing register traffic to %s", path);
+
+    return 0;
+}
+
+/* return the id of "name", defining it in the trace the first time */
+static uint16_t
+capture_intern(const char *name)
+{
+    struct fand_trace_string rec;
+    uintptr_t id;
+
+    id = (uintptr_t)shash_find_data(&capture_ids, name);
+    if (id != 0) {
+        return id - 1;
+    }
+
+    if (capture_next_id == UINT16_MAX) {
+        VLOG_WARN_ONCE("too many distinct names in capture file %s",
+                       capture_path);
+        return UINT16_MAX;
+    }
+
+    memset(&rec, 0, sizeof(rec));
+    rec.type = FAND_TRACE_STRING;
+    rec.id = capture_next_id++;
+    rec.len = strlen(name);
+    fwrite(&rec, sizeof(rec), 1, capture_file);
+    fwrite(name, rec.len, 1, capture_file);
+    shash_add(&capture_ids, name, (void *)(uintptr_t)(rec.id + 1));
+
+    return rec.id;
+}
+
+void
+fand_trace_capture(enum fand_trace_type type, const char *subsystem_name,
+                   const i2c_bit_op *op, uint32_t value, int rc,
+                   long long int start_nsec, size_t batch)
+{
+    struct fand_trace_access rec;
+    long long int latency_nsec;
+
+    if (capture_file == NULL) {
+        return;
+    }
+
+    latency_nsec = (fand_trace_nsec() - start_nsec) / MAX(batch, 1);
+
+    memset(&rec, 0, sizeof(rec));
+    rec.type = type;
+    rec.subsystem = capture_intern(subsystem_name);
+    rec.device = capture_intern(op->device ? op->device : "");
+    rec.address = op->register_address;
+    rec.mask = op->bit_mask;
+    rec.value = value;
+    rec.rc = rc;
+    rec.latency_nsec = MIN(latency_nsec, UINT32_MAX);
+    rec.timestamp_usec = time_wall_usec() - latency_nsec / 1000;
+
+    fwrite(&rec, sizeof(rec), 1, capture_file);
+    capture_records++;
+}
+
+void
+fand_trace_flush(void)
+{
+    if (capture_file != NULL && fflush(capture_file) != 0) {
+        VLOG_WARN_ONCE("unable to write capture file %s (%s)",
+                       capture_path, strerror(errno));
+    }
+}
+
+/* read all of "path" into memory */
+static int
+replay_load_file(const char *path, char **bufp, size_t *sizep)
+{
+    FILE *file;
+    char *buf;
+    long size;
+    int error;
+
+    file = fopen(path, "rb");
+    if (file == NULL) {
+        return errno;
+    }
+
+    if (fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < 0
+            || fseek(file, 0, SEEK_SET) != 0) {
+        error = errno;
+        fclose(file);
+        return error;
+    }
+
+    buf = xmalloc(size ? size : 1);
+    if (fread(buf, 1, size, file) != (size_t)size) {
+        error = ferror(file) ? errno : EINVAL;
+        fclose(file);
+        free(buf);
+        return error;
+    }
+    fclose(file);
+
+    *bufp = buf;
+    *sizep = size;
+    return 0;
+}
+
+/* parse the records in "buf" into replay_records and replay_ids */
+static int
+replay_parse(const char *buf, size_t size)
+{
+    struct fand_trace_header hdr;
+    size_t allocated = 0;
+    size_t pos;
+
+    if (size < sizeof(hdr)) {
+        return EINVAL;
+    }
+    memcpy(&hdr, buf, sizeof(hdr));
+    if (memcmp(hdr.magic, FAND_TRACE_MAGIC, sizeof(FAND_TRACE_MAGIC))
+            || hdr.version != FAND_TRACE_VERSION
+            || hdr.byte_order != FAND_TRACE_BYTE_ORDER) {
+        return EINVAL;
+    }
+
+    for (pos = sizeof(hdr); pos < size; ) {
+        if (buf[pos] == FAND_TRACE_STRING) {
+            struct fand_trace_string rec;
+            char *name;
+
+            if (size - pos < sizeof(rec)) {
+                return EINVAL;
+            }
+            memcpy(&rec, buf + pos, sizeof(rec));
+            pos += sizeof(rec);
+            if (size - pos < rec.len) {
+                return EINVAL;
+            }
+            name = xmemdup0(buf + pos, rec.len);
+            shash_replace(&replay_ids, name, (void *)(uintptr_t)(rec.id + 1));
+            free(name);
+            pos += rec.len;
+        } else if (buf[pos] == FAND_TRACE_READ
+                   || buf[pos] == FAND_TRACE_WRITE) {
+            if (size - pos < sizeof(struct fand_trace_access)) {
+                return EINVAL;
+            }
+            if (replay_n == allocated) {
+                replay_records = x2nrealloc(replay_records, &allocated,
+                                            sizeof *replay_records);
+            }
+            memcpy(&replay_records[replay_n++], buf + pos,
+                   sizeof(struct fand_trace_access));
+            pos += sizeof(struct fand_trace_access);
+        } else {
+            return EINVAL;
+        }
+    }
+
+    return 0;
+}
+
+int
+fand_trace_replay_open(const char *path, bool max_speed)
+{
+    size_t size = 0;
+    char *buf = NULL;
+    int error;
+
+    shash_init(&replay_ids);
+
+    error = replay_load_file(path, &buf, &size);
+    if (error) {
+        VLOG_ERR("unable to read replay file %s (%s)", path, strerror(error));
+        return error;
+    }
+
+    error = replay_parse(buf, size);
+    free(buf);
+    if (error) {
+        VLOG_ERR("replay file %s is not a valid ops-fand trace", path);
+        return error;
+    }
+
+    replay_path = xstrdup(path);
+    replay_max_speed = max_speed;
+    replay_enabled = true;
+    VLOG_INFO("replaying %"PRIuSIZE" register accesses from %s at %s speed",
+              replay_n, path, max_speed ? "maximum" : "original");
+
+    return 0;
+}
+
+/* find the next recorded access that matches this one. accesses the daemon
+   didn't repeat are skipped. returns NULL if there is none nearby. */
+static const struct fand_trace_access *
+replay_next(enum fand_trace_type type, const char *subsystem_name,
+            const i2c_bit_op *op)
+{
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 5);
+    uintptr_t subsystem;
+    uintptr_t device;
+    size_t end;
+    size_t idx;
+
+    subsystem = (uintptr_t)shash_find_data(&replay_ids, subsystem_name);
+    device = (uintptr_t)shash_find_data(&replay_ids,
+                                        op->device ? op->device : "");
+
+    end = MIN(replay_n, replay_pos + FAND_TRACE_REPLAY_WINDOW);
+    for (idx = replay_pos; subsystem && device && idx < end; idx++) {
+        const struct fand_trace_access *rec = &replay_records[idx];
+
+        if (rec->type == type && rec->subsystem == subsystem - 1
+                && rec->device == device - 1
+                && rec->address == op->register_address
+                && rec->mask == op->bit_mask) {
+            if (idx != replay_pos) {
+                VLOG_WARN_RL(&rl, "replay skipped %"PRIuSIZE" recorded "
+                             "accesses", idx - replay_pos);
+                replay_skipped += idx - replay_pos;
+            }
+            replay_pos = idx + 1;
+            return rec;
+        }
+    }
+
+    replay_misses++;
+    if (replay_pos == replay_n) {
+        VLOG_WARN_ONCE("replay of %s finished", replay_path);
+    } else {
+        VLOG_WARN_RL(&rl, "no recorded %s of %s register 0x%x in subsystem "
+                     "%s", type == FAND_TRACE_READ ? "read" : "write",
+                     op->device ? op->device : "",
+                     (unsigned int)op->register_address, subsystem_name);
+    }
+    return NULL;
+}
+
+/* at original speed, don't return a recorded access before it happened
+   (relative to the first replayed access) plus its latency */
+static void
+replay_pace(const struct fand_trace_access *rec)
+{
+    long long int due;
+    long long int now;
+
+    if (replay_max_speed) {
+        return;
+    }
+
+    now = fand_trace_nsec();
+    if (replay_start_nsec == 0) {
+        replay_start_nsec = now;
+    }
+
+    due = replay_start_nsec
+          + (long long int)(rec->timestamp_usec
+                            - replay_records[0].timestamp_usec) * 1000
+          + rec->latency_nsec;
+    if (due > now) {
+        struct timespec delay;
+
+        delay.tv_sec = (due - now) / 1000000000;
+        delay.tv_nsec = (due - now) % 1000000000;
+        nanosleep(&delay, NULL);
+    }
+}
+
+static int
+replay_read(const char *subsystem_name, const i2c_bit_op *op, uint32_t *value)
+{
+    const struct fand_trace_access *rec;
+
+    rec = replay_next(FAND_TRACE_READ, subsystem_name, op);
+    if (rec == NULL) {
+        return -ENODATA;
+    }
+
+    replay_pace(rec);
+    *value = rec->value;
+    return rec->rc;
+}
+
+static int
+replay_write(const char *subsystem_name, const i2c_bit_op *op, uint32_t value)
+{
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 5);
+    const struct fand_trace_access *rec;
+
+    rec = replay_next(FAND_TRACE_WRITE, subsystem_name, op);
+    if (rec == NULL) {
+        return -ENODATA;
+    }
+
+    if (rec->value != value) {
+        VLOG_WARN_RL(&rl, "replay: subsystem %s wrote 0x%x to %s register "
+                     "0x%x, recorded 0x%x", subsystem_name,
+                     (unsigned int)value, op->device ? op->device : "",
+                     (unsigned int)op->register_address,
+                     (unsigned int)rec->value);
+        replay_mismatches++;
+    }
+
+    replay_pace(rec);
+    return rec->rc;
+}
+
+/* replay backend: serves each access from the loaded trace */
+
+static int
+replay_backend_open(const char *subsystem_name, const char *arg OVS_UNUSED,
+                    struct fand_backend **backendp)
+{
+    struct fand_backend *backend;
+
+    if (!replay_enabled) {
+        VLOG_ERR("subsystem %s: no trace to replay (use --hw-replay)",
+                 subsystem_name);
+        return ENOENT;
+    }
+
+    backend = xmalloc(sizeof *backend);
+    fand_backend_init(backend, &fand_replay_backend_class, subsystem_name);
+    *backendp = backend;
+    return 0;
+}
+
+static void
+replay_backend_close(struct fand_backend *backend)
+{
+    fand_backend_uninit(backend);
+    free(backend);
+}
+
+static void
+replay_backend_read(struct fand_backend *backend, struct fand_reg_io ios[],
+                    size_t n)
+{
+    size_t idx;
+
+    for (idx = 0; idx < n; idx++) {
+        ios[idx].value = 0;
+        ios[idx].rc = replay_read(backend->subsystem_name, ios[idx].op,
+                                  &ios[idx].value);
+    }
+}
+
+static void
+replay_backend_write(struct fand_backend *backend, struct fand_reg_io ios[],
+                     size_t n)
+{
+    size_t idx;
+
+    for (idx = 0; idx < n; idx++) {
+        ios[idx].rc = replay_write(backend->subsystem_name, ios[idx].op,
+                                   ios[idx].value);
+    }
+}
+
+const struct fand_backend_class fand_replay_backend_class = {
+    "replay",
+    replay_backend_open,
+    replay_backend_close,
+    replay_backend_read,
+    replay_backend_write,
+    NULL,                       /* dump */
+};
+
+void
+fand_trace_close(void)
+{
+    if (capture_file != NULL) {
+        fand_trace_flush();
+        fclose(capture_file);
+        capture_file = NULL;
+        shash_destroy(&capture_ids);
+        free(capture_path);
+        capture_path = NULL;
+    }
+
+    if (replay_enabled) {
+        replay_enabled = false;
+        shash_destroy(&replay_ids);
+        free(replay_records);
+        replay_records = NULL;
+        replay_n = replay_pos = 0;
+        free(replay_path);
+        replay_path = NULL;
+    }
+}
+
+void
+fand_trace_dump(struct ds *ds)
+{
+    if (capture_file != NULL) {
+        ds_put_format(ds, "Capturing register traffic: %s, %"PRIu64
+                      " accesses\n", capture_path, capture_records);
+    }
+    if (replay_enabled) {
+        ds_put_format(ds, "Replaying register traffic: %s at %s speed\n",
+                      replay_path, replay_max_speed ? "maximum" : "original");
+        ds_put_format(ds, "    %"PRIuSIZE" of %"PRIuSIZE" accesses replayed, "
+                      "%"PRIu64" skipped, %"PRIu64" not found, "
+                      "%"PRIu64" write mismatches\n",
+                      replay_pos, replay_n, replay_skipped, replay_misses,
+                      replay_mismatches);
+    }
+}
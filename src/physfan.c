@@ -21,74 +21,109 @@
  * Source file for set set fan speed functions.
  ***************************************************************************/
 
+#include "util.h"
 #include "openvswitch/vlog.h"
 #include "config-yaml.h"
 #include "fanspeed.h"
 #include "fandirection.h"
 #include "fand-locl.h"
+#include "physfan.h"
 #include "eventlog.h"
+#include "fand-probes.h"
+#include "fandarena.h"
+#include "fandbackend.h"
+#include "fandsubsys.h"
+#include "fandtopo.h"
 
 VLOG_DEFINE_THIS_MODULE(physfan);
 
-/* global yaml config handle */
-extern YamlConfigHandle yaml_handle;
+static void
+fand_io_init(struct fand_reg_io *io, const char *name, const i2c_bit_op *op)
+{
+    io->op = op;
+    io->name = name;
+    io->value = 0;
+    io->rc = 0;
+    io->breaker = NULL;
+}
+
+/* append a read of "op" to the subsystem's sample batch, returning its
+   index. fru registers shared by several fans are only read once. */
+static size_t
+fand_add_sample_io(struct locl_subsystem *subsystem, const char *name,
+                   const i2c_bit_op *op)
+{
+    size_t idx;
+
+    for (idx = 0; idx < subsystem->n_sample_ios; idx++) {
+        if (subsystem->sample_ios[idx].op == op) {
+            return idx;
+        }
+    }
+
+    subsystem->sample_ios = xrealloc(subsystem->sample_ios,
+                                     (subsystem->n_sample_ios + 1)
+                                     * sizeof *subsystem->sample_ios);
+    fand_io_init(&subsystem->sample_ios[idx], name, op);
+    subsystem->n_sample_ios++;
+    return idx;
+}
+
+static void
+fand_add_write_io(struct fand_reg_io **ios, size_t *n, const char *name,
+                  const i2c_bit_op *op)
+{
+    *ios = xrealloc(*ios, (*n + 1) * sizeof **ios);
+    fand_io_init(&(*ios)[*n], name, op);
+    (*n)++;
+}
 
 static struct locl_fan *get_local_fan(struct locl_subsystem *subsystem,
                                       const char *name)
 {
-    struct shash_node *node, *next;
-    struct locl_fan *fan = NULL;
     char fullname[128];
 
     snprintf(fullname, sizeof(fullname), "%s-%s",
              subsystem->name, name);
 
-    SHASH_FOR_EACH_SAFE(node, next, &subsystem->subsystem_fans) {
-        fan = (struct locl_fan *)node->data;
-        if (strcmp(fan->name, fullname) == 0)
-            break;
-    }
-
-    return fan;
+    return fand_subsystem_find_fan(subsystem, fullname);
 }
 
-static int fand_set_led(struct locl_subsystem *subsystem,
-                        const YamlFanInfo *fan_info,
-                        i2c_bit_op *led, const enum fanstatus status)
+static uint32_t
+fand_led_value(const YamlFanInfo *fan_info, const enum fanstatus status)
 {
-    unsigned char ledval = 0;
-
     switch(status) {
     case FAND_STATUS_UNINITIALIZED:
-        ledval = fan_info->fan_led_values.off;
-        break;
+        return fan_info->fan_led_values.off;
     case FAND_STATUS_OK:
-        ledval = fan_info->fan_led_values.good;
-        break;
+        return fan_info->fan_led_values.good;
     case FAND_STATUS_FAULT:
     default:
-        ledval = fan_info->fan_led_values.fault;
-        break;
+        return fan_info->fan_led_values.fault;
     }
-    return i2c_reg_write(yaml_handle, subsystem->name, led, ledval);
- }
+}
 
 void fand_set_fanleds(struct locl_subsystem *subsystem)
 {
     const YamlFanInfo *fan_info;
     enum fanstatus aggr_status = FAND_STATUS_UNINITIALIZED;
-    int rc = 0;
+    struct fand_reg_io *io = subsystem->led_ios;
 
-    fan_info = yaml_get_fan_info(yaml_handle, subsystem->name);
+    if (fand_subsystems_standby()) {
+        return;
+    }
+
+    fan_info = subsystem->topo->info;
     if (fan_info == NULL) {
         VLOG_DBG("subsystem %s has no fan info", subsystem->name);
         return;
     }
 
-    for (size_t idx = 0; idx < fan_info->number_fan_frus; idx++) {
+    /* fill in led_ios in the order fand_prepare_io() built it: each fru
+       led, then the subsystem fan led */
+    for (size_t idx = 0; idx < subsystem->topo->n_frus; idx++) {
         enum fanstatus status = FAND_STATUS_UNINITIALIZED;
-        const YamlFanFru *fru = yaml_get_fan_fru(yaml_handle,
-                                                 subsystem->name, idx);
+        const YamlFanFru *fru = subsystem->topo->frus[idx];
         for (size_t fan_idx = 0; fru->fans[fan_idx]; fan_idx++) {
             const YamlFan *fan = fru->fans[fan_idx];
             struct locl_fan *lfan = get_local_fan(subsystem, fan->name);
@@ -102,19 +137,39 @@ void fand_set_fanleds(struct locl_subsystem *subsystem)
         if (fru->fan_leds == NULL)
             continue;
 
-        rc = fand_set_led(subsystem, fan_info, fru->fan_leds, status);
-        if (rc) {
-            VLOG_DBG("Unable to set subsystem %s fan fru %d status LED",
-                     subsystem->name, fru->number);
-        }
+        (io++)->value = fand_led_value(fan_info, status);
     }
 
     if (fan_info->fan_led) {
-        rc = fand_set_led(subsystem, fan_info,
-                          fan_info->fan_led, aggr_status);
-        if (rc) {
-            VLOG_DBG("Unable to set subsystem %s fan status LED",
-                     subsystem->name);
+        (io++)->value = fand_led_value(fan_info, aggr_status);
+    }
+
+    if (subsystem->backend == NULL) {
+        return;
+    }
+
+    if (subsystem->warm_led_values != NULL) {
+        size_t idx;
+
+        for (idx = 0; idx < subsystem->n_led_ios; idx++) {
+            if (subsystem->led_ios[idx].value
+                    != subsystem->warm_led_values[idx]) {
+                break;
+            }
+        }
+        if (idx == subsystem->n_led_ios) {
+            subsystem->n_warm_skips += subsystem->n_led_ios;
+            return;
+        }
+        subsystem->warm_led_values = NULL;
+    }
+
+    fand_backend_write(subsystem->backend, subsystem->led_ios,
+                       subsystem->n_led_ios);
+    for (size_t idx = 0; idx < subsystem->n_led_ios; idx++) {
+        if (subsystem->led_ios[idx].rc) {
+            VLOG_DBG("Unable to set subsystem %s %s status LED",
+                     subsystem->name, subsystem->led_ios[idx].name);
         }
     }
 }
@@ -123,8 +178,10 @@ void
 fand_set_fanspeed(struct locl_subsystem *subsystem)
 {
     unsigned char hw_speed_val;
+    const char *speedval;
     const YamlFanInfo *fan_info = NULL;
     enum fanspeed speed = subsystem->fan_speed_override;
+    enum fanspeed old_speed = subsystem->speed;
 
     /* use override if it exists, unless the sensors think the speed should be
        "max" (potential overtemp situation). */
@@ -139,8 +196,13 @@ fand_set_fanspeed(struct locl_subsystem *subsystem)
     /* set the speed value for record-keeping */
     subsystem->speed = speed;
 
+    /* the hardware belongs to the active ops-fand */
+    if (fand_subsystems_standby()) {
+        return;
+    }
+
     /* get the fan speed control i2c operation */
-    fan_info = yaml_get_fan_info(yaml_handle, subsystem->name);
+    fan_info = subsystem->topo->info;
 
     if (fan_info == NULL) {
         VLOG_DBG("subsystem %s has no fan info", subsystem->name);
@@ -155,282 +217,476 @@ fand_set_fanspeed(struct locl_subsystem *subsystem)
             VLOG_DBG("subsystem %s: setting fan speed control register to NORMAL: 0x%x",
                 subsystem->name,
                 hw_speed_val);
-            log_event("FAN_SPEED", EV_KV("subsystem", "%s", subsystem->name),
-                EV_KV("speedval", "%s", "NORMAL"),
-                EV_KV("value", "0x%x", hw_speed_val));
+            speedval = "NORMAL";
             break;
         case FAND_SPEED_SLOW:
             hw_speed_val = fan_info->fan_speed_settings.slow;
             VLOG_DBG("subsystem %s: setting fan speed control register to SLOW: 0x%x",
                 subsystem->name,
                 hw_speed_val);
-            log_event("FAN_SPEED", EV_KV("subsystem", "%s", subsystem->name),
-                EV_KV("speedval", "%s", "SLOW"),
-                EV_KV("value", "0x%x", hw_speed_val));
+            speedval = "SLOW";
             break;
         case FAND_SPEED_MEDIUM:
             hw_speed_val = fan_info->fan_speed_settings.medium;
             VLOG_DBG("subsystem %s: setting fan speed control register to MEDIUM: 0x%x",
                 subsystem->name,
                 hw_speed_val);
-            log_event("FAN_SPEED", EV_KV("subsystem", "%s", subsystem->name),
-                EV_KV("speedval", "%s", "MEDIUM"),
-                EV_KV("value", "0x%x", hw_speed_val));
+            speedval = "MEDIUM";
             break;
         case FAND_SPEED_FAST:
             hw_speed_val = fan_info->fan_speed_settings.fast;
             VLOG_DBG("subsystem %s: setting fan speed control register to FAST: 0x%x",
                 subsystem->name,
                 hw_speed_val);
-            log_event("FAN_SPEED", EV_KV("subsystem", "%s", subsystem->name),
-                EV_KV("speedval", "%s", "FAST"),
-                EV_KV("value", "0x%x", hw_speed_val));
+            speedval = "FAST";
             break;
         case FAND_SPEED_MAX:
             hw_speed_val = fan_info->fan_speed_settings.max;
             VLOG_DBG("subsystem %s: setting fan speed control register to MAX: 0x%x",
                 subsystem->name,
                 hw_speed_val);
-            log_event("FAN_SPEED", EV_KV("subsystem", "%s", subsystem->name),
-                EV_KV("speedval", "%s", "MAX"),
-                EV_KV("value", "0x%x", hw_speed_val));
+            speedval = "MAX";
             break;
     }
 
+    /* reconfiguring applies the speed again whenever the database changes,
+       so only log an actual change */
+    if (speed != old_speed) {
+        log_event("FAN_SPEED", EV_KV("subsystem", "%s", subsystem->name),
+            EV_KV("speedval", "%s", speedval),
+            EV_KV("value", "0x%x", hw_speed_val));
+        FAND_PROBE4(speed__change, subsystem->name, old_speed, speed,
+                    hw_speed_val);
+    }
+
+    if (subsystem->backend == NULL) {
+        return;
+    }
+
+    /* every speed control register (one per subsystem, fru or fan, see
+       fand_prepare_io()) gets the same value */
+    for (size_t idx = 0; idx < subsystem->n_speed_ios; idx++) {
+        subsystem->speed_ios[idx].value = hw_speed_val;
+    }
+    if (subsystem->warm_speed) {
+        if (subsystem->warm_speed_value == hw_speed_val) {
+            subsystem->n_warm_skips += subsystem->n_speed_ios;
+            return;
+        }
+        subsystem->warm_speed = false;
+    }
+    fand_backend_write(subsystem->backend, subsystem->speed_ios,
+                       subsystem->n_speed_ios);
+    VLOG_DBG("FAN speed set to %#x", hw_speed_val);
+}
+
+void
+fand_forget_warm(struct locl_subsystem *subsystem)
+{
+    subsystem->warm_speed = false;
+    subsystem->warm_led_values = NULL;
+}
+
+/* copy the "n" "ios" into the subsystem's arena and free them */
+static struct fand_reg_io *
+fand_io_move(struct locl_subsystem *subsystem, struct fand_reg_io *ios,
+             size_t n)
+{
+    struct fand_reg_io *copy;
+
+    copy = fand_arena_memdup(subsystem->arena, ios, n * sizeof *ios);
+    free(ios);
+    return copy;
+}
+
+void
+fand_prepare_io(struct locl_subsystem *subsystem)
+{
+    const YamlFanInfo *fan_info;
+    int control_type;
+
+    fan_info = subsystem->topo->info;
+    if (fan_info == NULL) {
+        return;
+    }
+
     /* Fan speed may have one control per subsystem, per fru, or per fan. */
-    if (fan_info->fan_speed_control_type == SINGLE) {
+    control_type = fan_info->fan_speed_control_type;
+    if (control_type == SINGLE) {
         if (fan_info->fan_speed_control == NULL) {
             VLOG_DBG("subsystem %s has no fan speed control", subsystem->name);
-            return;
+        } else {
+            fand_add_write_io(&subsystem->speed_ios, &subsystem->n_speed_ios,
+                              "fan_speed_control",
+                              fan_info->fan_speed_control);
         }
-        i2c_reg_write(yaml_handle, subsystem->name,
-                      fan_info->fan_speed_control, hw_speed_val);
-        VLOG_DBG("FAN speed set to %#x", hw_speed_val);
-    } else {
-        for (size_t idx = 0; idx < fan_info->number_fan_frus; idx++) {
-            const YamlFanFru *fru = yaml_get_fan_fru(yaml_handle,
-                                                     subsystem->name, idx);
-            if (fan_info->fan_speed_control_type == PER_FRU) {
-                if (fru->fan_speed_control == NULL) {
-                  VLOG_DBG("fan fru %d has no fan speed control", fru->number);
-                  continue;
-                }
-                i2c_reg_write(yaml_handle, subsystem->name,
-                              fru->fan_speed_control, hw_speed_val);
-            } else if (fan_info->fan_speed_control_type == PER_FAN) {
-               for (size_t fan_idx = 0; fru->fans[fan_idx]; fan_idx++) {
-                    const YamlFan *fan = fru->fans[fan_idx];
-                    if (fan->fan_speed_control == NULL) {
-                        VLOG_DBG("fan %s has no fan speed control", fan->name);
-                        continue;
-                    }
-                    i2c_reg_write(yaml_handle, subsystem->name,
-                                  fan->fan_speed_control, hw_speed_val);
-               }
+    } else if (control_type != PER_FRU && control_type != PER_FAN) {
+        VLOG_WARN("subsystem %s: invalid fan speed control type (%d)",
+                  subsystem->name, control_type);
+    }
+
+    /* the fru presence and direction reads go first in the sample, so that
+       the fans of absent frus can be left out of the rest of it */
+    for (size_t idx = 0; idx < subsystem->topo->n_frus; idx++) {
+        const YamlFanFru *fru = subsystem->topo->frus[idx];
+
+        for (size_t fan_idx = 0; fru->fans[fan_idx]; fan_idx++) {
+            struct locl_fan *lfan;
+
+            lfan = get_local_fan(subsystem, fru->fans[fan_idx]->name);
+            if (lfan == NULL) {
+                continue;
+            }
+
+            lfan->fru = fru;
+            lfan->io_present = FAND_IO_NONE;
+            lfan->io_direction = FAND_IO_NONE;
+            if (fru->fan_present) {
+                lfan->io_present = fand_add_sample_io(subsystem, "fan_present",
+                                                      fru->fan_present);
+            }
+            if (fru->fan_direction_detect) {
+                lfan->io_direction =
+                    fand_add_sample_io(subsystem, "fan_direction_detect",
+                                       fru->fan_direction_detect);
+            }
+        }
+    }
+    subsystem->n_presence_ios = subsystem->n_sample_ios;
+
+    for (size_t idx = 0; idx < subsystem->topo->n_frus; idx++) {
+        const YamlFanFru *fru = subsystem->topo->frus[idx];
+
+        if (control_type == PER_FRU) {
+            if (fru->fan_speed_control == NULL) {
+                VLOG_DBG("fan fru %d has no fan speed control", fru->number);
             } else {
-                VLOG_WARN("subsystem %s: invalid fan speed control type (%d)",
-                          subsystem->name,
-                          fan_info->fan_speed_control_type);
-                return;
+                fand_add_write_io(&subsystem->speed_ios,
+                                  &subsystem->n_speed_ios,
+                                  "fru_speed_control",
+                                  fru->fan_speed_control);
+            }
+        }
+
+        if (fru->fan_leds != NULL) {
+            fand_add_write_io(&subsystem->led_ios, &subsystem->n_led_ios,
+                              "fru_led", fru->fan_leds);
+        }
+
+        for (size_t fan_idx = 0; fru->fans[fan_idx]; fan_idx++) {
+            const YamlFan *fan = fru->fans[fan_idx];
+            struct locl_fan *lfan;
+
+            if (control_type == PER_FAN) {
+                if (fan->fan_speed_control == NULL) {
+                    VLOG_DBG("fan %s has no fan speed control", fan->name);
+                } else {
+                    fand_add_write_io(&subsystem->speed_ios,
+                                      &subsystem->n_speed_ios, fan->name,
+                                      fan->fan_speed_control);
+                }
+            }
+
+            lfan = get_local_fan(subsystem, fan->name);
+            if (lfan == NULL) {
+                continue;
+            }
+
+            lfan->io_rpm_msb = FAND_IO_NONE;
+            lfan->io_rpm = fand_add_sample_io(subsystem, fan->name,
+                                              fan->fan_speed);
+            if (fan->fan_speed_msb) {
+                lfan->io_rpm_msb = fand_add_sample_io(subsystem, fan->name,
+                                                      fan->fan_speed_msb);
             }
+            lfan->io_fault = fand_add_sample_io(subsystem, fan->name,
+                                                fan->fan_fault);
         }
     }
+
+    if (fan_info->fan_led) {
+        fand_add_write_io(&subsystem->led_ios, &subsystem->n_led_ios,
+                          "fan_led", fan_info->fan_led);
+    }
+
+    /* the batches were grown on the heap; keep them in the arena */
+    subsystem->sample_ios = fand_io_move(subsystem, subsystem->sample_ios,
+                                         subsystem->n_sample_ios);
+    subsystem->speed_ios = fand_io_move(subsystem, subsystem->speed_ios,
+                                        subsystem->n_speed_ios);
+    subsystem->led_ios = fand_io_move(subsystem, subsystem->led_ios,
+                                      subsystem->n_led_ios);
+    subsystem->fru_ios = fand_arena_alloc(subsystem->arena,
+                                          subsystem->n_sample_ios
+                                          * sizeof *subsystem->fru_ios);
+    subsystem->fru_io_idx = fand_arena_alloc(subsystem->arena,
+                                             subsystem->n_sample_ios
+                                             * sizeof *subsystem->fru_io_idx);
+}
+
+/* add sample_ios index "io" to the fru batch, unless it's there already */
+static size_t
+fand_fru_io_add(struct locl_subsystem *subsystem, size_t n, size_t io)
+{
+    size_t idx;
+
+    if (io == FAND_IO_NONE) {
+        return n;
+    }
+    for (idx = 0; idx < n; idx++) {
+        if (subsystem->fru_io_idx[idx] == io) {
+            return n;
+        }
+    }
+    subsystem->fru_io_idx[n] = io;
+    subsystem->fru_ios[n] = subsystem->sample_ios[io];
+    return n + 1;
+}
+
+/* read the first "n" fru_ios and copy the results back to sample_ios */
+static void
+fand_read_gathered(struct locl_subsystem *subsystem, size_t n)
+{
+    size_t idx;
+
+    fand_backend_read(subsystem->backend, subsystem->fru_ios, n);
+    for (idx = 0; idx < n; idx++) {
+        subsystem->sample_ios[subsystem->fru_io_idx[idx]] =
+            subsystem->fru_ios[idx];
+    }
+}
+
+/* true if the fru of "fan" was present when its presence was last read */
+static bool
+fand_fan_present(const struct locl_fan *fan)
+{
+    const struct fand_reg_io *io;
+
+    if (fan->io_present == FAND_IO_NONE) {
+        return true;
+    }
+    io = &fan->subsystem->sample_ios[fan->io_present];
+    return io->rc >= 0 && io->value != 0;
+}
+
+/* read the sample_ios of the fans in "fru", or of all fans if NULL. the
+   speed and fault registers of a fan in an empty slot would only fail,
+   and count against the breaker of their device, so they are read only
+   once the fru is known to be present. */
+static void
+fand_read_sample(struct locl_subsystem *subsystem, const YamlFanFru *fru)
+{
+    const struct locl_fan *fan;
+    bool all_present = true;
+    size_t n = 0;
+
+    if (subsystem->backend == NULL) {
+        return;
+    }
+
+    if (fru == NULL) {
+        fand_backend_read(subsystem->backend, subsystem->sample_ios,
+                          subsystem->n_presence_ios);
+    } else {
+        LOCL_FAN_FOR_EACH(fan, subsystem) {
+            if (fan->fru == fru) {
+                n = fand_fru_io_add(subsystem, n, fan->io_present);
+                n = fand_fru_io_add(subsystem, n, fan->io_direction);
+            }
+        }
+        fand_read_gathered(subsystem, n);
+        n = 0;
+    }
+
+    LOCL_FAN_FOR_EACH(fan, subsystem) {
+        if ((fru == NULL || fan->fru == fru) && !fand_fan_present(fan)) {
+            all_present = false;
+        }
+    }
+
+    /* the usual case: the rest of the sample, as it is */
+    if (fru == NULL && all_present) {
+        fand_backend_read(subsystem->backend,
+                          subsystem->sample_ios + subsystem->n_presence_ios,
+                          subsystem->n_sample_ios - subsystem->n_presence_ios);
+        return;
+    }
+
+    LOCL_FAN_FOR_EACH(fan, subsystem) {
+        if ((fru == NULL || fan->fru == fru) && fand_fan_present(fan)) {
+            n = fand_fru_io_add(subsystem, n, fan->io_rpm);
+            n = fand_fru_io_add(subsystem, n, fan->io_rpm_msb);
+            n = fand_fru_io_add(subsystem, n, fan->io_fault);
+        }
+    }
+    fand_read_gathered(subsystem, n);
+}
+
+void
+fand_read_subsystem(struct locl_subsystem *subsystem)
+{
+    fand_read_sample(subsystem, NULL);
+}
+
+void
+fand_read_fru(struct locl_subsystem *subsystem, const YamlFanFru *fru)
+{
+    fand_read_sample(subsystem, fru);
 }
 
 static int
-fand_read_rpm(const char *subsystem_name, const YamlFan *fan)
+fand_read_rpm(const struct locl_fan *fan)
 {
-    uint32_t dword = 0;
+    const struct fand_reg_io *ios = fan->subsystem->sample_ios;
     uint32_t rpm;
-    int rc;
 
-    rc = i2c_reg_read(yaml_handle, subsystem_name, fan->fan_speed, &dword);
-
-    if (rc != 0) {
+    if (ios[fan->io_rpm].rc != 0) {
         VLOG_WARN("subsystem %s: unable to read fan %s rpm (%d)",
-            subsystem_name,
-            fan->name,
-            rc);
+            fan->subsystem->name,
+            fan->yaml_fan->name,
+            ios[fan->io_rpm].rc);
         return(0);
     }
 
     /* Least significant byte */
-    rpm = dword;
-
-    if (fan->fan_speed_msb) {
-        rc = i2c_reg_read(yaml_handle, subsystem_name,
-                          fan->fan_speed_msb, &dword);
+    rpm = ios[fan->io_rpm].value;
 
-        if (rc != 0) {
+    if (fan->io_rpm_msb != FAND_IO_NONE) {
+        if (ios[fan->io_rpm_msb].rc != 0) {
             VLOG_WARN("subsystem %s: unable to read fan %s rpm MSB (%d)",
-                      subsystem_name,
-                      fan->name,
-                      rc);
+                      fan->subsystem->name,
+                      fan->yaml_fan->name,
+                      ios[fan->io_rpm_msb].rc);
             return(0);
         }
 
         /* Most significant byte */
-        rpm += dword << 8;
+        rpm += ios[fan->io_rpm_msb].value << 8;
     }
 
     return (int)rpm;
 }
 
 static enum fanstatus
-fand_read_status(const char *subsystem_name, const YamlFan *fan)
+fand_read_status(const struct locl_fan *fan)
 {
-    i2c_bit_op *status_op;
-    int rc;
-    uint32_t value = 0;
-
-    status_op = fan->fan_fault;
+    const struct fand_reg_io *io = &fan->subsystem->sample_ios[fan->io_fault];
 
-    rc = i2c_reg_read(yaml_handle, subsystem_name, status_op, &value);
-
-    if (rc != 0) {
+    if (io->rc != 0) {
         VLOG_WARN("subsystem %s: unable to read fan %s status (%d)",
-            subsystem_name,
-            fan->name,
-            rc);
+            fan->subsystem->name,
+            fan->yaml_fan->name,
+            io->rc);
         return(0);
     }
-    VLOG_DBG("status is %08x (%08x)", value, status_op->bit_mask);
+    VLOG_DBG("status is %08x (%08x)", io->value, io->op->bit_mask);
 
-    if (value != 0) {
+    if (io->value != 0) {
         VLOG_DBG("status is fault");
         return FAND_STATUS_FAULT;
     }
     return FAND_STATUS_OK;
 }
 
-enum fandirection
-fand_read_fan_fru_direction(
-    const char *subsystem_name,
-    const YamlFanFru *fru,
-    const YamlFanInfo *info)
+static const char *
+fand_read_direction(const struct locl_fan *fan)
 {
-    i2c_bit_op *direction_op;
-    int rc;
-    uint32_t value;
-
-    direction_op = fru->fan_direction_detect;
+    const struct fand_reg_io *io;
+    const YamlFanInfo *info;
+    enum fandirection fan_direction = FAND_DIRECTION_F2B;
 
-    rc = i2c_reg_read(yaml_handle, subsystem_name, direction_op, &value);
+    if (fan->io_direction == FAND_IO_NONE) {
+        return(fan_direction_enum_to_string(fan_direction));
+    }
 
-    if (rc != 0) {
+    io = &fan->subsystem->sample_ios[fan->io_direction];
+    if (io->rc != 0) {
         VLOG_WARN("subsystem %s: unable to read fan fru %d direction (%d)",
-            subsystem_name,
-            fru->number,
-            rc);
-        return(FAND_DIRECTION_F2B);
+            fan->subsystem->name,
+            fan->fru->number,
+            io->rc);
+        return(fan_direction_enum_to_string(fan_direction));
     }
 
-    VLOG_DBG("direction is %08x (%08x)", value, direction_op->bit_mask);
+    VLOG_DBG("direction is %08x (%08x)", io->value, io->op->bit_mask);
+
+    info = fan->subsystem->topo->info;
 
     /* OPS_TODO: code assumption: the value is a single bit that indicates
        direction as either front-to-back or back-to-front. It would be better
        if we had an absolute value, but the i2c ops don't have bit shift values,
        so we can't do a direct comparison. */
-    if (value != 0) {
-        if (info->direction_values.f2b != 0) {
-            return FAND_DIRECTION_F2B;
-        } else {
-            return FAND_DIRECTION_B2F;
-        }
+    if ((io->value != 0) == (info->direction_values.f2b != 0)) {
+        fan_direction = FAND_DIRECTION_F2B;
     } else {
-        if (info->direction_values.f2b != 0) {
-            return FAND_DIRECTION_B2F;
-        } else {
-            return FAND_DIRECTION_F2B;
-        }
+        fan_direction = FAND_DIRECTION_B2F;
     }
-}
-
-static const YamlFanFru *
-fan_fru_get(const char *subsystem_name, const YamlFan *fan)
-{
-    int idx;
-    int count;
-
-    count = yaml_get_fan_fru_count(yaml_handle, subsystem_name);
-
-    for (idx = 0; idx < count; idx++) {
-        const YamlFanFru *fru;
-        int fan_idx;
 
-        fru = yaml_get_fan_fru(yaml_handle, subsystem_name, idx);
-
-        for (fan_idx = 0; fru->fans[fan_idx] != NULL; fan_idx++) {
-            if (fan == fru->fans[fan_idx]) {
-                return fru;
-            }
-        }
-    }
-    return(NULL);
+    return(fan_direction_enum_to_string(fan_direction));
 }
 
-static const char *
-fand_read_direction(const char *subsystem_name, const YamlFan *fan)
+static int
+fand_read_present(const struct locl_fan *fan)
 {
-    const YamlFanFru *fan_fru;
-    const YamlFanInfo *fan_info;
-    enum fandirection fan_direction = FAND_DIRECTION_F2B;
+    const struct fand_reg_io *io;
 
-    fan_fru = fan_fru_get(subsystem_name, fan);
-
-    if (fan_fru == NULL) {
-        return(fan_direction_enum_to_string(fan_direction));
+    if (fan->io_present == FAND_IO_NONE) {
+        return 1;
     }
 
-    fan_info = yaml_get_fan_info(yaml_handle, subsystem_name);
-
-    if (fan_fru->fan_direction_detect != NULL) {
-        fan_direction = fand_read_fan_fru_direction(
-                subsystem_name,
-                fan_fru,
-                fan_info);
+    io = &fan->subsystem->sample_ios[fan->io_present];
+    if (io->rc < 0) {
+        VLOG_WARN("subsystem %s: unable to read FRU %d present (%d)",
+                  fan->subsystem->name,
+                  fan->fru->number,
+                  io->rc);
+        return 0;
     }
-
-    return(fan_direction_enum_to_string(fan_direction));
+    return (io->value != 0);
 }
 
-static int
-fand_read_present(const char *subsystem_name, const YamlFanFru *fru)
+/* true if any of the fan's registers was skipped by a breaker. those of
+   a fan whose fru is absent weren't read, so only its fru's count. */
+static bool
+fand_fan_skipped(const struct locl_fan *fan)
 {
-    int rc;
-    uint32_t present;
-
-    if (!fru->fan_present)
-        present = 1;
-    else {
-        rc = i2c_reg_read(yaml_handle, subsystem_name,
-                          fru->fan_present, &present);
-        if (rc < 0) {
-            VLOG_WARN("subsystem %s: unable to read FRU %d present (%d)",
-                      subsystem_name,
-                      fru->number,
-                      rc);
-            present = 0;
+    const struct fand_reg_io *ios = fan->subsystem->sample_ios;
+    size_t io[] = { fan->io_present, fan->io_direction, fan->io_rpm,
+                    fan->io_rpm_msb, fan->io_fault };
+    size_t n = fand_fan_present(fan) ? ARRAY_SIZE(io) : 2;
+    size_t idx;
+
+    for (idx = 0; idx < n; idx++) {
+        if (io[idx] != FAND_IO_NONE && ios[io[idx]].rc == FAND_IO_SKIPPED) {
+            return true;
         }
     }
-    return (present != 0);
+    return false;
 }
 
 void
 fand_read_fan_status(struct locl_fan *fan)
 {
-    const YamlFanFru *fan_fru;
+    /* a fan behind a device that doesn't respond is faulty; keep its last
+       direction */
+    if (fand_fan_skipped(fan)) {
+        if (fan->direction == NULL) {
+            fan->direction = fan_direction_enum_to_string(FAND_DIRECTION_F2B);
+        }
+        fan->status = FAND_STATUS_FAULT;
+        fan->rpm = 0;
+        return;
+    }
 
-    fan->direction = fand_read_direction(fan->subsystem->name, fan->yaml_fan);
+    fan->direction = fand_read_direction(fan);
 
-    fan_fru = fan_fru_get(fan->subsystem->name, fan->yaml_fan);
-    if (!fand_read_present(fan->subsystem->name, fan_fru)) {
+    if (!fand_read_present(fan)) {
         fan->status = FAND_STATUS_FAULT;
         fan->rpm = 0;
         return;
     }
 
-    fan->rpm = fand_read_rpm(fan->subsystem->name, fan->yaml_fan);
+    fan->rpm = fand_read_rpm(fan);
     if (fan->subsystem->multiplier)
         fan->rpm *= fan->subsystem->multiplier;
     else if (fan->subsystem->numerator) {
@@ -444,5 +700,5 @@ fand_read_fan_status(struct locl_fan *fan)
                   fan->subsystem->name);
     }
 
-    fan->status = fand_read_status(fan->subsystem->name, fan->yaml_fan);
+    fan->status = fand_read_status(fan);
 }
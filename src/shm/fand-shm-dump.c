@@ -0,0 +1,83 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Example reader of the ops-fand live fan state shared memory segment.
+ *
+ *     usage: fand-shm-dump [NAME]
+ *
+ * Prints one line per fan from a consistent snapshot of the segment, and
+ * whether ops-fand is still updating it.
+ ***************************************************************************/
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fand-shm.h"
+
+int
+main(int argc, char *argv[])
+{
+    const struct fand_shm *shm;
+    struct fand_shm *snap;
+    uint32_t idx;
+    int error;
+
+    shm = fand_shm_open(argc > 1 ? argv[1] : NULL);
+    if (shm == NULL) {
+        fprintf(stderr, "unable to open fan state segment (%s)\n",
+                strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    /* the snapshot is ~100 kB, so don't put it on the stack */
+    snap = malloc(sizeof(*snap));
+    if (snap == NULL) {
+        fand_shm_close(shm);
+        return EXIT_FAILURE;
+    }
+
+    error = fand_shm_snapshot(shm, snap);
+    fand_shm_close(shm);
+    if (error) {
+        fprintf(stderr, "unable to read fan state segment (%s)\n",
+                strerror(error));
+        free(snap);
+        return EXIT_FAILURE;
+    }
+
+    printf("pid %d, updated %lld.%06lld%s\n", snap->hdr.pid,
+           (long long)snap->hdr.update_usec / 1000000,
+           (long long)snap->hdr.update_usec % 1000000,
+           snap->hdr.pid == 0 ? " (ops-fand exited)"
+           : kill(snap->hdr.pid, 0) < 0 && errno == ESRCH
+           ? " (ops-fand died)" : "");
+    for (idx = 0; idx < snap->hdr.n_fans; idx++) {
+        const struct fand_shm_fan *fan = &snap->fans[idx];
+        printf("%-16s %-24s rpm=%-6d status=%d direction=%d speed=%d\n",
+               snap->subsystems[fan->subsystem].name, fan->name, fan->rpm,
+               fan->status, fan->direction, fan->speed);
+    }
+
+    free(snap);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,111 @@
+/*
+ *  (c) Copyright 2015 Hewlett Packard Enterprise Development LP
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License. You may obtain
+ *  a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing permissions and limitations
+ *  under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup fand
+ *
+ * @file
+ * Reader library for the ops-fand live fan state shared memory segment.
+ ***************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fand-shm.h"
+
+/* how many times fand_shm_snapshot() tries before giving up. the writer
+   holds the lock only while it rewrites the segment (about 100 kB when
+   full), so this is only reached if it died while updating. */
+#define SNAPSHOT_TRIES  1000
+
+const struct fand_shm *
+fand_shm_open(const char *name)
+{
+    const struct fand_shm *shm;
+    struct stat st;
+    void *addr;
+    int fd;
+
+    if (name == NULL) {
+        name = FAND_SHM_DEFAULT_NAME;
+    }
+
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return NULL;
+    }
+
+    if (st.st_size != sizeof(struct fand_shm)) {
+        close(fd);
+        errno = EPROTO;
+        return NULL;
+    }
+
+    addr = mmap(NULL, sizeof(struct fand_shm), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return NULL;
+    }
+
+    shm = addr;
+    if (shm->hdr.magic != FAND_SHM_MAGIC
+            || shm->hdr.version != FAND_SHM_VERSION) {
+        munmap(addr, sizeof(struct fand_shm));
+        errno = EPROTO;
+        return NULL;
+    }
+
+    return shm;
+}
+
+void
+fand_shm_close(const struct fand_shm *shm)
+{
+    if (shm != NULL) {
+        munmap((void *)shm, sizeof(struct fand_shm));
+    }
+}
+
+int
+fand_shm_snapshot(const struct fand_shm *shm, struct fand_shm *copy)
+{
+    uint64_t seq;
+    int tries;
+
+    for (tries = 0; tries < SNAPSHOT_TRIES; tries++) {
+        seq = fand_shm_read_begin(shm);
+        if (seq & 1) {
+            sched_yield();
+            continue;
+        }
+        memcpy(copy, shm, sizeof(*copy));
+        if (!fand_shm_read_retry(shm, seq)) {
+            return 0;
+        }
+    }
+
+    return EAGAIN;
+}